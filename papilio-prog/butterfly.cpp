@@ -103,8 +103,9 @@ void usage(char *name)
       "   -d\t\t\tFTDI device name\n"
       "   -f <bitfile>\t\tMain bit file\n"
       "   -b <bitfile>\t\tbscan_spi bit file (enables spi access via JTAG)\n"
-      "   -s [e|v|p|a]\t\tSPI Flash options: e=Erase Only, v=Verify Only,\n"
-      "               \t\tp=Program Only or a=ALL (Default)\n"
+      "   -s [e|v|p|a|d]\tSPI Flash options: e=Erase Only, v=Verify Only,\n"
+      "               \t\tp=Program Only, a=ALL (Default) or\n"
+      "               \t\td=Differential, only update changed sectors\n"
       "   -c\t\t\tDisplay current status of FPGA\n"
       "   -C\t\t\tDisplay STAT Register of FPGA\n"
       "   -r\t\t\tTrigger a reconfiguration of FPGA\n"
@@ -232,6 +233,10 @@ int main(int argc, char **argv)
                 case 'A':
                     spi_options=ProgAlgSpi::FULL;
                     break;
+                case 'd':
+                case 'D':
+                    spi_options=ProgAlgSpi::DIFFERENTIAL;
+                    break;
                 default:
                     printf("Unknown argument: \"%c\" to option: \"%c\"\n",c, optarg[0]);
                     usage(argv[0]);
@@ -23,14 +23,21 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA */
 //#include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/time.h>
 
 #include "ioftdi.h"
 #include "io_exception.h"
+#include "tools.h"
 
 //using namespace std;
 
 IOFtdi::IOFtdi(int const vendor, int const product, char const *desc, char const *serial, int subtype)
-  : IOBase(), bptr(0), calls_rd(0), calls_wr(0), retries(0){
+  : IOBase(), bptr(0), calls_rd(0), calls_wr(0), retries(0),
+    pipe_head(0), pipe_count(0), rd_bytes(0), rd_usecs(0){
+#if !defined (USE_FTD2XX)
+    memset(pipe_wr, 0, sizeof(pipe_wr));
+    pipe_rd = NULL;
+#endif
     
 #if defined (USE_FTD2XX)
     FT_STATUS res;
@@ -133,10 +140,18 @@ void IOFtdi::txrx_block(const unsigned char *tdi, unsigned char *tdo, int length
   unsigned char buf[TX_BUF];
   unsigned int buflen = TX_BUF - 3 ; /* we need the preamble*/
   unsigned int rembits;
+  struct timeval tv[2];
+
+  if (tdo)
+    gettimeofday(tv, NULL);
   
   /*out on -ve edge, in on +ve edge */
   if (rem/8 > buflen)
     {
+      /* Commands already queued have to reach the device before the
+	 pipelined chunks */
+      if (tdo)
+	mpsse_send();
       while (rem/8 > buflen) 
 	{
 	  /* full chunks*/
@@ -144,22 +159,35 @@ void IOFtdi::txrx_block(const unsigned char *tdi, unsigned char *tdo, int length
 	    |((tdi)?MPSSE_DO_WRITE:0)|MPSSE_LSB|MPSSE_WRITE_NEG;
 	  buf[1] = (buflen-1) & 0xff;        /* low lenbth byte */
 	  buf[2] = ((buflen-1) >> 8) & 0xff; /* high lenbth byte */
-	  mpsse_add_cmd (buf, 3);
-	  if(tdi) 
+	  if (tdo)
 	    {
-	      mpsse_add_cmd (tmpsbuf, buflen);
-	      tmpsbuf+=buflen;
+	      /* Don't wait for the TDO bytes of this chunk before sending
+		 the next one, pipe_collect picks them up in order */
+	      unsigned char *cmd = pipe_slot();
+	      int cmdlen = 3;
+	      memcpy(cmd, buf, 3);
+	      if(tdi)
+		{
+		  memcpy(cmd + cmdlen, tmpsbuf, buflen);
+		  cmdlen += buflen;
+		  tmpsbuf += buflen;
+		}
+	      cmd[cmdlen++] = SEND_IMMEDIATE;
+	      pipe_submit(cmdlen, tmprbuf, buflen);
+	      tmprbuf += buflen;
 	    }
-	  rem -= buflen * 8;
-	  if (tdo) 
+	  else
 	    {
-	      if  (readusb(tmprbuf,buflen) != buflen) 
+	      mpsse_add_cmd (buf, 3);
+	      if(tdi) 
 		{
-		  fprintf(stderr,"IO_JTAG_MPSSE::shiftTDITDO: Failed to read block 0x%x bytes\n", buflen );
+		  mpsse_add_cmd (tmpsbuf, buflen);
+		  tmpsbuf+=buflen;
 		}
-	      tmprbuf+=buflen;
 	    }
+	  rem -= buflen * 8;
 	}
+      pipe_drain();
     }
   rembits = rem % 8;
   rem  = rem - rembits;
@@ -219,14 +247,20 @@ void IOFtdi::txrx_block(const unsigned char *tdi, unsigned char *tdo, int length
   if(tdo) 
     {
       if (!last) 
-	readusb(tmprbuf, buflen);
+	{
+	  readusb(tmprbuf, buflen);
+	  /* TDO bits of the incomplete last byte are shifted in from the
+	     top, move them down */
+	  if (rembits)
+	    tmprbuf[buflen-1] >>= 8 - rembits;
+	}
       else 
 	{
 	  /* we need to handle the last bit. It's much faster to
 		 read into an extra buffer than to issue two USB reads */
 	  readusb(rbuf, buflen); 
 	  if(!rembits) 
-	    rbuf[buflen-1] = (rbuf[buflen - 1]&80)?1:0;
+	    rbuf[buflen-1] = (rbuf[buflen - 1]&0x80)?1:0;
 	  else 
 	    {
 	      /* TDO Bits are shifted downwards, so align them 
@@ -236,7 +270,127 @@ void IOFtdi::txrx_block(const unsigned char *tdi, unsigned char *tdo, int length
 	    }
 	  memcpy(tmprbuf,rbuf,buflen);
 	}
+      gettimeofday(tv+1, NULL);
+      rd_bytes += (length + 7) / 8;
+      rd_usecs += deltaT(tv, tv + 1);
+    }
+}
+
+/* Return the command buffer for the next pipelined chunk. When all
+   slots are busy the oldest chunk's TDO bytes are collected first. */
+unsigned char *IOFtdi::pipe_slot(void)
+{
+  if (pipe_count == PIPE_DEPTH)
+    pipe_collect();
+  return pipe_buf[(pipe_head + pipe_count) % PIPE_DEPTH];
+}
+
+/* Send the chunk built in the pipe_slot() buffer. Its len TDO bytes
+   are stored at dst by a later pipe_collect(). */
+void IOFtdi::pipe_submit(int cmdlen, unsigned char *dst, unsigned int len)
+{
+  int slot = (pipe_head + pipe_count) % PIPE_DEPTH;
+
+  pipe_dst[slot] = dst;
+  pipe_len[slot] = len;
+  calls_wr++;
+#if defined (USE_FTD2XX)
+  /* The D2XX driver keeps reading from the device on its own, so a
+     blocking write cannot stall behind unread TDO data */
+  DWORD written = 0, last_written;
+  int timeout = 0;
+  while ((written < (DWORD)cmdlen) && (timeout < 100))
+  {
+      if (FT_Write(ftdi, pipe_buf[slot] + written, cmdlen - written, &last_written) != FT_OK)
+      {
+	  fprintf(stderr, "pipe_submit: Write failed\n");
+	  throw  io_exception();
+      }
+      written += last_written;
+      timeout++;
+  }
+  if (written != (DWORD)cmdlen)
+  {
+      fprintf(stderr, "pipe_submit: Short write %ld vs %d\n", written, cmdlen);
+      throw  io_exception();
+  }
+#else
+  /* libusb only moves data while a read is pending, so the write is
+     asynchronous and the oldest chunk always has a read submitted */
+  pipe_wr[slot] = ftdi_write_data_submit(&ftdi, pipe_buf[slot], cmdlen);
+  if (pipe_wr[slot] == NULL)
+    {
+      fprintf(stderr,"pipe_submit: Write submit failed, Err: %s\n",
+	      ftdi_get_error_string(&ftdi));
+      deinit();
+      throw  io_exception();
+    }
+  if (pipe_rd == NULL)
+    {
+      pipe_rd = ftdi_read_data_submit(&ftdi, pipe_dst[pipe_head], pipe_len[pipe_head]);
+      if (pipe_rd == NULL)
+	{
+	  fprintf(stderr,"pipe_submit: Read submit failed, Err: %s\n",
+		  ftdi_get_error_string(&ftdi));
+	  deinit();
+	  throw  io_exception();
+	}
+    }
+#endif
+  pipe_count++;
+}
+
+/* Wait for the TDO bytes of the oldest chunk in flight */
+void IOFtdi::pipe_collect(void)
+{
+  int slot = pipe_head;
+
+  calls_rd++;
+#if defined (USE_FTD2XX)
+  if (recvusb(pipe_dst[slot], pipe_len[slot]) != pipe_len[slot])
+    fprintf(stderr,"IO_JTAG_MPSSE::shiftTDITDO: Failed to read block 0x%x bytes\n", pipe_len[slot]);
+#else
+  int read = ftdi_transfer_data_done(pipe_rd);
+  pipe_rd = NULL;
+  if (read != (int)pipe_len[slot])
+    {
+      fprintf(stderr,"pipe_collect: Read %d vs %d, Err: %s\n",
+	      read, pipe_len[slot], ftdi_get_error_string(&ftdi));
+      deinit();
+      throw  io_exception();
+    }
+  /* All TDO bytes of the chunk arrived, so its commands were consumed
+     and the write has completed */
+  if (ftdi_transfer_data_done(pipe_wr[slot]) < 0)
+    {
+      fprintf(stderr,"pipe_collect: Write failed, Err: %s\n",
+	      ftdi_get_error_string(&ftdi));
+      deinit();
+      throw  io_exception();
+    }
+  pipe_wr[slot] = NULL;
+#endif
+  pipe_head = (pipe_head + 1) % PIPE_DEPTH;
+  pipe_count--;
+#if !defined (USE_FTD2XX)
+  if (pipe_count)
+    {
+      pipe_rd = ftdi_read_data_submit(&ftdi, pipe_dst[pipe_head], pipe_len[pipe_head]);
+      if (pipe_rd == NULL)
+	{
+	  fprintf(stderr,"pipe_collect: Read submit failed, Err: %s\n",
+		  ftdi_get_error_string(&ftdi));
+	  deinit();
+	  throw  io_exception();
+	}
     }
+#endif
+}
+
+void IOFtdi::pipe_drain(void)
+{
+  while (pipe_count)
+    pipe_collect();
 }
 
 void IOFtdi::tx_tms(unsigned char *pat, int length)
@@ -264,12 +418,18 @@ unsigned int IOFtdi::readusb(unsigned char * rbuf, unsigned long len)
     unsigned char buf[1] = { SEND_IMMEDIATE};
     mpsse_add_cmd(buf,1);
     mpsse_send();
+    calls_rd++;
+    return recvusb(rbuf, len);
+}
+
+/* Read len bytes of data already requested from the device */
+unsigned int IOFtdi::recvusb(unsigned char * rbuf, unsigned long len)
+{
 #if defined (USE_FTD2XX)
     DWORD  length = (DWORD) len, read = 0, last_read;
     int timeout=0;
     FT_STATUS res;
  
-    calls_rd++;
     res = FT_Read(ftdi, rbuf, length, &read);
     if(res != FT_OK)
     {
@@ -302,7 +462,6 @@ unsigned int IOFtdi::readusb(unsigned char * rbuf, unsigned long len)
 #else
   int length = (int) len, read = 0;
   int timeout=0, last_errno, last_read;
-  calls_rd++;
   last_read = ftdi_read_data(&ftdi, rbuf, length );
   if (last_read > 0)
     read += last_read;
@@ -347,6 +506,9 @@ void IOFtdi::deinit(void)
   ftdi_deinit(&ftdi);
 #endif
   if(verbose)  printf("USB transactions: Write %d read %d retries %d\n", calls_wr, calls_rd, retries);
+  if(verbose && rd_usecs)
+    printf("TDO readback: %lu bytes in %.1f ms, %.0f bytes/s\n", rd_bytes,
+	   rd_usecs / 1.0e3, rd_bytes * 1.0e6 / rd_usecs);
 }
   
 IOFtdi::~IOFtdi()
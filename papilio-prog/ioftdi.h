@@ -41,6 +41,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA */
 
 #define TX_BUF (4096)
 
+/* Number of read-bearing chunks txrx_block keeps in flight */
+#define PIPE_DEPTH (4)
+
 
 
 /* Shifting commands IN MPSSE Mode*/
@@ -104,6 +107,21 @@ class IOFtdi : public IOBase
 #endif
   int calls_rd, calls_wr, subtype, retries;
 
+  /* Chunks queued by txrx_block whose TDO bytes are not collected yet.
+     The command buffer of a chunk must stay valid until its write is
+     done, so each slot has its own. Slots are used in FIFO order. */
+  unsigned char pipe_buf[PIPE_DEPTH][TX_BUF + 4];
+  unsigned char *pipe_dst[PIPE_DEPTH];
+  unsigned int pipe_len[PIPE_DEPTH];
+#if !defined (USE_FTD2XX)
+  struct ftdi_transfer_control *pipe_wr[PIPE_DEPTH];
+  struct ftdi_transfer_control *pipe_rd;
+#endif
+  int pipe_head, pipe_count;
+
+  /* TDO readback statistics, reported in verbose mode */
+  unsigned long rd_bytes, rd_usecs;
+
  public:
   IOFtdi(int vendor, int product, char const *desc, char const *serial, int subtype);
   ~IOFtdi();
@@ -119,6 +137,11 @@ class IOFtdi : public IOBase
   void mpsse_add_cmd(unsigned char const *buf, int len);
   void mpsse_send(void);
   unsigned int readusb(unsigned char * rbuf, unsigned long len);
+  unsigned int recvusb(unsigned char * rbuf, unsigned long len);
+  unsigned char *pipe_slot(void);
+  void pipe_submit(int cmdlen, unsigned char *dst, unsigned int len);
+  void pipe_collect(void);
+  void pipe_drain(void);
   void cycleTCK(int n, bool tdi);
 };
 
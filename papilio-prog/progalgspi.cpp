@@ -57,6 +57,7 @@ ProgAlgSpi::ProgAlgSpi(Jtag &j, IOBase &i, int fam)
     SectorErase=4;
     Max_Retries=4;
     SpiAddressShift=9;
+    FlashType=0;
 
     JPROGRAM=0x0b;
     BYPASS=0x3f;
@@ -419,7 +420,6 @@ bool ProgAlgSpi::Spi_Erase(bool verbose)
 {
 	unsigned int i,x;
 	bool fail=false;
-	byte data[4];
 	byte WRSR_Cmd[2]={0x01,0x00};
 
 	if(verbose)
@@ -528,18 +528,7 @@ bool ProgAlgSpi::Spi_Erase(bool verbose)
 	{
 		for(i=0;i<Pages&&!fail;i++)
 		{
-			memset(data,0, sizeof(data));
-			Spi_SetCommandRW('\x81',data,i);
-
-			Spi_Command(data,0,32);
-			Sleep(tCE);		
-			for(x=0;x<=Max_Retries;x++)
-			{
-				fail=!Spi_Write_Check(verbose);
-				if(!fail)
-					break;
-				Sleep(tPE);
-			}
+			fail=!Spi_EraseBlock(i*PageSize, verbose);
 			if((i%256)==0&&verbose)
 			{
 				printf(".");
@@ -562,7 +551,6 @@ bool ProgAlgSpi::Spi_PartialErase(int length, bool verbose)
 {
 	unsigned int i,x;
 	bool fail=false;
-	byte data[4];
 	byte WRSR_Cmd[2]={0x01,0x00};
 
 	if(verbose)
@@ -650,26 +638,7 @@ bool ProgAlgSpi::Spi_PartialErase(int length, bool verbose)
     for(i=0;i<DoPages&&!fail;i++)
     {
         if ((i*PageSize)%SectorSize == 0)
-        {
-            Spi_Command((byte*)"\x06",0,7);	//Write Enable
-            for(x=0;x<=Max_Retries;x++)
-            {
-                fail=!Spi_Write_Check(verbose);
-                if(fail==false)
-                    break;
-                Sleep(tCE);
-            }
-            Spi_SetCommandRW('\xd8',data,i*PageSize);	//Sector Erase
-            Spi_Command(data,0,31);
-            Sleep(tCE);		
-            for(x=0;x<=SectorErase;x++)
-            {
-                fail=!Spi_Check();
-                if(!fail)
-                    break;
-                Sleep(1000);
-            }
-        }
+            fail=!Spi_EraseBlock(i*PageSize, verbose);
         if((i%256)==0&&verbose)
         {
             printf(".");
@@ -689,18 +658,7 @@ bool ProgAlgSpi::Spi_PartialErase(int length, bool verbose)
 	{
 		for(i=0;i<Pages&&!fail;i++)
 		{
-			memset(data,0, sizeof(data));
-			Spi_SetCommandRW('\x81',data,i);
-
-			Spi_Command(data,0,32);
-			Sleep(tCE);		
-			for(x=0;x<=Max_Retries;x++)
-			{
-				fail=!Spi_Write_Check(verbose);
-				if(!fail)
-					break;
-				Sleep(tPE);
-			}
+			fail=!Spi_EraseBlock(i*PageSize, verbose);
 			if((i%256)==0&&verbose)
 			{
 				printf(".");
@@ -723,9 +681,7 @@ bool ProgAlgSpi::Spi_Write(const byte *write_data, int length, bool verbose)
 {
     unsigned int i,x;
     bool fail=false;
-    byte *data;
     unsigned int wBytes=(length+7)/8;
-    unsigned int bufsize=sizeof(byte)*(PageSize+4);
     unsigned int DoPages=wBytes/PageSize;
 	byte WRSR_Cmd[2]={0x01,0x00};
 	byte AAIP_Cmd[6]={0xad,0x00,0x00,0x00,0xaa,0xaa};
@@ -790,8 +746,6 @@ bool ProgAlgSpi::Spi_Write(const byte *write_data, int length, bool verbose)
 	}
 	else
 	{
-		data=(byte*)malloc(bufsize);
-
 		// full Pages
 		if(verbose){
 			printf("Programming :\n");
@@ -799,37 +753,7 @@ bool ProgAlgSpi::Spi_Write(const byte *write_data, int length, bool verbose)
 		}
 		for(i=0;i<DoPages&&!fail;i++)
 		{
-			memset(data, 0, bufsize);
-			if ((FlashType==MacronixFLASH) || (FlashType==GENERIC)){
-				Spi_Command((byte*)"\x06",0,7);	//Write Enable
-				for(x=0;x<=Max_Retries;x++)
-				{
-					fail=!Spi_Write_Check(verbose);
-					if(fail==false)
-						break;
-					Sleep(tCE);
-				}	
-				Spi_SetCommandRW('\x02',data,i*PageSize);
-			}
-			else{
-				Spi_SetCommand((byte*)"\x84",data,1);
-			}
-			memcpy(&data[4], &write_data[PageSize*i],PageSize);
-			Spi_Command(data,0, 8*(bufsize)-1);
-
-			// Write buffer to mem
-			memset(data, 0, bufsize);
-			if (FlashType!=MacronixFLASH){
-				Spi_SetCommandRW('\x88',data,i);
-				Spi_Command(data,0,4*8);
-			}
-			for(x=0;x<=Max_Retries;x++)
-			{
-				fail=!Spi_Check();
-				if(!fail)
-					break;
-				Sleep(tP);
-			}
+			fail=!Spi_ProgramPage(&write_data[PageSize*i], i, PageSize, verbose);
 			if((i%256)==0&&verbose)
 			{
 				printf(".");			
@@ -840,43 +764,8 @@ bool ProgAlgSpi::Spi_Write(const byte *write_data, int length, bool verbose)
 
 		// partial Page
 		if(!fail&&(DoPages*PageSize)<wBytes)
-		{
-			int remBytes=(wBytes-DoPages*PageSize);
-			memset(data, 0, bufsize);
-			Spi_SetCommand((byte*)"\x84",data,1);
-			if ((FlashType==MacronixFLASH) || (FlashType==GENERIC)){
-				Spi_Command((byte*)"\x06",0,7);	//Write Enable
-				for(x=0;x<=Max_Retries;x++)
-				{
-					fail=!Spi_Write_Check(verbose);
-					if(fail==false)
-						break;
-					Sleep(tCE);
-				}	
-				Spi_SetCommandRW('\x02',data,i*PageSize);
-			}
-			else{
-				Spi_SetCommand((byte*)"\x84",data,1);
-			}
-
-			memcpy(&data[4], &write_data[PageSize*DoPages],remBytes);
-			Spi_Command(data,0, 8*(bufsize)-1);
-
-			// Write buffer to mem
-			memset(data, 0, bufsize);
-			if (FlashType!=MacronixFLASH){
-				Spi_SetCommandRW('\x88',data,DoPages);
-				Spi_Command(data,0,4*8);
-			}
-
-			for(x=0;x<=Max_Retries;x++)
-			{
-				fail=!Spi_Check();
-				if(!fail)
-					break;
-				Sleep(tP);
-			}
-		}
+			fail=!Spi_ProgramPage(&write_data[PageSize*DoPages], DoPages,
+					wBytes-DoPages*PageSize, verbose);
 	}
     if(verbose)
     {
@@ -893,33 +782,21 @@ bool ProgAlgSpi::Spi_Verify(const byte *verify_data, int length, bool verbose)
     unsigned int i;
     bool fail=false;
     byte *data;
-    byte *tdo;
     unsigned int wBytes=(length+7)/8;
-    unsigned int bufsize=sizeof(byte)*(PageSize+4);
     unsigned int DoPages=wBytes/PageSize;
-	//unsigned int address;
 
-    data=(byte*)malloc(bufsize);
-    tdo=(byte*)malloc(bufsize);
+    data=(byte*)malloc(PageSize);
 
     // full Pages
     if(verbose)
         printf("Verifying  :\n");
     for(i=0;i<DoPages&&!fail;i++)
     {
-        // Read from mem
-        memset(data, 0, bufsize);
-        memset(tdo, 0, bufsize);
-		if ((FlashType==SSTFLASH) || (FlashType==MacronixFLASH) || (FlashType==GENERIC))
-			Spi_SetCommandRW('\x03',data,i*PageSize);
-		else
-			Spi_SetCommandRW('\x03',data,i);
-
-        Spi_Command(data,tdo,(bufsize)*8);
-        if(memcmp(&tdo[4],&verify_data[i*PageSize],PageSize))
+        Spi_ReadPage(i, data, PageSize);
+        if(memcmp(data,&verify_data[i*PageSize],PageSize))
 		{
             fail=true;
-			printf("Error in Verify: first byte of data [0x%02X] ..\n",tdo[4]);
+			printf("Error in Verify: first byte of data [0x%02X] ..\n",data[0]);
 		}
         if((i%256)==0&&verbose)
 			{
@@ -932,18 +809,11 @@ bool ProgAlgSpi::Spi_Verify(const byte *verify_data, int length, bool verbose)
     if(!fail&&(DoPages*PageSize)<wBytes)
     {
         int remBytes=(wBytes-DoPages*PageSize);
-        // Read from mem
-        memset(data, 0, bufsize);
-        memset(tdo, 0, bufsize);
-		if ((FlashType==SSTFLASH) || (FlashType==MacronixFLASH) || (FlashType==GENERIC))
-			Spi_SetCommandRW('\x03',data,DoPages*PageSize);
-		else
-			Spi_SetCommandRW('\x03',data,DoPages);
-
-        Spi_Command(data,tdo,(bufsize)*8);
-        if(memcmp(&tdo[4],&verify_data[DoPages*PageSize],remBytes))
+        Spi_ReadPage(DoPages, data, remBytes);
+        if(memcmp(data,&verify_data[DoPages*PageSize],remBytes))
             fail=true;
     }
+    free(data);
 
     if(verbose)
     {
@@ -956,6 +826,188 @@ bool ProgAlgSpi::Spi_Verify(const byte *verify_data, int length, bool verbose)
     return !fail;
 }
 
+/* Erase the sector (Macronix and generic flash) or the page (Atmel
+   DataFlash) that starts at byte address */
+bool ProgAlgSpi::Spi_EraseBlock(unsigned int address, bool verbose)
+{
+	unsigned int x;
+	bool fail=false;
+	byte data[4];
+
+	memset(data,0, sizeof(data));
+	if ((FlashType==MacronixFLASH) || (FlashType==GENERIC))
+	{
+		Spi_Command((byte*)"\x06",0,7);	//Write Enable
+		for(x=0;x<=Max_Retries;x++)
+		{
+			fail=!Spi_Write_Check(verbose);
+			if(fail==false)
+				break;
+			Sleep(tCE);
+		}
+		Spi_SetCommandRW('\xd8',data,address);	//Sector Erase
+		Spi_Command(data,0,31);
+		Sleep(tCE);
+		for(x=0;x<=SectorErase;x++)
+		{
+			fail=!Spi_Check();
+			if(!fail)
+				break;
+			Sleep(1000);
+		}
+	}
+	else
+	{
+		Spi_SetCommandRW('\x81',data,address/PageSize);	//Page Erase
+		Spi_Command(data,0,32);
+		Sleep(tCE);
+		for(x=0;x<=Max_Retries;x++)
+		{
+			fail=!Spi_Write_Check(verbose);
+			if(!fail)
+				break;
+			Sleep(tPE);
+		}
+	}
+	return !fail;
+}
+
+/* Program bytes (at most PageSize) of page_data into an erased page */
+bool ProgAlgSpi::Spi_ProgramPage(const byte *page_data, unsigned int page, unsigned int bytes, bool verbose)
+{
+	unsigned int x;
+	bool fail=false;
+	unsigned int bufsize=sizeof(byte)*(PageSize+4);
+	byte *data=(byte*)malloc(bufsize);
+
+	memset(data, 0, bufsize);
+	if ((FlashType==MacronixFLASH) || (FlashType==GENERIC)){
+		Spi_Command((byte*)"\x06",0,7);	//Write Enable
+		for(x=0;x<=Max_Retries;x++)
+		{
+			fail=!Spi_Write_Check(verbose);
+			if(fail==false)
+				break;
+			Sleep(tCE);
+		}	
+		Spi_SetCommandRW('\x02',data,page*PageSize);
+	}
+	else{
+		Spi_SetCommand((byte*)"\x84",data,1);
+	}
+	memcpy(&data[4], page_data, bytes);
+	Spi_Command(data,0, 8*(bufsize)-1);
+
+	// Write buffer to mem
+	memset(data, 0, bufsize);
+	if (FlashType!=MacronixFLASH){
+		Spi_SetCommandRW('\x88',data,page);
+		Spi_Command(data,0,4*8);
+	}
+	for(x=0;x<=Max_Retries;x++)
+	{
+		fail=!Spi_Check();
+		if(!fail)
+			break;
+		Sleep(tP);
+	}
+	free(data);
+	return !fail;
+}
+
+/* Read the first bytes (at most PageSize) of a page into dst */
+void ProgAlgSpi::Spi_ReadPage(unsigned int page, byte *dst, unsigned int bytes)
+{
+    unsigned int bufsize=sizeof(byte)*(PageSize+4);
+    byte *data=(byte*)malloc(bufsize);
+    byte *tdo=(byte*)malloc(bufsize);
+
+    memset(data, 0, bufsize);
+    memset(tdo, 0, bufsize);
+	if ((FlashType==SSTFLASH) || (FlashType==MacronixFLASH) || (FlashType==GENERIC))
+		Spi_SetCommandRW('\x03',data,page*PageSize);
+	else
+		Spi_SetCommandRW('\x03',data,page);
+
+    Spi_Command(data,tdo,(bufsize)*8);
+    memcpy(dst,&tdo[4],bytes);
+
+    free(data);
+    free(tdo);
+}
+
+/* Read back every erase block covered by the image, and only erase,
+   program and verify the blocks whose contents differ. Blocks are
+   sectors on Macronix and generic flash and pages on Atmel DataFlash. */
+bool ProgAlgSpi::Spi_Differential(const byte *write_data, int length, bool verbose)
+{
+    unsigned int wBytes=(length+7)/8;
+    unsigned int BlockSize=((FlashType==MacronixFLASH)||(FlashType==GENERIC))?SectorSize:PageSize;
+    unsigned int Blocks=(wBytes+BlockSize-1)/BlockSize;
+    unsigned int b, off, end, n, changed=0;
+    bool fail=false;
+    byte *data;
+
+    data=(byte*)malloc(PageSize);
+
+    if(verbose){
+        printf("Comparing  :\n");
+        fflush(stdout);
+    }
+    for(b=0;b<Blocks&&!fail;b++)
+    {
+        bool differs=false;
+        end=(b+1)*BlockSize;
+        if(end>wBytes)
+            end=wBytes;
+
+        for(off=b*BlockSize;off<end&&!differs;off+=PageSize)
+        {
+            n=(end-off<PageSize)?end-off:PageSize;
+            Spi_ReadPage(off/PageSize, data, n);
+            differs=memcmp(data,&write_data[off],n)!=0;
+        }
+        if(!differs)
+            continue;
+
+        /* Erase even if only programming would be needed: a page
+           program can clear bits but never set them */
+        changed++;
+        if(verbose)
+        {
+            printf("Updating block %d (0x%06x)\n", b, b*BlockSize);
+            fflush(stdout);
+        }
+
+        fail=!Spi_EraseBlock(b*BlockSize, verbose);
+        for(off=b*BlockSize;off<end&&!fail;off+=PageSize)
+        {
+            n=(end-off<PageSize)?end-off:PageSize;
+            fail=!Spi_ProgramPage(&write_data[off], off/PageSize, n, verbose);
+        }
+        for(off=b*BlockSize;off<end&&!fail;off+=PageSize)
+        {
+            n=(end-off<PageSize)?end-off:PageSize;
+            Spi_ReadPage(off/PageSize, data, n);
+            if(memcmp(data,&write_data[off],n))
+            {
+                fail=true;
+                printf("Error in Verify: page %d ..\n", off/PageSize);
+            }
+        }
+    }
+    free(data);
+
+    if(verbose)
+    {
+        if(!fail)
+            printf("Ok, %d of %d blocks changed\n", changed, Blocks);
+        else
+            printf("Failed (@ Block: %d)\n", b-1);
+    }
+    return !fail;
+}
+
 bool ProgAlgSpi::EraseSpi()
 {
     struct timeval tv[2];
@@ -1012,6 +1064,16 @@ bool ProgAlgSpi::ProgramSpi(BitFile &file, Spi_Options_t options)
         return false;
     }
 
+    if(options==DIFFERENTIAL&&FlashType==SSTFLASH)
+    {
+        printf("SST Flash only supports chip erase, doing a full program.\n");
+        options=FULL;
+    }
+
+    if(options==DIFFERENTIAL)
+        if(!Spi_Differential(file.getData(), file.getLength(), verbose))
+            return false;
+
     if(options==FULL)
     {
         if(!Spi_PartialErase(file.getLength(), verbose))
@@ -1037,7 +1099,7 @@ bool ProgAlgSpi::ProgramSpi(BitFile &file, Spi_Options_t options)
 
     /* JPROGAM: Trigerr reconfiguration, not explained in ug332, but
      DS099 Figure 28:  Boundary-Scan Configuration Flow Diagram (p.49) */
-    if(options==FULL)
+    if(options==FULL||options==DIFFERENTIAL)
     {
         jtag->shiftIR(&JPROGRAM);
         Sleep(1000);//just wait a bit to make sure everything is done..
@@ -69,6 +69,10 @@ class ProgAlgSpi
         bool Spi_PartialErase(int length, bool verbose=false);
         bool Spi_Write(const byte *write_data, int length, bool verbose=false);
         bool Spi_Verify(const byte *verify_data, int length, bool verbose);
+        bool Spi_EraseBlock(unsigned int address, bool verbose=false);
+        bool Spi_ProgramPage(const byte *page_data, unsigned int page, unsigned int bytes, bool verbose=false);
+        void Spi_ReadPage(unsigned int page, byte *dst, unsigned int bytes);
+        bool Spi_Differential(const byte *write_data, int length, bool verbose=false);
         void Spi_SetCommand(const byte *command, byte *data, const int bytes);
         void Spi_SetCommandRW(const byte command, byte *data, const int address);
     public:
@@ -77,7 +81,8 @@ class ProgAlgSpi
             ERASE_ONLY,
             VERIFY_ONLY,
             WRITE_ONLY,
-            FULL
+            FULL,
+            DIFFERENTIAL
         };
         ProgAlgSpi(Jtag &j, IOBase &i, int family);
         bool ProgramSpi(BitFile &file, Spi_Options_t options);
@@ -0,0 +1,397 @@
+/*-
+ * Copyright (c) 2026 David Rush <northwoodlogic@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "svfcache.h"
+
+#define SVFC_MAGIC      "SVFC"
+#define SVFC_VERSION    2
+
+#define SVFC_REC_SHIFT  1
+#define SVFC_REC_UDELAY 2
+#define SVFC_REC_CHECK  3
+
+struct svfc_header {
+    char     magic[4];
+    uint32_t version;
+    uint64_t src_hash;
+    uint64_t src_len;
+    uint64_t tck_total;
+    uint64_t data_len;
+};
+
+struct svfc_rec {
+    uint32_t type;
+    uint32_t count;     /* pulses for SHIFT, TCK count for UDELAY, 0 for CHECK */
+    int32_t  usecs;
+    int32_t  tms;
+};
+
+#define SVFC_ALIGN(n)       (((n) + 7) & ~(size_t)7)
+#define SVFC_PLANE_LEN(n)   (((size_t)(n) + 7) / 8)
+
+static inline int
+getbit(const uint8_t *plane, uint32_t i)
+{
+    return (plane[i >> 3] >> (i & 7)) & 1;
+}
+
+static inline void
+putbit(uint8_t *plane, uint32_t i, int v)
+{
+    if(v)
+        plane[i >> 3] |= 1 << (i & 7);
+}
+
+/* 64 bit FNV-1a, only used to key the cache file to its source */
+uint64_t
+svfcache_hash(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i;
+
+    for(i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void
+svfcache_init(struct svfcache *vc)
+{
+    memset(vc, 0, sizeof(*vc));
+}
+
+void
+svfcache_free(struct svfcache *vc)
+{
+    if(vc->map_addr) {
+        munmap(vc->map_addr, vc->map_len);
+    } else {
+        free(vc->data);
+    }
+    svfcache_init(vc);
+}
+
+static void*
+svfcache_append(struct svfcache *vc, size_t len)
+{
+    void *p;
+
+    len = SVFC_ALIGN(len);
+    if(vc->data_len + len > vc->data_cap) {
+        size_t cap = vc->data_cap ? vc->data_cap : 64 * 1024;
+        while(cap < vc->data_len + len)
+            cap *= 2;
+        p = realloc(vc->data, cap);
+        if(!p)
+            return NULL;
+        vc->data = p;
+        vc->data_cap = cap;
+    }
+    p = vc->data + vc->data_len;
+    memset(p, 0, len);
+    vc->data_len += len;
+    return p;
+}
+
+static int
+svfcache_flush_run(struct svfcache *vc)
+{
+    size_t plane_len = SVFC_PLANE_LEN(vc->run_len);
+    struct svfc_rec *rec;
+    uint8_t *planes;
+    int n;
+
+    if(vc->run_len == 0)
+        return 0;
+
+    rec = svfcache_append(vc, sizeof(*rec) + SVFC_PLANES * plane_len);
+    if(!rec)
+        return -1;
+
+    rec->type = SVFC_REC_SHIFT;
+    rec->count = vc->run_len;
+    planes = (uint8_t *)(rec + 1);
+    for(n = 0; n < SVFC_PLANES; n++) {
+        memcpy(planes + n * plane_len, vc->run[n], plane_len);
+        memset(vc->run[n], 0, plane_len);
+    }
+    vc->run_len = 0;
+    return 0;
+}
+
+/* A CHECK record ends a scan statement that compared TDO bits. The SVF
+ * player fails right after such a statement, so replay stops there too */
+static int
+svfcache_check(struct svfcache *vc)
+{
+    struct svfc_rec *rec;
+
+    if(svfcache_flush_run(vc))
+        return -1;
+
+    rec = svfcache_append(vc, sizeof(*rec));
+    if(!rec)
+        return -1;
+
+    rec->type = SVFC_REC_CHECK;
+    vc->check_pending = 0;
+    return 0;
+}
+
+int
+svfcache_record_pulse(struct svfcache *vc, int tms, int tdi, int tdo)
+{
+    uint32_t i = vc->run_len;
+
+    putbit(vc->run[SVFC_PLANE_TMS], i, tms);
+    putbit(vc->run[SVFC_PLANE_TDI], i, tdi > 0);
+    putbit(vc->run[SVFC_PLANE_TDI_EN], i, tdi >= 0);
+    putbit(vc->run[SVFC_PLANE_TDO], i, tdo > 0);
+    putbit(vc->run[SVFC_PLANE_TDO_EN], i, tdo >= 0);
+    vc->tck_total++;
+    vc->run_len++;
+
+    if(tdo >= 0)
+        vc->check_pending = 1;
+
+    /* SIR and SDR leave the shift state with TMS high on their last bit */
+    if(tms && vc->check_pending)
+        return svfcache_check(vc);
+    if(vc->run_len == SVFC_RUN_MAX)
+        return svfcache_flush_run(vc);
+    return 0;
+}
+
+int
+svfcache_record_udelay(struct svfcache *vc, long usecs, int tms, long num_tck)
+{
+    struct svfc_rec *rec;
+
+    if(svfcache_flush_run(vc))
+        return -1;
+
+    rec = svfcache_append(vc, sizeof(*rec));
+    if(!rec)
+        return -1;
+
+    rec->type = SVFC_REC_UDELAY;
+    rec->count = num_tck > 0 ? (uint32_t)num_tck : 0;
+    rec->usecs = usecs > 0 ? (int32_t)usecs : 0;
+    rec->tms = tms;
+    vc->tck_total += rec->count;
+    return 0;
+}
+
+int
+svfcache_finish(struct svfcache *vc)
+{
+    if(vc->check_pending)
+        return svfcache_check(vc);
+    return svfcache_flush_run(vc);
+}
+
+/* Walk every record and make sure it stays inside the data area */
+static int
+svfcache_validate(const uint8_t *data, size_t len)
+{
+    size_t off = 0;
+
+    while(off < len) {
+        const struct svfc_rec *rec = (const struct svfc_rec *)(data + off);
+        size_t rec_len = sizeof(*rec);
+
+        if(len - off < sizeof(*rec))
+            return -1;
+        if(rec->type == SVFC_REC_SHIFT) {
+            if(rec->count == 0 || rec->count > SVFC_RUN_MAX)
+                return -1;
+            rec_len += SVFC_PLANES * SVFC_PLANE_LEN(rec->count);
+        } else if(rec->type != SVFC_REC_UDELAY && rec->type != SVFC_REC_CHECK) {
+            return -1;
+        }
+        rec_len = SVFC_ALIGN(rec_len);
+        if(len - off < rec_len)
+            return -1;
+        off += rec_len;
+    }
+    return 0;
+}
+
+int
+svfcache_load(struct svfcache *vc, const char *path,
+              uint64_t src_hash, uint64_t src_len)
+{
+    struct svfc_header *hdr;
+    struct stat sb;
+    void *map_addr;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd == -1)
+        return -1;
+
+    if(fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode) ||
+       (size_t)sb.st_size < sizeof(*hdr)) {
+        close(fd);
+        return -1;
+    }
+
+    map_addr = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map_addr == MAP_FAILED)
+        return -1;
+
+    hdr = map_addr;
+    if(memcmp(hdr->magic, SVFC_MAGIC, 4) || hdr->version != SVFC_VERSION ||
+       hdr->src_hash != src_hash || hdr->src_len != src_len ||
+       hdr->data_len != sb.st_size - sizeof(*hdr) ||
+       svfcache_validate((uint8_t *)(hdr + 1), hdr->data_len)) {
+        munmap(map_addr, sb.st_size);
+        return -1;
+    }
+
+    svfcache_free(vc);
+    vc->map_addr = map_addr;
+    vc->map_len = sb.st_size;
+    vc->data = (uint8_t *)(hdr + 1);
+    vc->data_len = hdr->data_len;
+    vc->tck_total = hdr->tck_total;
+    return 0;
+}
+
+/* Written to a temporary file and renamed into place so a partially
+ * written cache is never picked up by a later run */
+int
+svfcache_save(struct svfcache *vc, const char *path,
+              uint64_t src_hash, uint64_t src_len)
+{
+    struct svfc_header hdr;
+    char tmp_path[4096];
+    FILE *fp;
+    int rc = 0;
+
+    if(snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid()) >=
+       (int)sizeof(tmp_path))
+        return -1;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SVFC_MAGIC, 4);
+    hdr.version = SVFC_VERSION;
+    hdr.src_hash = src_hash;
+    hdr.src_len = src_len;
+    hdr.tck_total = vc->tck_total;
+    hdr.data_len = vc->data_len;
+
+    fp = fopen(tmp_path, "wb");
+    if(!fp)
+        return -1;
+
+    if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+       (vc->data_len && fwrite(vc->data, vc->data_len, 1, fp) != 1))
+        rc = -1;
+    if(fclose(fp))
+        rc = -1;
+
+    if(rc == 0 && rename(tmp_path, path))
+        rc = -1;
+    if(rc)
+        unlink(tmp_path);
+    return rc;
+}
+
+int
+svfcache_play(struct libxsvf_host *h, struct svfcache *vc)
+{
+    size_t off = 0;
+    int tdo_error = 0;
+    int rc = 0;
+    uint32_t i;
+
+    if(LIBXSVF_HOST_SETUP() < 0) {
+        LIBXSVF_HOST_REPORT_ERROR("Setup of JTAG interface failed.");
+        return -1;
+    }
+
+    while(off < vc->data_len) {
+        const struct svfc_rec *rec = (const struct svfc_rec *)(vc->data + off);
+
+        if(rec->type == SVFC_REC_CHECK) {
+            if(tdo_error)
+                break;
+            off += SVFC_ALIGN(sizeof(*rec));
+            continue;
+        }
+
+        if(rec->type == SVFC_REC_UDELAY) {
+            LIBXSVF_HOST_UDELAY(rec->usecs, rec->tms, rec->count);
+            off += SVFC_ALIGN(sizeof(*rec));
+            continue;
+        }
+
+        size_t plane_len = SVFC_PLANE_LEN(rec->count);
+        const uint8_t *tms = (const uint8_t *)(rec + 1);
+        const uint8_t *tdi = tms + plane_len;
+        const uint8_t *tdi_en = tdi + plane_len;
+        const uint8_t *tdo = tdi_en + plane_len;
+        const uint8_t *tdo_en = tdo + plane_len;
+
+        /* Like the SVF player, a mismatch fails at the end of the statement */
+        for(i = 0; i < rec->count; i++) {
+            int v_tdi = getbit(tdi_en, i) ? getbit(tdi, i) : -1;
+            int v_tdo = getbit(tdo_en, i) ? getbit(tdo, i) : -1;
+            if(LIBXSVF_HOST_PULSE_TCK(getbit(tms, i), v_tdi, v_tdo, 0, 0) < 0)
+                tdo_error = 1;
+        }
+        off += SVFC_ALIGN(sizeof(*rec) + SVFC_PLANES * plane_len);
+    }
+
+    if(tdo_error) {
+        LIBXSVF_HOST_REPORT_ERROR("TDO mismatch.");
+        rc = -1;
+
+        /* Five TMS=1 clocks reach Test-Logic-Reset from any TAP state */
+        for(i = 0; i < 5; i++)
+            LIBXSVF_HOST_PULSE_TCK(1, -1, -1, 0, 0);
+    }
+
+    if(LIBXSVF_HOST_SHUTDOWN() < 0) {
+        LIBXSVF_HOST_REPORT_ERROR("Shutdown of JTAG interface failed.");
+        rc = -1;
+    }
+    return rc;
+}
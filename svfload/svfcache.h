@@ -0,0 +1,95 @@
+/*-
+ * Copyright (c) 2026 David Rush <northwoodlogic@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SVFCACHE_H
+#define SVFCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libxsvf/libxsvf.h"
+
+/*
+ * Compiled JTAG vectors. An SVF file is played once through libxsvf with a
+ * recording host, every TCK pulse and RUNTEST delay is captured, and the
+ * result is stored as a sequence of records:
+ *
+ *   SHIFT  - a run of TCK pulses stored as bit planes (TMS, TDI, TDI drive
+ *            enable, expected TDO, TDO compare mask), one bit per pulse.
+ *   UDELAY - a RUNTEST style delay with TMS held and a TCK count.
+ *   CHECK  - the end of a scan statement that compared TDO. Replay stops
+ *            here when any compared bit since the previous CHECK failed.
+ *
+ * The vectors can be written to a cache file keyed by a hash of the SVF
+ * source, then mmapped and replayed on later runs without parsing.
+ */
+
+#define SVFC_PLANE_TMS      0
+#define SVFC_PLANE_TDI      1
+#define SVFC_PLANE_TDI_EN   2
+#define SVFC_PLANE_TDO      3
+#define SVFC_PLANE_TDO_EN   4
+#define SVFC_PLANES         5
+
+/* Maximum number of pulses in one SHIFT record */
+#define SVFC_RUN_MAX        65536
+
+struct svfcache {
+    /* Compiled records, either built in memory or inside an mmapped file */
+    uint8_t *data;
+    size_t   data_len;
+    size_t   data_cap;
+    uint64_t tck_total;
+
+    /* Cache file mapping, NULL when the records were built in memory */
+    void    *map_addr;
+    size_t   map_len;
+
+    /* Recorder state for the SHIFT run currently being captured */
+    uint32_t run_len;
+    int      check_pending;     /* TDO was compared since the last CHECK */
+    uint8_t  run[SVFC_PLANES][SVFC_RUN_MAX / 8];
+};
+
+uint64_t svfcache_hash(const void *data, size_t len);
+
+void svfcache_init(struct svfcache *vc);
+void svfcache_free(struct svfcache *vc);
+
+int  svfcache_record_pulse(struct svfcache *vc, int tms, int tdi, int tdo);
+int  svfcache_record_udelay(struct svfcache *vc, long usecs, int tms, long num_tck);
+int  svfcache_finish(struct svfcache *vc);
+
+int  svfcache_load(struct svfcache *vc, const char *path,
+                   uint64_t src_hash, uint64_t src_len);
+int  svfcache_save(struct svfcache *vc, const char *path,
+                   uint64_t src_hash, uint64_t src_len);
+
+/* Replay the compiled vectors through the host's setup, pulse_tck, udelay
+ * and shutdown callbacks. Returns non-zero on TDO mismatch or failure. */
+int  svfcache_play(struct libxsvf_host *h, struct svfcache *vc);
+
+#endif
@@ -36,6 +36,7 @@
 #include <stdint.h>
 #include <signal.h>
 #include <errno.h>
+#include <time.h>
 
 #ifdef FREEBSD
 #include <libgen.h>
@@ -51,6 +52,7 @@
 #endif
 
 #include "libxsvf/libxsvf.h"
+#include "svfcache.h"
 
 #ifdef FREEBSD
 #include <dev/ksvf/ksvf.h>
@@ -65,12 +67,17 @@ struct ksvf_req {
     int   padding;
     // TCK pulse count for test mode run
     uint32_t tck_cnt;
+    // set when the caller needs TDO sampled after the pulse
+    int tdo_sample;
 
-    // linux userspace gpiochip api, 1 fd per gpio
+    // linux userspace gpiochip v1 api, 1 fd per gpio
     int tms_fd;
     int tdi_fd;
     int tdo_fd;
     int tck_fd;
+
+    // linux userspace gpiochip v2 api, 1 fd for all four lines
+    int line_fd;
 };
 
 #define KSVF_INIT       1
@@ -86,6 +93,14 @@ static int tdi_pin = 22;
 static int tdo_pin = 17;
 static char *gpiochip = "/dev/gpiochip0";
 
+/* Use the gpiochip v2 line request API when the headers provide it. The
+ * v1 line handle API is kept as a fallback for older kernels. */
+#ifdef GPIO_V2_GET_LINE_IOCTL
+static int gpio_v1 = 0;
+#else
+static int gpio_v1 = 1;
+#endif
+
 /* Defaults for aml-s905x-cc */
 #define AML_S905X_CC_TMS 97
 #define AML_S905X_CC_TCK 84
@@ -112,6 +127,25 @@ struct ksvfplay_args {
     uint64_t tck_step;
     uint64_t tck_compare;
 
+    /* Play start time, used to report TCK pulse throughput */
+    struct timespec play_start;
+
+    /* Compiled vector cache, only used when a cache directory is given.
+     * The analyze pass records into 'cache' when it is non-NULL. */
+    const char *cache_dir;
+    struct svfcache *cache;
+    int cache_error;
+
+    /* Digest of every pulse and delay, used by the timing player. When
+     * tdo_fail is non-zero, the compared TDO bit with that number (from 1)
+     * mismatches and the digest and TCK count at the first error are kept */
+    uint64_t digest;
+    uint64_t tdo_count;
+    uint64_t tdo_fail;
+    uint64_t fail_digest;
+    uint64_t fail_count;
+    int      failed;
+
     struct ksvf_req kreq;
 };
 
@@ -119,6 +153,7 @@ static void usage(void);
 int main_analyze(struct ksvfplay_args *args);
 int main_idcode(struct ksvfplay_args *args);
 int main_play(struct ksvfplay_args *args);
+int main_timing(struct ksvfplay_args *args);
 
 static void
 usage()
@@ -134,7 +169,13 @@ usage()
     "Options:\n"
     "\n"
     " -f <svf file>       Path to SVF file\n"
-    " -d <jtag device>    Path to JTAG device, usually /dev/ksvf0\n"
+    " -d <jtag device>    Path to JTAG device, usually /dev/ksvf0. On Linux\n"
+    "                     this is the gpiochip, e.g. /dev/gpiochip0\n"
+#ifndef FREEBSD
+    " -g <tms,tck,tdi,tdo>\n"
+    "                     GPIO line offsets of the JTAG signals\n"
+    " -l                  Use the legacy gpiochip v1 line handle API\n"
+#endif
     " -p                  Play SVF file\n"
     " -a                  Analyze only, test play SVF file\n"
 #if 0
@@ -142,6 +183,11 @@ usage()
     "                     simulate success. The device should not be connected\n"
     " -q                  Be quiet, don't print progress indicator\n"
 #endif
+    " -c <cache dir>      Compile the SVF file into a binary vector cache in\n"
+    "                     this directory, replay it on later runs\n"
+    " -t                  Timing only, play the SVF file and its compiled\n"
+    "                     vectors without hardware and compare the result,\n"
+    "                     also with a forced TDO mismatch\n"
     " -i                  Read device ID code\n"
     " -h                  Show this message\n"
     "\n"
@@ -203,8 +249,9 @@ usage()
     "                  Ground - [7J1-39] |*|*| [7J1-40] -                 \n"
     "                                    -----                            \n"
     "\n"
-    "NOTE: The Linux port is a work in progress. JTAG signals are\n"
-    "hard coded as shown and the -d argument is ignored\n";
+    "NOTE: On Linux the JTAG signals default to the pins shown above for\n"
+    "the detected board. Use -d and -g to override them, e.g. to run against\n"
+    "a gpio-sim chip.\n";
     printf("%s", help);
     exit(0);
 }
@@ -221,6 +268,25 @@ show_progress(struct ksvfplay_args *args)
             args->tck_count);
 }
 
+static double
+elapsed(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void
+report_throughput(struct ksvfplay_args *args)
+{
+    double secs = elapsed(&args->play_start);
+    if(args->tck_count == 0 || secs <= 0.0) {
+        return;
+    }
+    fprintf(stderr, "TCK pulses: %llu in %.3f s (%.0f pulses/s)\n",
+            (unsigned long long)args->tck_count, secs,
+            args->tck_count / secs);
+}
 
 /* LibXSVF callback functions */
 
@@ -271,6 +337,10 @@ cb_analyze_udelay(struct libxsvf_host *h,
 {
     struct ksvfplay_args *args = h->user_data;
     args->tck_total += num_tck;
+    if(args->cache &&
+       svfcache_record_udelay(args->cache, usecs, tms, num_tck)) {
+        args->cache_error = 1;
+    }
 }
 
 /* analyze mode counts the total TCK count and always returns success */
@@ -281,9 +351,75 @@ cb_analyze_pulse_tck(struct libxsvf_host *h,
 {
     struct ksvfplay_args *args = h->user_data;
     args->tck_total++;
+    if(args->cache &&
+       svfcache_record_pulse(args->cache, tms, tdi, tdo)) {
+        args->cache_error = 1;
+    }
     return tdo < 0 ? 0 : tdo;
 }
 
+static void
+digest_update(struct ksvfplay_args *args, long a, long b, long c)
+{
+    long v[3] = { a, b, c };
+    args->digest ^= svfcache_hash(v, sizeof(v));
+    args->digest *= 0x100000001b3ULL;
+}
+
+/* timing mode folds every pulse and delay into a digest, no hardware */
+static void
+cb_digest_udelay(struct libxsvf_host *h,
+    long usecs, int tms, long num_tck)
+{
+    struct ksvfplay_args *args = h->user_data;
+    digest_update(args, usecs > 0 ? usecs : 0, tms, num_tck > 0 ? num_tck : 0);
+    args->tck_count += num_tck > 0 ? num_tck : 0;
+}
+
+static int
+cb_digest_pulse_tck(struct libxsvf_host *h,
+    int tms, int tdi, int tdo,
+    int rmask, int sync)
+{
+    struct ksvfplay_args *args = h->user_data;
+    digest_update(args, tms, tdi, tdo);
+    args->tck_count++;
+    if(tdo < 0) {
+        return 0;
+    }
+    if(++args->tdo_count == args->tdo_fail) {
+        return -1;
+    }
+    return tdo;
+}
+
+static void
+cb_digest_report_error(
+    struct libxsvf_host* h,
+    const char* file, int line, const char* message)
+{
+    struct ksvfplay_args *args = h->user_data;
+    if(!args->failed) {
+        args->failed = 1;
+        args->fail_digest = args->digest;
+        args->fail_count = args->tck_count;
+    }
+    /* the injected mismatch is expected, anything else is reported */
+    if(!args->tdo_fail) {
+        cb_report_error(h, file, line, message);
+    }
+}
+
+static void
+digest_reset(struct ksvfplay_args *args, uint64_t tdo_fail)
+{
+    args->digest = 0;
+    args->tck_count = 0;
+    args->tdo_count = 0;
+    args->tdo_fail = tdo_fail;
+    args->failed = 0;
+}
+
 /* analyze setup only needs to make sure the svf file is mmapped in and
  * then zero the svf_data_ptr. main() should have already mmapped it in. */
 static int
@@ -344,6 +480,8 @@ cb_play_pulse_tck(struct libxsvf_host *h,
         perror("KSVF pulse failed");
     }
 #else
+    /* TDO is only worth a GPIO read if it gets compared or returned */
+    args->kreq.tdo_sample = (tdo >= 0) || rmask || sync;
     if(svfctl(KSVF_PULSE, &args->kreq)) {
         fprintf(stderr, "KSVF pulse failed\n");
     }
@@ -379,6 +517,7 @@ cb_play_setup(struct libxsvf_host *h)
     args->tck_step = args->tck_total / 100;
 
     args->svf_data_ptr = 0;
+    clock_gettime(CLOCK_MONOTONIC, &args->play_start);
     return rc;
 }
 
@@ -449,6 +588,53 @@ main_idcode(struct ksvfplay_args *args)
     return rc;
 }
 
+/* compile runs the analyze pass with the vector recorder attached */
+static int
+compile_vectors(struct ksvfplay_args *args)
+{
+    int rc;
+
+    args->tck_total = 0;
+    args->cache_error = 0;
+    rc = main_analyze(args);
+    if(rc == 0 && (args->cache_error || svfcache_finish(args->cache))) {
+        fprintf(stderr, "Error: out of memory compiling SVF vectors\n");
+        rc = -1;
+    }
+    return rc;
+}
+
+/* load the vectors for the SVF file from the cache directory, compiling
+ * and storing them there first on a cache miss */
+static int
+load_vectors(struct ksvfplay_args *args)
+{
+    int rc;
+    char path[4096];
+    uint64_t hash = svfcache_hash(args->svf_data, args->svf_data_len);
+
+    snprintf(path, sizeof(path), "%s/%016llx.svfc",
+             args->cache_dir, (unsigned long long)hash);
+
+    if(svfcache_load(args->cache, path, hash, args->svf_data_len) == 0) {
+        fprintf(stderr, "Using vector cache %s\n", path);
+        args->tck_total = args->cache->tck_total;
+        return 0;
+    }
+
+    rc = compile_vectors(args);
+    if(rc) {
+        return rc;
+    }
+
+    if(svfcache_save(args->cache, path, hash, args->svf_data_len)) {
+        fprintf(stderr, "WARNING: unable to write vector cache %s\n", path);
+    } else {
+        fprintf(stderr, "Wrote vector cache %s\n", path);
+    }
+    return 0;
+}
+
 /* play requires both an svf file and hardware access */
 int
 main_play(struct ksvfplay_args *args)
@@ -470,6 +656,21 @@ main_play(struct ksvfplay_args *args)
         .user_data     = args
     };
 
+    /* With a vector cache the SVF file is parsed at most once, and not
+     * at all when a cache for this exact file already exists */
+    if(args->cache_dir) {
+        rc = load_vectors(args);
+        if(rc) {
+            return rc;
+        }
+        rc = svfcache_play(&jtag_host, args->cache);
+        if(rc) {
+            fprintf(stderr, "Program play failed\n");
+        }
+        report_throughput(args);
+        return rc;
+    }
+
     /* Analyze first to validate the SVF file and count the total
      * TCK count so that a progress indicator can be printed */
     rc = main_analyze(args);
@@ -481,9 +682,110 @@ main_play(struct ksvfplay_args *args)
     if(rc) {
         fprintf(stderr, "Program play failed\n");
     }
+    report_throughput(args);
     return rc;
 }
 
+/* timing plays the text SVF and the compiled vectors into a digest
+ * instead of hardware, prints how long each path took and fails if the
+ * two pulse streams differ. It then makes the middle compared TDO bit
+ * mismatch and fails if the two players do not stop at the same place */
+int
+main_timing(struct ksvfplay_args *args)
+{
+    int rc;
+    double t_text, t_load, t_replay;
+    uint64_t text_digest, text_count, tdo_total;
+    struct timespec start;
+    struct libxsvf_host jtag_host = {
+        .setup         = cb_analyze_setup,
+        .shutdown      = cb_analyze_shutdown,
+        .udelay        = cb_digest_udelay,
+        .pulse_tck     = cb_digest_pulse_tck,
+        .report_error  = cb_digest_report_error,
+
+        /* Common to all player modes */
+        .getbyte       = cb_get_byte,
+        .realloc       = cb_realloc,
+        .set_frequency = cb_set_frequency,
+        .report_device = cb_report_device,
+        .user_data     = args
+    };
+
+    digest_reset(args, 0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rc = libxsvf_play(&jtag_host, LIBXSVF_MODE_SVF);
+    t_text = elapsed(&start);
+    if(rc) {
+        fprintf(stderr, "Text play failed\n");
+        return rc;
+    }
+    text_digest = args->digest;
+    text_count = args->tck_count;
+    tdo_total = args->tdo_count;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rc = args->cache_dir ? load_vectors(args) : compile_vectors(args);
+    t_load = elapsed(&start);
+    if(rc) {
+        return rc;
+    }
+
+    digest_reset(args, 0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rc = svfcache_play(&jtag_host, args->cache);
+    t_replay = elapsed(&start);
+    if(rc) {
+        fprintf(stderr, "Vector play failed\n");
+        return rc;
+    }
+
+    fprintf(stdout, "Text parse + play:   %.6f s, %llu TCK, digest %016llx\n",
+            t_text, (unsigned long long)text_count,
+            (unsigned long long)text_digest);
+    fprintf(stdout, "Vector load/compile: %.6f s\n", t_load);
+    fprintf(stdout, "Vector play:         %.6f s, %llu TCK, digest %016llx\n",
+            t_replay, (unsigned long long)args->tck_count,
+            (unsigned long long)args->digest);
+
+    if(text_digest != args->digest || text_count != args->tck_count) {
+        fprintf(stderr, "Error: compiled vectors differ from the SVF file\n");
+        return 1;
+    }
+    fprintf(stdout, "Compiled vectors match the SVF file\n");
+
+    if(tdo_total == 0) {
+        fprintf(stdout, "No TDO compares, mismatch check skipped\n");
+        return 0;
+    }
+
+    digest_reset(args, tdo_total / 2 + 1);
+    if(libxsvf_play(&jtag_host, LIBXSVF_MODE_SVF) == 0 || !args->failed) {
+        fprintf(stderr, "Error: text play ignored a TDO mismatch\n");
+        return 1;
+    }
+    text_digest = args->fail_digest;
+    text_count = args->fail_count;
+
+    digest_reset(args, tdo_total / 2 + 1);
+    if(svfcache_play(&jtag_host, args->cache) == 0 || !args->failed) {
+        fprintf(stderr, "Error: vector play ignored a TDO mismatch\n");
+        return 1;
+    }
+
+    fprintf(stdout, "TDO mismatch at compare %llu: text stops after %llu TCK, "
+            "vectors after %llu TCK\n", (unsigned long long)args->tdo_fail,
+            (unsigned long long)text_count,
+            (unsigned long long)args->fail_count);
+
+    if(text_digest != args->fail_digest || text_count != args->fail_count) {
+        fprintf(stderr, "Error: compiled vectors do not stop at the failing statement\n");
+        return 1;
+    }
+    fprintf(stdout, "Compiled vectors stop at the failing statement\n");
+    return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -494,6 +796,7 @@ main(int argc, char *argv[])
     int idcode = 0;
     int analyze = 0;
     int simulate = 0;
+    int timing = 0;
     const char *svf_file_name = NULL;
     const char *ksvf_dev_name = NULL;
     struct ksvfplay_args svf_args;
@@ -521,14 +824,8 @@ main(int argc, char *argv[])
         fclose(mfp);
     }
 
-    fprintf(stderr, "Using Pin Configuration:\n");
-    fprintf(stderr, " gpiochip=%s,", gpiochip);
-    fprintf(stderr, " TMS=%d, TCK=%d, TDI=%d, TDO=%d\n",
-                            tms_pin, tck_pin, tdi_pin, tdo_pin);
-    fprintf(stderr, "\n");
-
     int ch;
-    while((ch = getopt(argc, argv, "hHaf:d:ip")) != -1) {
+    while((ch = getopt(argc, argv, "hHaf:d:g:ilpc:t")) != -1) {
         switch(ch) {
             case 'h':
             case 'H':
@@ -549,9 +846,31 @@ main(int argc, char *argv[])
             case 'f':
                 svf_file_name = optarg;
                 break;
+            case 'c':
+                svf_args.cache_dir = optarg;
+                break;
+            case 't':
+                nothing = 0;
+                timing++;
+                break;
             case 'd':
                 ksvf_dev_name = optarg;
+#ifndef FREEBSD
+                gpiochip = optarg;
+#endif
+                break;
+#ifndef FREEBSD
+            case 'g':
+                if(sscanf(optarg, "%d,%d,%d,%d",
+                        &tms_pin, &tck_pin, &tdi_pin, &tdo_pin) != 4) {
+                    fprintf(stderr, "Error: '-g' expects tms,tck,tdi,tdo\n\n");
+                    usage();
+                }
                 break;
+            case 'l':
+                gpio_v1 = 1;
+                break;
+#endif
             default:
                 fprintf(stderr, "Error: Unrecognized option\n\n");
                 usage();
@@ -563,6 +882,13 @@ main(int argc, char *argv[])
         usage();
     }
 
+    fprintf(stderr, "Using Pin Configuration:\n");
+    fprintf(stderr, " gpiochip=%s (%s),", gpiochip,
+                            gpio_v1 ? "v1 line handles" : "v2 line request");
+    fprintf(stderr, " TMS=%d, TCK=%d, TDI=%d, TDO=%d\n",
+                            tms_pin, tck_pin, tdi_pin, tdo_pin);
+    fprintf(stderr, "\n");
+
     /* Open the SVF file and map it into our process memory */
     if(svf_file_name != NULL) {
         struct stat sb;
@@ -644,6 +970,23 @@ main(int argc, char *argv[])
         return rc;
     }
 
+    if(timing || svf_args.cache_dir) {
+        svf_args.cache = malloc(sizeof(*svf_args.cache));
+        if(!svf_args.cache) {
+            fprintf(stderr, "\nError: out of memory\n\n");
+            exit(1);
+        }
+        svfcache_init(svf_args.cache);
+    }
+
+    if(timing) {
+        if(!svf_file_name) {
+            fprintf(stderr, "\nError: '-t' requires '-f' option\n\n");
+            exit(1);
+        }
+        return main_timing(&svf_args);
+    }
+
     if(idcode) {
         if(analyze || simulate) {
             fprintf(stderr, "\nError: '-i' is mutually exclusive with '-a'|'-s' options\n\n");
@@ -725,8 +1068,8 @@ pin_reconf(int fd, int input)
     return ioctl(fd, GPIOHANDLE_SET_CONFIG_IOCTL, &config);
 }
 
-static int 
-svfctl(int cmd, struct ksvf_req *req)
+static int
+svfctl_v1(int cmd, struct ksvf_req *req)
 {
     int n;
     int res = ENOTTY;
@@ -891,4 +1234,181 @@ svfctl(int cmd, struct ksvf_req *req)
     return res;
 }
 
+#ifdef GPIO_V2_GET_LINE_IOCTL
+
+//
+// gpiochip v2 backend. All four JTAG lines live in a single line request
+// so a TCK pulse is one ioctl to drive TMS/TDI with TCK low, one to raise
+// TCK and, only when the caller wants it, one to sample TDO.
+//
+#define V2_TMS      0
+#define V2_TDI      1
+#define V2_TCK      2
+#define V2_TDO      3
+#define V2_BIT(n)   (1ULL << (n))
+
+static int
+lines_set(int fd, uint64_t bits, uint64_t mask)
+{
+    struct gpio_v2_line_values values = {
+        .bits = bits,
+        .mask = mask
+    };
+    return ioctl(fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+}
+
+static int
+lines_get(int fd, uint64_t mask, uint64_t *bits)
+{
+    struct gpio_v2_line_values values = {
+        .bits = 0,
+        .mask = mask
+    };
+    int rc = ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values);
+    if(rc < 0)
+        return rc;
+    *bits = values.bits;
+    return 0;
+}
+
+static int
+svfctl_v2(int cmd, struct ksvf_req *req)
+{
+    int n;
+    int res = ENOTTY;
+    int chip_fd;
+    uint64_t bits;
+    uint64_t mask;
+    struct gpio_v2_line_request lr;
+    struct gpio_v2_line_config lc;
+
+    switch (cmd) {
+        case KSVF_INIT:
+            chip_fd = open(gpiochip, O_RDONLY);
+            if (chip_fd < 0) {
+                fprintf(stderr, "unable to open %s\n", gpiochip);
+                return -1;
+            }
+
+            //
+            // TDI, TMS, TCK outputs with TCK=1, TDO input
+            //
+            memset(&lr, 0, sizeof(lr));
+            lr.offsets[V2_TMS] = tms_pin;
+            lr.offsets[V2_TDI] = tdi_pin;
+            lr.offsets[V2_TCK] = tck_pin;
+            lr.offsets[V2_TDO] = tdo_pin;
+            lr.num_lines = 4;
+            strncpy(lr.consumer, "svfload", sizeof(lr.consumer) - 1);
+
+            lr.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+            lr.config.num_attrs = 2;
+            lr.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+            lr.config.attrs[0].attr.flags = GPIO_V2_LINE_FLAG_INPUT;
+            lr.config.attrs[0].mask = V2_BIT(V2_TDO);
+            lr.config.attrs[1].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+            lr.config.attrs[1].attr.values = V2_BIT(V2_TCK);
+            lr.config.attrs[1].mask = V2_BIT(V2_TCK);
+
+            res = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &lr);
+            close(chip_fd);
+            if (res < 0) {
+                fprintf(stderr, "unable to request jtag lines: %s\n",
+                        strerror(errno));
+                return -1;
+            }
+            req->line_fd = lr.fd;
+            break;
+
+        case KSVF_FINI:
+
+            // make the pins all inputs.
+            memset(&lc, 0, sizeof(lc));
+            lc.flags = GPIO_V2_LINE_FLAG_INPUT;
+            res = ioctl(req->line_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &lc);
+            if (res)
+                fprintf(stderr, "unable to reconfig jtag lines as input\n");
+
+            close(req->line_fd);
+            break;
+
+        case KSVF_UDELAY:
+
+            // Same contract as the v1 backend, TMS is driven together
+            // with the first TCK falling edge.
+            res = 0;
+            if(req->tck_cnt <= 0) {
+                req->tck_cnt = 0;
+                break;
+            }
+
+            bits = req->tms_val ? V2_BIT(V2_TMS) : 0;
+            mask = V2_BIT(V2_TMS) | V2_BIT(V2_TCK);
+            for(n = 0; n < req->tck_cnt; n++) {
+                res = lines_set(req->line_fd, bits, mask);
+                if(res)
+                    break;
+
+                res = lines_set(req->line_fd,
+                        V2_BIT(V2_TCK), V2_BIT(V2_TCK));
+                if(res)
+                    break;
+
+                bits = 0;
+                mask = V2_BIT(V2_TCK);
+            }
+
+            req->tck_cnt = n;
+            break;
+
+        case KSVF_PULSE:
+            res = 0;
+            do {
+                bits = req->tms_val ? V2_BIT(V2_TMS) : 0;
+                mask = V2_BIT(V2_TMS) | V2_BIT(V2_TCK);
+                if(req->tdi_val >= 0) {
+                    bits |= req->tdi_val ? V2_BIT(V2_TDI) : 0;
+                    mask |= V2_BIT(V2_TDI);
+                }
+
+                res = lines_set(req->line_fd, bits, mask);
+                if(res)
+                    break;
+
+                res = lines_set(req->line_fd,
+                        V2_BIT(V2_TCK), V2_BIT(V2_TCK));
+                if(res)
+                    break;
+
+                if(!req->tdo_sample) {
+                    req->tdo_val = 0;
+                    break;
+                }
+
+                res = lines_get(req->line_fd, V2_BIT(V2_TDO), &bits);
+                if(res)
+                    break;
+
+                req->tdo_val = (bits & V2_BIT(V2_TDO)) ? 1 : 0;
+
+            } while(0);
+            break;
+        default:
+            break;
+    }
+    return res;
+}
+
+#endif
+
+static int
+svfctl(int cmd, struct ksvf_req *req)
+{
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    if(!gpio_v1)
+        return svfctl_v2(cmd, req);
+#endif
+    return svfctl_v1(cmd, req);
+}
+
 #endif
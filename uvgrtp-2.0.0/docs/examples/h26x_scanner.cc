@@ -0,0 +1,494 @@
+#include <uvgrtp/lib.hh>
+#include <uvgrtp/formats/h26x.hh>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+/* Check the start code scanner of the H26x packetizers against the scanner it replaced
+ * and measure the throughput of both
+ *
+ * Usage: ./h26x_scanner [number of random buffers]
+ *
+ * Both scanners, and a byte-by-byte reference, are run over each buffer the way the packetizer
+ * runs them: from the beginning of the buffer to the end, each scan starting where the previous
+ * start code ended. The buffers are:
+ *
+ *   - random buffers with many zero and one bytes
+ *   - every buffer length 0 - 127, covering every tail length 0 - 31 after the 16 and 32-byte
+ *     SIMD blocks, with a 3 or 4-byte start code at every position, including the positions
+ *     where the start code straddles a block boundary
+ *   - runs of 0 - 64 zeros at every position, with and without a 0x01 after the run
+ *
+ * The new scanner must return the same offsets and start code lengths as the reference,
+ * otherwise the program fails. The old scanner does not look at the last 8 bytes of the buffer
+ * and is wrong at some dword alignments, so it does not return the same offsets on every buffer.
+ * The buffers where it differs from the new scanner are counted by the kind of the first difference
+ * after checking that the new scanner agrees with the reference on them.
+ *
+ * The old scanner temporarily writes a zero into the buffer and, if the buffer is shorter
+ * than 8 bytes, the byte before the buffer. The buffers have padding in front of them for that */
+
+#define PADDING      8
+#define BENCH_SIZE   (8 * 1024 * 1024)
+#define BENCH_ROUNDS 20
+
+/* The scanner of uvgRTP 2.0.0 (src/formats/h26x.cc), only the name of the function has been changed */
+#define PTR_DIFF(a, b)  ((ptrdiff_t)((char *)(a) - (char *)(b)))
+
+#define haszero64_le(v) (((v) - 0x0101010101010101) & ~(v) & 0x8080808080808080UL)
+#define haszero32_le(v) (((v) - 0x01010101)         & ~(v) & 0x80808080UL)
+
+#define haszero64_be(v) (((v) - 0x1010101010101010) & ~(v) & 0x0808080808080808UL)
+#define haszero32_be(v) (((v) - 0x10101010)         & ~(v) & 0x08080808UL)
+
+#ifndef __LITTLE_ENDIAN
+#define __LITTLE_ENDIAN 1337
+#endif
+
+#ifndef __BYTE_ORDER
+#define __BYTE_ORDER __LITTLE_ENDIAN
+#endif
+
+static inline unsigned __find_h26x_start(uint32_t value)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    uint16_t u = (value >> 16) & 0xffff;
+    uint16_t l = (value >>  0) & 0xffff;
+
+    bool t1 = (l == 0);
+    bool t2 = ((u & 0xff) == 0x01);
+    bool t3 = (u == 0x0100);
+    bool t4 = (((l >> 8) & 0xff) == 0);
+#else
+    uint16_t u = (value >>  0) & 0xffff;
+    uint16_t l = (value >> 16) & 0xffff;
+
+    bool t1 = (l == 0);
+    bool t2 = (((u >> 8) & 0xff) == 0x01);
+    bool t3 = (u == 0x0001);
+    bool t4 = ((l & 0xff) == 0);
+#endif
+
+    if (t1) {
+        /* 0x00000001 */
+        if (t3)
+            return 4;
+
+        /* "value" definitely has a start code (0x000001XX), but at this
+         * point we can't know for sure whether it's 3 or 4 bytes long.
+         *
+         * Return 5 to indicate that start length could not be determined
+         * and that caller must check previous dword's last byte for 0x00 */
+        if (t2)
+            return 5;
+    } else if (t4 && t3) {
+        /* 0xXX000001 */
+        return 4;
+    }
+
+    return 0;
+}
+
+/* NOTE: the area 0 - len (ie data[0] - data[len - 1]) must be addressable
+ * Do not add offset to "data" ptr before passing it to find_h26x_start_code()! */
+static ssize_t old_find_h26x_start_code(
+    uint8_t *data,
+    size_t len,
+    size_t offset,
+    uint8_t& start_len
+)
+{
+    bool prev_z   = false;
+    bool cur_z    = false;
+    size_t pos    = offset;
+    size_t rpos   = len - (len % 8) - 1;
+    uint8_t *ptr  = data + offset;
+    uint8_t *tmp  = nullptr;
+    uint8_t lb    = 0;
+    uint32_t prev = UINT32_MAX;
+
+    uint64_t prefetch = UINT64_MAX;
+    uint32_t value    = UINT32_MAX;
+    unsigned ret      = 0;
+
+    /* We can get rid of the bounds check when looping through
+     * non-zero 8 byte chunks by setting the last byte to zero.
+     *
+     * This added zero will make the last 8 byte zero check to fail
+     * and when we get out of the loop we can check if we've reached the end */
+    lb = data[rpos];
+    data[rpos] = 0;
+
+    while (pos + 8 < len) {
+        prefetch = *(uint64_t *)ptr;
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+        if (!prev_z && !(cur_z = haszero64_le(prefetch))) {
+#else
+        if (!prev_z && !(cur_z = haszero64_be(prefetch))) {
+#endif
+            /* pos is not used in the following loop so it makes little sense to
+             * update it on every iteration. Faster way to do the loop is to save
+             * ptr's current value before loop, update only ptr in the loop and when
+             * the loop is exited, calculate the difference between tmp and ptr to get
+             * the number of iterations done * 8 */
+            tmp = ptr;
+
+            do {
+                ptr      += 8;
+                prefetch  = *(uint64_t *)ptr;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+                cur_z     = haszero64_le(prefetch);
+#else
+                cur_z     = haszero64_be(prefetch);
+#endif
+            } while (!cur_z);
+
+            pos += PTR_DIFF(ptr, tmp);
+
+            if (pos + 8 >= len)
+                break;
+        }
+
+        value = *(uint32_t *)ptr;
+
+        if (cur_z)
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+            cur_z = haszero32_le(value);
+#else
+            cur_z = haszero32_be(value);
+#endif
+
+        if (!prev_z && !cur_z)
+            goto end;
+
+        /* Previous dword had zeros but this doesn't. The only way there might be a start code
+         * is if the most significant byte of current dword is 0x01 */
+        if (prev_z && !cur_z) {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+            /* previous dword: 0xXX000000 or 0xXXXX0000 and current dword 0x01XXXXXX */
+            if (((value  >> 0) & 0xff) == 0x01 && ((prev >> 16) & 0xffff) == 0) {
+                start_len = (((prev >>  8) & 0xffffff) == 0) ? 4 : 3;
+#else
+            if (((value >> 24) & 0xff) == 0x01 && ((prev >>  0) & 0xffff) == 0) {
+                start_len = (((prev >>  0) & 0xffffff) == 0) ? 4 : 3;
+#endif
+                data[rpos] = lb;
+                return pos + 1;
+            }
+        }
+
+
+        {
+            if ((ret = start_len = __find_h26x_start(value)) > 0) {
+                if (ret == 5) {
+                    ret = 3;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+                    start_len = (((prev >> 24) & 0xff) == 0) ? 4 : 3;
+#else
+                    start_len = (((prev >>  0) & 0xff) == 0) ? 4 : 3;
+#endif
+                }
+
+                data[rpos] = lb;
+                return pos + ret;
+            }
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+            uint16_t u = (value >> 16) & 0xffff;
+            uint16_t l = (value >>  0) & 0xffff;
+            uint16_t p = (prev  >> 16) & 0xffff;
+
+            bool t1 = ((p & 0xffff) == 0);
+            bool t2 = (((p >> 8) & 0xff) == 0);
+            bool t4 = (l == 0x0100);
+            bool t5 = (l == 0x0000 && u == 0x01);
+#else
+            uint16_t u = (value >>  0) & 0xffff;
+            uint16_t l = (value >> 16) & 0xffff;
+            uint16_t p = (prev  >>  0) & 0xffff;
+
+            bool t1 = ((p & 0xffff) == 0);
+            bool t2 = ((p & 0xff) == 0);
+            bool t4 = (l == 0x0001);
+            bool t5 = (l == 0x0000 && u == 0x01);
+#endif
+            if (t1 && t4) {
+                /* previous dword 0xxxxx0000 and current dword is 0x0001XXXX */
+                if (t4) {
+                    start_len = 4;
+                    data[rpos] = lb;
+                    return pos + 2;
+                }
+            /* Previous dwod was 0xXXXXXX00 */
+            } else if (t2) {
+                /* Current dword is 0x000001XX */
+                if (t5) {
+                    start_len = 4;
+                    data[rpos] = lb;
+                    return pos + 3;
+                }
+
+                /* Current dword is 0x0001XXXX */
+                else if (t4) {
+                    start_len = 3;
+                    data[rpos] = lb;
+                    return pos + 2;
+                }
+            }
+
+        }
+end:
+        prev_z = cur_z;
+        pos += 4;
+        ptr += 4;
+        prev = value;
+    }
+
+    data[rpos] = lb;
+    return -1;
+}
+
+/* Reference scanner, the start code is 4 bytes if the byte before 0x000001 is zero
+ * and belongs to the searched area */
+static ssize_t reference_find_start_code(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    for (size_t i = offset; i + 3 < len; ++i) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            start_len = (i > offset && data[i - 1] == 0) ? 4 : 3;
+            return i + 3;
+        }
+    }
+
+    return -1;
+}
+
+struct scan_result {
+    ssize_t offset;
+    uint8_t start_len;
+
+    bool operator==(const scan_result& other) const
+    {
+        return offset == other.offset && (offset < 0 || start_len == other.start_len);
+    }
+};
+
+enum class scanner { reference, old_scan, new_scan };
+
+/* All start codes of the buffer in the order the packetizer finds them */
+static std::vector<scan_result> scan_all(scanner which, uint8_t *data, size_t len)
+{
+    std::vector<scan_result> results;
+    size_t offset = 0;
+
+    for (;;) {
+        scan_result r = { -1, 0 };
+
+        switch (which) {
+            case scanner::reference:
+                r.offset = reference_find_start_code(data, len, offset, r.start_len);
+                break;
+
+            case scanner::old_scan:
+                r.offset = old_find_h26x_start_code(data, len, offset, r.start_len);
+                break;
+
+            case scanner::new_scan:
+                r.offset = uvgrtp::formats::h26x::find_h26x_start_code(data, len, offset, r.start_len);
+                break;
+        }
+
+        if (r.offset < 0)
+            return results;
+
+        results.push_back(r);
+        offset = r.offset;
+    }
+}
+
+struct check_stats {
+    uint64_t buffers;
+    uint64_t new_wrong;
+    uint64_t old_differs;
+    uint64_t old_missed_tail;
+    uint64_t old_missed_other;
+    uint64_t old_wrong_len;
+    uint64_t old_extra;
+};
+
+static void check_buffer(check_stats& stats, uint8_t *data, size_t len, const char *what)
+{
+    std::vector<uint8_t> copy(data, data + len);
+
+    auto ref     = scan_all(scanner::reference, data, len);
+    auto new_res = scan_all(scanner::new_scan, data, len);
+    auto old_res = scan_all(scanner::old_scan, data, len);
+
+    ++stats.buffers;
+
+    if (memcmp(copy.data(), data, len)) {
+        fprintf(stderr, "%s: the old scanner did not restore the buffer (length %zu)\n", what, len);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!(new_res == ref)) {
+        if (stats.new_wrong++ < 5)
+            fprintf(stderr, "%s: the new scanner found %zu start codes in a buffer of %zu bytes, reference %zu\n",
+                what, new_res.size(), len, ref.size());
+        return;
+    }
+
+    if (old_res == new_res)
+        return;
+
+    ++stats.old_differs;
+
+    /* find the first start code where the old scanner went wrong */
+    size_t i = 0;
+
+    while (i < old_res.size() && i < new_res.size() && old_res[i] == new_res[i])
+        ++i;
+
+    if (i < old_res.size() && i < new_res.size() && old_res[i].offset == new_res[i].offset) {
+        ++stats.old_wrong_len;
+    } else if (i < old_res.size() && (i == new_res.size() || old_res[i].offset < new_res[i].offset)) {
+        if (stats.old_extra++ < 5)
+            fprintf(stderr, "%s: the old scanner returned offset %zd in a buffer of %zu bytes that has no start code there\n",
+                what, old_res[i].offset, len);
+    } else if ((size_t)new_res[i].offset - 3 + 8 >= len) {
+        ++stats.old_missed_tail;
+    } else {
+        ++stats.old_missed_other;
+    }
+}
+
+static void put_byte_pattern(std::mt19937& rng, uint8_t *data, size_t len)
+{
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    for (size_t i = 0; i < len; ++i) {
+        int r = dist(rng);
+        data[i] = (r < 96) ? 0 : (r < 128) ? 1 : (uint8_t)r;
+    }
+}
+
+static void check_random(check_stats& stats, std::mt19937& rng, size_t count)
+{
+    std::uniform_int_distribution<size_t> length(0, 4096);
+    std::vector<uint8_t> buf(PADDING + 4096);
+
+    for (size_t n = 0; n < count; ++n) {
+        size_t len = length(rng);
+        put_byte_pattern(rng, buf.data() + PADDING, len);
+        check_buffer(stats, buf.data() + PADDING, len, "random");
+    }
+}
+
+static void check_positions(check_stats& stats)
+{
+    std::vector<uint8_t> buf(PADDING + 128);
+    uint8_t *data = buf.data() + PADDING;
+
+    for (size_t len = 0; len < 128; ++len) {
+        for (size_t code_len = 3; code_len <= 4; ++code_len) {
+            for (size_t pos = 0; pos + code_len <= len; ++pos) {
+                memset(data, 0xff, len);
+                memset(data + pos, 0, code_len - 1);
+                data[pos + code_len - 1] = 1;
+
+                check_buffer(stats, data, len, "position");
+            }
+        }
+
+        /* no start code at all */
+        memset(data, 0xff, len);
+        check_buffer(stats, data, len, "position");
+    }
+}
+
+static void check_zero_runs(check_stats& stats)
+{
+    std::vector<uint8_t> buf(PADDING + 128);
+    uint8_t *data = buf.data() + PADDING;
+
+    for (size_t len = 0; len < 128; ++len) {
+        for (size_t run = 0; run <= 64 && run <= len; ++run) {
+            for (size_t pos = 0; pos + run <= len; ++pos) {
+                for (int one = 0; one <= 1; ++one) {
+                    memset(data, 0xff, len);
+                    memset(data + pos, 0, run);
+
+                    if (one && pos + run < len)
+                        data[pos + run] = 1;
+
+                    check_buffer(stats, data, len, "zero run");
+                }
+            }
+        }
+    }
+}
+
+static double throughput(scanner which, uint8_t *data, size_t len, size_t& found)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BENCH_ROUNDS; ++i)
+        found = scan_all(which, data, len).size();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return (double)len * BENCH_ROUNDS / elapsed.count() / 1e9;
+}
+
+static void benchmark(std::mt19937& rng, const char *what, size_t nal_size)
+{
+    std::vector<uint8_t> buf(PADDING + BENCH_SIZE);
+    uint8_t *data = buf.data() + PADDING;
+    std::uniform_int_distribution<int> dist(2, 255);
+
+    /* NAL units of random non-zero bytes, each starting with a 4-byte start code */
+    for (size_t i = 0; i < BENCH_SIZE; ++i)
+        data[i] = (uint8_t)dist(rng);
+
+    for (size_t i = 0; i + 4 <= BENCH_SIZE; i += nal_size) {
+        memset(data + i, 0, 3);
+        data[i + 3] = 1;
+    }
+
+    size_t old_found = 0, new_found = 0;
+    double old_gbps  = throughput(scanner::old_scan, data, BENCH_SIZE, old_found);
+    double new_gbps  = throughput(scanner::new_scan, data, BENCH_SIZE, new_found);
+
+    fprintf(stdout, "%s (%zu start codes found by the old, %zu by the new scanner): old %.2f GB/s, new %.2f GB/s\n",
+        what, old_found, new_found, old_gbps, new_gbps);
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 20000;
+    std::mt19937 rng(1234);
+    check_stats stats = {};
+
+    check_random(stats, rng, count);
+    check_positions(stats);
+    check_zero_runs(stats);
+
+    fprintf(stdout, "%llu buffers checked\n", (unsigned long long)stats.buffers);
+    fprintf(stdout, "new scanner: %llu buffers differ from the reference\n", (unsigned long long)stats.new_wrong);
+    fprintf(stdout, "old scanner: %llu buffers differ from the new scanner and the reference. The first difference is\n"
+        "  a missed start code in the last 8 bytes:    %llu\n"
+        "  a missed start code elsewhere:              %llu\n"
+        "  a start code of the wrong length:           %llu\n"
+        "  a start code where there is none:           %llu\n",
+        (unsigned long long)stats.old_differs, (unsigned long long)stats.old_missed_tail,
+        (unsigned long long)stats.old_missed_other, (unsigned long long)stats.old_wrong_len,
+        (unsigned long long)stats.old_extra);
+
+    benchmark(rng, "8 MB, a start code every 64 KB", 64 * 1024);
+    benchmark(rng, "8 MB, a start code every 256 bytes", 256);
+
+    return stats.new_wrong ? EXIT_FAILURE : EXIT_SUCCESS;
+}
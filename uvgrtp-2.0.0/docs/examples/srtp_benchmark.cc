@@ -0,0 +1,161 @@
+#include <uvgrtp/lib.hh>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+
+/* Measure how many Gbit/s of media one core can protect with SRTP
+ *
+ * Usage: ./srtp_benchmark [none|ctr|gcm] [frame size] [number of frames]
+ *
+ *   none - plain RTP, the cost of packetization and system calls only
+ *   ctr  - AES-128 counter mode and HMAC-SHA1 authentication (RFC 3711)
+ *   gcm  - AES-128-GCM (RFC 7714)
+ *
+ * Sender and receiver run in the same process over the loopback interface.
+ * The frames are encrypted in the thread that calls push_frame() so the CPU
+ * time of that thread is what it costs to send them. The receiver decrypts the
+ * packets in its own thread and the CPU time of the whole process covers both
+ * directions.
+ *
+ * Every received frame is compared against the frame that was sent. If none of
+ * them arrived intact, the packets did not survive the encryption and decryption
+ * round trip and the program fails. When loopback drops packets, the receiver may
+ * also give out incomplete frames and those are not counted as intact.
+ *
+ * uvgRTP must be built with Crypto++ for "ctr" and "gcm" */
+
+#define KEY_SIZE   16
+#define SALT_SIZE  14
+
+static std::atomic<uint64_t> received_bytes(0);
+static std::atomic<uint64_t> received_frames(0);
+static std::atomic<uint64_t> intact_frames(0);
+
+/* byte "i" of every frame, not constant so that a wrong key stream cannot go unnoticed */
+static uint8_t pattern(size_t i)
+{
+    return (uint8_t)(i * 7 + (i >> 8));
+}
+
+static double cpu_seconds(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void receive_hook(void *arg, uvgrtp::frame::rtp_frame *frame)
+{
+    size_t i = 0;
+
+    while (i < frame->payload_len && frame->payload[i] == pattern(i))
+        ++i;
+
+    if (i == frame->payload_len && i == (size_t)(uintptr_t)arg)
+        intact_frames += 1;
+
+    received_bytes  += frame->payload_len;
+    received_frames += 1;
+
+    (void)uvgrtp::frame::dealloc_frame(frame);
+}
+
+int main(int argc, char **argv)
+{
+    std::string mode = argc > 1 ? argv[1] : "gcm";
+    size_t frame_size = argc > 2 ? atoi(argv[2]) : 100000;
+    int nframes       = argc > 3 ? atoi(argv[3]) : 10000;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+
+    if (mode == "ctr")
+        flags |= RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AUTHENTICATE_RTP;
+    else if (mode == "gcm")
+        flags |= RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AEAD_AES_128_GCM;
+    else if (mode != "none") {
+        fprintf(stderr, "usage: %s [none|ctr|gcm] [frame size] [number of frames]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t key[KEY_SIZE]   = { 0 };
+    uint8_t salt[SALT_SIZE] = { 0 };
+
+    for (int i = 0; i < KEY_SIZE; ++i)
+        key[i] = i;
+
+    for (int i = 0; i < SALT_SIZE; ++i)
+        salt[i] = i * 2;
+
+    /* See srtp_user.cc for more details about user-managed keys */
+    uvgrtp::context ctx;
+    uvgrtp::session *sess = ctx.create_session("127.0.0.1");
+
+    uvgrtp::media_stream *recv = sess->create_stream(8889, 8888, RTP_FORMAT_GENERIC, flags);
+    uvgrtp::media_stream *send = sess->create_stream(8888, 8889, RTP_FORMAT_GENERIC, flags);
+
+    if (!recv || !send) {
+        fprintf(stderr, "Failed to create the media streams\n");
+        return EXIT_FAILURE;
+    }
+
+    if (flags & RCE_SRTP) {
+        recv->add_srtp_ctx(key, salt);
+        send->add_srtp_ctx(key, salt);
+    }
+
+    /* a large receive buffer so that the receiver keeps up with bursts */
+    recv->configure_ctx(RCC_UDP_RCV_BUF_SIZE, 64 * 1024 * 1024);
+    recv->install_receive_hook((void *)(uintptr_t)frame_size, receive_hook);
+
+    uint8_t *frame = new uint8_t[frame_size];
+
+    for (size_t i = 0; i < frame_size; ++i)
+        frame[i] = pattern(i);
+
+    auto start         = std::chrono::steady_clock::now();
+    double send_start  = cpu_seconds(CLOCK_THREAD_CPUTIME_ID);
+    double total_start = cpu_seconds(CLOCK_PROCESS_CPUTIME_ID);
+
+    for (int i = 0; i < nframes; ++i) {
+        if (send->push_frame(frame, frame_size, RTP_NO_FLAGS) != RTP_OK) {
+            fprintf(stderr, "Failed to send frame %d\n", i);
+            break;
+        }
+
+        /* let the receiver drain the socket now and then so that loopback does not drop packets */
+        if (i % 8 == 7)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    double send_cpu = cpu_seconds(CLOCK_THREAD_CPUTIME_ID) - send_start;
+
+    /* wait until the receiver has seen every frame or nothing arrives in 500 ms */
+    for (uint64_t last = ~0ull; last != received_frames; ) {
+        last = received_frames;
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    double total_cpu = cpu_seconds(CLOCK_PROCESS_CPUTIME_ID) - total_start;
+    double wall      = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double sent_bits = 8.0 * frame_size * nframes;
+    double recv_bits = 8.0 * received_bytes;
+
+    fprintf(stdout, "mode %s, %d frames of %zu bytes, %llu frames received, %llu of them intact\n",
+        mode.c_str(), nframes, frame_size, (unsigned long long)received_frames,
+        (unsigned long long)intact_frames);
+    fprintf(stdout, "send:        %.2f Gbit/s per core (%.3f s CPU)\n", sent_bits / send_cpu / 1e9, send_cpu);
+    fprintf(stdout, "send + recv: %.2f Gbit/s per core (%.3f s CPU, %.3f s wall clock)\n",
+        recv_bits / total_cpu / 1e9, total_cpu, wall);
+
+    sess->destroy_stream(send);
+    sess->destroy_stream(recv);
+    ctx.destroy_session(sess);
+    delete[] frame;
+
+    return intact_frames ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,132 @@
+#include <uvgrtp/lib.hh>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+
+/* Send frames at scheduled launch times with SO_TXTIME (RCE_TXTIME)
+ *
+ * Usage: ./txtime [fq|etf]
+ *
+ * The frames are sent over the loopback interface and its qdisc must honor the launch time,
+ * f.ex. "tc qdisc replace dev lo root fq" for fq. See tc-etf(8) for how to set up etf.
+ *
+ * All frames are given to uvgRTP at once, each with a launch time INTERVAL_MS later than
+ * the previous one. If the launch times were attached to the packets (SCM_TXTIME), the
+ * receiver sees the frames arrive INTERVAL_MS apart, otherwise they all arrive at once.
+ *
+ * The last frame is given a launch time that has already passed. etf drops it and reports
+ * the drop in the error queue of the socket which uvgRTP reads after every send and counts
+ * in stream_stats::txtime_errors. fq sends late packets immediately and reports nothing */
+
+#define FRAMES       10
+#define INTERVAL_MS  20
+#define PAYLOAD_LEN  1000
+
+static uint64_t arrivals[FRAMES];
+static std::atomic<int> received(0);
+
+static uint64_t now_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void receive_hook(void *arg, uvgrtp::frame::rtp_frame *frame)
+{
+    (void)arg;
+
+    /* "arrival" is the kernel receive timestamp of the frame as NTP timestamp */
+    int i = received++;
+
+    if (i < FRAMES)
+        arrivals[i] = frame->arrival;
+
+    (void)uvgrtp::frame::dealloc_frame(frame);
+}
+
+int main(int argc, char **argv)
+{
+    std::string qdisc = argc > 1 ? argv[1] : "fq";
+
+    if (qdisc != "fq" && qdisc != "etf") {
+        fprintf(stderr, "usage: %s [fq|etf]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* fq schedules the packets by CLOCK_MONOTONIC, etf by CLOCK_TAI */
+    clockid_t clock = (qdisc == "fq") ? CLOCK_MONOTONIC : CLOCK_TAI;
+
+    uvgrtp::context ctx;
+    uvgrtp::session *sess = ctx.create_session("127.0.0.1");
+
+    uvgrtp::media_stream *recv = sess->create_stream(8889, 8888, RTP_FORMAT_GENERIC, RTP_NO_FLAGS);
+    uvgrtp::media_stream *send = sess->create_stream(8888, 8889, RTP_FORMAT_GENERIC, RCE_TXTIME);
+
+    if (!recv || !send) {
+        fprintf(stderr, "Failed to create the media streams, SO_TXTIME may not be supported\n");
+        return EXIT_FAILURE;
+    }
+
+    if (send->configure_ctx(RCC_TXTIME_CLOCK, clock) != RTP_OK) {
+        fprintf(stderr, "Failed to set the clock of the launch times\n");
+        return EXIT_FAILURE;
+    }
+
+    recv->install_receive_hook(nullptr, receive_hook);
+
+    uint8_t payload[PAYLOAD_LEN];
+    memset(payload, 'a', sizeof(payload));
+
+    /* leave some time for the first frame to reach the qdisc before its launch time */
+    uint64_t launch = now_ns(clock) + 10 * 1000000ull;
+
+    for (int i = 0; i < FRAMES; ++i) {
+        if (send->push_frame(payload, sizeof(payload), i * 90 * INTERVAL_MS, launch, RTP_NO_FLAGS) != RTP_OK)
+            fprintf(stderr, "Failed to send frame %d\n", i);
+
+        launch += INTERVAL_MS * 1000000ull;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(FRAMES * INTERVAL_MS + 100));
+
+    int on_time = received;
+
+    fprintf(stdout, "%d/%d frames received, %d ms apart by their launch times\n", on_time, FRAMES, INTERVAL_MS);
+
+    for (int i = 1; i < on_time && i < FRAMES; ++i) {
+        /* the arrival times are NTP timestamps, 2^32 units per second */
+        uint64_t diff_us = ((arrivals[i] - arrivals[i - 1]) * 1000000) >> 32;
+        fprintf(stdout, "frame %d arrived %.2f ms after the previous one\n", i, diff_us / 1000.0);
+    }
+
+    /* a launch time one second ago */
+    if (send->push_frame(payload, sizeof(payload), FRAMES * 90 * INTERVAL_MS, now_ns(clock) - 1000000000ull, RTP_NO_FLAGS) != RTP_OK)
+        fprintf(stderr, "Failed to send the late frame\n");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    bool late_received = received > on_time;
+
+    /* the error queue is read after each send, push one more frame on time so the late one gets counted */
+    (void)send->push_frame(payload, sizeof(payload), (FRAMES + 1) * 90 * INTERVAL_MS, now_ns(clock) + 1000000ull, RTP_NO_FLAGS);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    uvgrtp::stream_stats stats;
+    send->get_stats(stats);
+
+    fprintf(stdout, "late frame %s, %llu packets dropped by the qdisc because of their launch time\n",
+        late_received ? "was received" : "was dropped", (unsigned long long)stats.txtime_errors);
+
+    sess->destroy_stream(send);
+    sess->destroy_stream(recv);
+    ctx.destroy_session(sess);
+
+    return EXIT_SUCCESS;
+}
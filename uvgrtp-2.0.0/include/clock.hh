@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <ctime>
 
 namespace uvgrtp {
     namespace clock {
@@ -9,6 +10,9 @@ namespace uvgrtp {
         namespace ntp {
             uint64_t now();
 
+            /* Convert a CLOCK_REALTIME reading (f.ex. a kernel receive timestamp) to NTP format */
+            uint64_t from_timespec(const struct timespec& ts);
+
             /* return the difference of ntp timestamps in milliseconds */
             uint64_t diff(uint64_t ntp1, uint64_t ntp2);
 
@@ -17,6 +21,10 @@ namespace uvgrtp {
              *
              * The result is in milliseconds */
             uint64_t diff_now(uint64_t then);
+
+            /* Return the difference of ntp timestamps in units of a clock
+             * that runs at "clock_rate" Hz (f.ex. RTP timestamp units) */
+            uint32_t diff_rtp(uint64_t ntp1, uint64_t ntp2, uint32_t clock_rate);
         };
 
         /* high-resolution clock */
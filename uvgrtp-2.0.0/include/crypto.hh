@@ -4,6 +4,7 @@
     __has_include(<cryptopp/base32.h>) && \
     __has_include(<cryptopp/cryptlib.h>) && \
     __has_include(<cryptopp/dh.h>) && \
+    __has_include(<cryptopp/gcm.h>) && \
     __has_include(<cryptopp/hmac.h>) && \
     __has_include(<cryptopp/modes.h>) && \
     __has_include(<cryptopp/osrng.h>) && \
@@ -17,6 +18,7 @@
 #include <cryptopp/base32.h>
 #include <cryptopp/cryptlib.h>
 #include <cryptopp/dh.h>
+#include <cryptopp/gcm.h>
 #include <cryptopp/hmac.h>
 #include <cryptopp/modes.h>
 #include <cryptopp/osrng.h>
@@ -117,10 +119,41 @@ namespace uvgrtp {
                     void encrypt(uint8_t *output, uint8_t *input, size_t len);
                     void decrypt(uint8_t *output, uint8_t *input, size_t len);
 
+                    /* Restart the key stream from "iv" without rerunning the key schedule */
+                    void set_iv(uint8_t *iv);
+
                 private:
 #ifdef __RTP_CRYPTO__
                     CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption enc_;
                     CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption dec_;
+#endif
+            };
+
+            /* AEAD cipher, Crypto++ uses AES-NI and PCLMULQDQ (x86)
+             * or the ARMv8 cryptography extensions if the CPU supports them */
+            class gcm {
+                public:
+                    gcm(uint8_t *key, size_t key_size);
+                    ~gcm();
+
+                    /* Encrypt "len" bytes of "input" to "output", authenticate
+                     * the ciphertext and "aad" and write "tag_len" bytes of tag to "tag" */
+                    void encrypt(uint8_t *output, uint8_t *input, size_t len,
+                                 uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len,
+                                 uint8_t *tag, size_t tag_len);
+
+                    /* Verify "tag" and decrypt "len" bytes of "input" to "output"
+                     *
+                     * Return true if the tag is valid
+                     * Return false otherwise */
+                    bool decrypt(uint8_t *output, uint8_t *input, size_t len,
+                                 uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len,
+                                 uint8_t *tag, size_t tag_len);
+
+                private:
+#ifdef __RTP_CRYPTO__
+                    CryptoPP::GCM<CryptoPP::AES>::Encryption enc_;
+                    CryptoPP::GCM<CryptoPP::AES>::Decryption dec_;
 #endif
             };
         };
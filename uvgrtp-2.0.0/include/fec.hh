@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+
+#include "frame.hh"
+#include "rtp.hh"
+#include "socket.hh"
+#include "util.hh"
+
+namespace uvgrtp {
+
+    /* Size of the FEC header that follows the RTP header of a parity packet */
+    const int FEC_HDR_SIZE = 16;
+
+    /* How many of the most recently received media packets are kept for recovery */
+    const int FEC_RECV_HISTORY = 1024;
+
+    /* XOR parity forward error correction (RCE_FEC)
+     *
+     * The packets of a frame are divided into N interleaved groups so that packet i of the frame
+     * belongs to group i % N. For each group the sender sends a parity packet that has
+     * the same SSRC and timestamp as the media but its own payload type and sequence numbers.
+     * The payload of a parity packet is the FEC header:
+     *
+     *   0-1   XOR of the first two bytes of the RTP headers of the protected packets
+     *   2-3   XOR of the lengths of the protected packets, excluding the RTP header
+     *   4-7   XOR of the RTP timestamps of the protected packets
+     *   8-9   sequence number of the first protected packet
+     *   10-11 number of protected packets
+     *   12-13 distance between the sequence numbers of the protected packets (N)
+     *   14-15 reserved
+     *
+     * followed by the XOR of the payloads of the protected packets, zero-padded to the longest one.
+     *
+     * The parity is calculated over the packets as they were sent so with SRTP the rebuilt
+     * packet is authenticated and decrypted like any other packet. The scheme follows
+     * the idea of FlexFEC (RFC 8627) but it is not wire-compatible with it */
+    class fec {
+        public:
+            fec(uvgrtp::rtp *rtp);
+            ~fec();
+
+            /* Calculate and send the parity packets of a frame whose packets have already been sent
+             *
+             * The parity packets are sent at "launch_time" (RCE_TXTIME), or immediately if it is 0,
+             * so that they do not overtake the media packets of the frame
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending a parity packet failed */
+            rtp_error_t protect(uvgrtp::socket *socket, uvgrtp::pkt_vec& packets, uint64_t launch_time);
+
+            /* Receiver's auxiliary handler, it must be installed before the other auxiliary handlers
+             *
+             * Media packets are copied aside as they were received and passed on.
+             * Parity packets are consumed and if exactly one packet of their group is missing,
+             * the packet is rebuilt in place of the parity packet and passed on as if it had been received
+             *
+             * Return RTP_PKT_NOT_HANDLED if the packet should be passed on as is
+             * Return RTP_PKT_MODIFIED if "out" now holds a rebuilt packet
+             * Return RTP_OK if the packet was consumed */
+            static rtp_error_t packet_handler(void *arg, int flags, frame::rtp_frame **out);
+
+            /* Receiver's auxiliary handler, it must be installed after the other auxiliary handlers
+             *
+             * The copy made by packet_handler() is added to the recovery history only here, after
+             * SRTP has authenticated the packet, so that a forged packet cannot take the place
+             * of an authentic one in the history. Duplicates of packets in the history are dropped
+             *
+             * Return RTP_PKT_NOT_HANDLED if the packet should be passed on as is
+             * Return RTP_OK if the packet was a duplicate and it was consumed */
+            static rtp_error_t history_handler(void *arg, int flags, frame::rtp_frame **out);
+
+        private:
+            /* Rebuild the missing packet of the group of parity packet "frame" into "frame"
+             *
+             * Return RTP_OK if the packet was rebuilt
+             * Return RTP_NOT_FOUND if no packet or more than one packet of the group is missing
+             * Return RTP_INVALID_VALUE if the parity packet is malformed */
+            rtp_error_t recover(uvgrtp::frame::rtp_frame *frame);
+
+            /* Copy the datagram of a received packet aside until history_handler() sees it
+             *
+             * SRTP decrypts the packet in place but the parity is calculated over the packets
+             * as they were sent so the datagram must be copied before it is authenticated */
+            void stage_packet(uint16_t seq, uint8_t *dgram, size_t len);
+
+            uvgrtp::rtp *rtp_;
+
+            /* Sequence number of the next parity packet and the buffer it is built in */
+            uint16_t seq_;
+            std::vector<uint8_t> parity_;
+
+            /* Received media packets indexed by sequence number modulo FEC_RECV_HISTORY */
+            struct fec_packet {
+                bool valid;
+                uint16_t seq;
+                std::vector<uint8_t> data;
+            };
+            std::vector<fec_packet> history_;
+
+            /* The packet copied by packet_handler() that has not yet reached history_handler() */
+            fec_packet staged_;
+    };
+};
+
+namespace uvg_rtp = uvgrtp;
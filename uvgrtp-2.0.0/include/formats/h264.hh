@@ -59,6 +59,7 @@ namespace uvgrtp {
             std::deque<uvgrtp::frame::rtp_frame *> queued;
             std::unordered_map<uint32_t, h264_info_t> frames;
             std::unordered_set<uint32_t> dropped;
+            uvgrtp::rtp *rtp_ctx;
         } h264_frame_info_t;
 
         class h264 : public h26x {
@@ -50,19 +50,43 @@ namespace uvgrtp {
             /* total size of all fragments */
             size_t total_size;
 
-            /* map of frame's fragments,
-             * allows out-of-order insertion and loop-through in order */
-            std::map<uint32_t, uvgrtp::frame::rtp_frame *> fragments;
+            /* NAL unit type carried in the FU header (intra/inter/other) */
+            uint8_t nal_type;
 
-            /* storage for fragments that require relocation */
-            std::vector<uvgrtp::frame::rtp_frame *> temporary;
+            /* fragments in arrival order, sorted by sequence number relative
+             * to s_seq when the frame is reconstructed */
+            std::vector<uvgrtp::frame::rtp_frame *> fragments;
         } h265_info_t;
 
+        /* Maximum number of incomplete frames held by the depacketizer. When a new
+         * frame is started and the window is full, the oldest frame is dropped */
+        const size_t H265_FRAME_WINDOW = 32;
+
+        /* Number of dropped timestamps remembered so that late fragments of
+         * a dropped frame can be discarded. Oldest entries are overwritten */
+        const size_t H265_DROPPED_MAX = 64;
+
         typedef struct {
             std::deque<uvgrtp::frame::rtp_frame *> queued;
             std::unordered_map<uint32_t, h265_info_t> frames;
-            std::unordered_set<uint32_t> dropped;
             uvgrtp::rtp *rtp_ctx;
+
+            /* ring of recently dropped timestamps */
+            uint32_t dropped[H265_DROPPED_MAX];
+            size_t dropped_pos;
+            size_t dropped_num;
+
+            /* timestamp of the intra frame currently being received or INVALID_TS */
+            uint32_t intra;
+
+            /* set when a frame has been lost, inter frames are discarded until
+             * the next intra frame has been received */
+            bool wait_intra;
+
+            /* number of frames dropped because they were late or incomplete,
+             * and number of inter frames discarded while waiting for an intra */
+            size_t lost;
+            size_t discarded;
         } h265_frame_info_t;
 
         class h265 : public h26x {
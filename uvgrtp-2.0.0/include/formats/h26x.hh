@@ -1,8 +1,8 @@
 #pragma once
 
-#include "frame.hh"
+#include "../frame.hh"
 #include "media.hh"
-#include "queue.hh"
+#include "../queue.hh"
 
 namespace uvgrtp {
 
@@ -16,9 +16,11 @@ namespace uvgrtp {
                 /* Find H26x start code from "data"
                  * This process is the same for H26{4,5,6}
                  *
-                 * Return the offset of the start code on success
+                 * "data" is only read so read-only (e.g. mmapped) buffers can be packetized
+                 *
+                 * Return the offset of the first byte after the start code on success
                  * Return -1 if no start code was found */
-                ssize_t find_h26x_start_code(uint8_t *data, size_t len, size_t offset, uint8_t& start_len);
+                static ssize_t find_h26x_start_code(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len);
 
                 /* Top-level push_frame() called by the Media class
                  * Sets up the frame queue for the send operation
@@ -4,27 +4,54 @@
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "../rtp.hh"
 #include "../socket.hh"
 #include "../queue.hh"
 #include "../util.hh"
+#include "../clock.hh"
 
 namespace uvgrtp {
 
     namespace formats {
 
+        /* Maximum number of partially received generic frames kept at any time.
+         * If a new frame arrives when the window is full, the oldest partial
+         * frame is evicted and counted as lost */
+        const size_t GENERIC_FRAME_WINDOW = 32;
+
+        /* Number of dropped timestamps remembered so that late fragments of
+         * a dropped frame are discarded instead of returned as frames */
+        const size_t GENERIC_DROPPED_MAX = 64;
+
         typedef struct media_info {
+            /* clock reading when the first fragment is received */
+            uvgrtp::clock::hrc::hrc_t sframe_time;
+
             uint32_t s_seq;
             uint32_t e_seq;
             size_t npkts;
             size_t size;
-            std::map<uint16_t, uvgrtp::frame::rtp_frame *> fragments;
+
+            /* fragments in arrival order, sorted by sequence number
+             * relative to s_seq when the frame is assembled */
+            std::vector<uvgrtp::frame::rtp_frame *> fragments;
         } media_info_t;
 
         typedef struct media_frame_info {
             std::unordered_map<uint32_t, media_info> frames;
-            std::unordered_set<uint32_t> dropped;
+
+            /* ring of recently dropped timestamps */
+            uint32_t dropped[GENERIC_DROPPED_MAX];
+            size_t dropped_pos;
+            size_t dropped_num;
+
+            /* used to query the maximum frame delay (RCC_PKT_MAX_DELAY) */
+            uvgrtp::rtp *rtp_ctx;
+
+            /* number of partial frames evicted from the reassembly window */
+            size_t lost;
         } media_frame_info_t;
 
         class media {
@@ -55,6 +82,9 @@ namespace uvgrtp {
                 /* Return pointer to the internal frame info structure which is relayed to packet handler */
                 media_frame_info_t *get_media_frame_info();
 
+                /* Return pointer to the frame queue used to send the frames of this media */
+                uvgrtp::frame_queue *get_frame_queue();
+
             protected:
                 virtual rtp_error_t push_media_frame(uint8_t *data, size_t data_len, int flags);
 
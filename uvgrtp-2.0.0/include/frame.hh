@@ -8,6 +8,8 @@
 #include <netinet/in.h>
 #endif
 
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -37,11 +39,12 @@ namespace uvgrtp {
         };
 
         enum RTCP_FRAME_TYPE {
-            RTCP_FT_SR   = 200, /* Sender report */
-            RTCP_FT_RR   = 201, /* Receiver report */
-            RTCP_FT_SDES = 202, /* Source description */
-            RTCP_FT_BYE  = 203, /* Goodbye */
-            RTCP_FT_APP  = 204  /* Application-specific message */
+            RTCP_FT_SR    = 200, /* Sender report */
+            RTCP_FT_RR    = 201, /* Receiver report */
+            RTCP_FT_SDES  = 202, /* Source description */
+            RTCP_FT_BYE   = 203, /* Goodbye */
+            RTCP_FT_APP   = 204, /* Application-specific message */
+            RTCP_FT_RTPFB = 205  /* Transport layer feedback message */
         };
 
         PACK(struct rtp_header {
@@ -62,6 +65,8 @@ namespace uvgrtp {
             uint8_t *data;
         });
 
+        struct dgram_buffer;
+
         struct rtp_frame {
             struct rtp_header header;
             uint32_t *csrc;
@@ -87,9 +92,18 @@ namespace uvgrtp {
             uint8_t *dgram;      /* pointer to the UDP datagram (for internal use only) */
             size_t   dgram_size; /* size of the UDP datagram */
 
+            /* Receive buffer that holds the frame, its CSRC list, extension header and payload.
+             * nullptr if the frame owns its memory (for internal use only) */
+            dgram_buffer *dgram_buf;
+
             rtp_format_t format;
             int  type;
-            sockaddr_in src_addr;
+            sockaddr_storage src_addr;
+
+            /* Arrival time of the datagram that completed the frame as a 64-bit NTP timestamp.
+             * On Linux this is the kernel receive timestamp of the datagram,
+             * elsewhere the time the packet dispatcher read it from the socket */
+            uint64_t arrival;
         };
 
         struct rtcp_header {
@@ -162,6 +176,66 @@ namespace uvgrtp {
             uint8_t payload[1];
         });
 
+        class dgram_pool;
+
+        /* Receive buffer for one UDP datagram
+         *
+         * The datagram is stored right after this header so the buffer can be located from
+         * the datagram pointer packet dispatcher passes to the primary handlers.
+         *
+         * The RTP frame created from the datagram lives inside the buffer and its
+         * CSRC list, extension header and payload point into the buffer, so in steady state
+         * receiving a packet does not allocate any memory.
+         *
+         * The buffer is returned to its pool when the last reference to it is dropped */
+        struct dgram_buffer {
+            dgram_pool *pool;
+            std::atomic<int> refs;
+
+            rtp_frame  frame;
+            ext_header ext;
+            uint32_t   csrc[15];
+        };
+
+        class dgram_pool {
+            public:
+                /* Create a pool of receive buffers that can hold datagrams of "dgram_size" bytes */
+                dgram_pool(size_t dgram_size);
+
+                /* Get a free buffer from the pool, new buffer is allocated only if the pool is empty
+                 *
+                 * The caller holds one reference to the returned buffer */
+                dgram_buffer *get_buffer();
+
+                /* Release the pool. Free buffers are deallocated immediately and the pool
+                 * itself is destroyed when the last buffer still in use is returned to it */
+                void release();
+
+                /* Take/drop a reference to "buffer". When the last reference is dropped,
+                 * the buffer is returned to the pool it was taken from */
+                static void ref_buffer(dgram_buffer *buffer);
+                static void put_buffer(dgram_buffer *buffer);
+
+                /* Get the datagram of "buffer" and the buffer of datagram "dgram"
+                 *
+                 * NOTE: "dgram" must point to the start of a datagram returned by get_dgram() */
+                static uint8_t *get_dgram(dgram_buffer *buffer);
+                static dgram_buffer *get_dgram_buffer(void *dgram);
+
+            private:
+                ~dgram_pool();
+
+                /* Return "buffer" to the free list or deallocate it if the pool has been released */
+                void return_buffer(dgram_buffer *buffer);
+
+                std::mutex mtx_;
+                std::vector<dgram_buffer *> free_;
+
+                size_t dgram_size_;
+                size_t outstanding_;
+                bool released_;
+        };
+
         /* Allocate an RTP frame
          *
          * First function allocates an empty RTP frame (no payload)
@@ -178,6 +252,16 @@ namespace uvgrtp {
         rtp_frame *alloc_rtp_frame(size_t payload_len);
         rtp_frame *alloc_rtp_frame(size_t payload_len, size_t pz_size);
 
+        /* Allocate an RTP frame from receive buffer "buffer"
+         *
+         * The frame is stored inside the buffer and it takes a reference to the buffer
+         * which is dropped when the frame is deallocated. Payload of the frame is not set
+         *
+         * Return pointer to frame on success
+         * Return nullptr on error and set rtp_errno to:
+         *    RTP_INVALID_VALUE if "buffer" is nullptr */
+        rtp_frame *alloc_rtp_frame(dgram_buffer *buffer);
+
         /* Allocate ZRTP frame
          * Parameter "payload_size" defines the length of the frame 
          *
@@ -188,6 +272,8 @@ namespace uvgrtp {
         zrtp_frame *alloc_zrtp_frame(size_t payload_size);
 
         /* Deallocate RTP frame
+         *
+         * If the frame was allocated from a receive buffer, the buffer is returned to its pool
          *
          * Return RTP_OK on successs
          * Return RTP_INVALID_VALUE if "frame" is nullptr */
@@ -2,6 +2,7 @@
 
 #include <atomic>
 
+#include "reactor.hh"
 #include "runner.hh"
 #include "socket.hh"
 #include "util.hh"
@@ -19,6 +20,12 @@ namespace uvgrtp {
              * Return RTP_MEMORY_ERROR if allocation fails */
             rtp_error_t start();
 
+            /* Start the holepuncher as a periodic timer of a shared reactor
+             *
+             * Return RTP_OK on success
+             * Return RTP_GENERIC_ERROR if the timer could not be created */
+            rtp_error_t start(uvgrtp::reactor *reactor);
+
             /* Stop the holepuncher */
             rtp_error_t stop();
 
@@ -29,7 +36,15 @@ namespace uvgrtp {
         private:
             void keepalive();
 
+            /* Send a keepalive datagram if nothing has been sent for a while */
+            void send_keepalive();
+
+            /* Reactor timer handler */
+            static void reactor_handler(void *arg);
+
             uvgrtp::socket *socket_;
+            uvgrtp::reactor *reactor_;
+            uint32_t reactor_key_;
             std::atomic<uint64_t> last_dgram_sent_;
     };
 };
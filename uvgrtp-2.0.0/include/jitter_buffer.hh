@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "clock.hh"
+#include "frame.hh"
+#include "rtcp.hh"
+#include "rtp.hh"
+#include "runner.hh"
+#include "util.hh"
+
+namespace uvgrtp {
+
+    /* The playout delay aims at this many times the interarrival jitter */
+    const int JITTER_MULTIPLIER = 4;
+
+    typedef void (*jitter_release)(void *arg, uvgrtp::frame::rtp_frame *frame);
+
+    /* Receive-side jitter buffer (RCE_JITTER_BUFFER)
+     *
+     * Frames are kept in RTP timestamp order and each frame is released at
+     *
+     *   playout = timestamp + base transit + delay
+     *
+     * where the base transit is the smallest observed difference between the arrival time
+     * and the RTP timestamp of a frame (it follows slow clock drift upwards) and the delay
+     * follows JITTER_MULTIPLIER times the interarrival jitter measured by RTCP, limited by
+     * RCC_PLAYOUT_DELAY_MIN and RCC_PLAYOUT_DELAY_MAX.
+     *
+     * The frames are released from the jitter buffer's own thread */
+    class jitter_buffer : public runner {
+        public:
+            jitter_buffer(uvgrtp::rtp *rtp, uvgrtp::rtcp *rtcp);
+            ~jitter_buffer();
+
+            /* Start the release thread, "release" is called with "arg" for every frame at its playout time
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR if the thread could not be created */
+            rtp_error_t start(void *arg, jitter_release release);
+
+            /* Stop the release thread and deallocate the frames that have not been released */
+            rtp_error_t stop();
+
+            /* Schedule "frame" for playout. Called by the packet dispatcher
+             * from the same thread that updates the RTCP statistics */
+            void insert(uvgrtp::frame::rtp_frame *frame);
+
+        private:
+            struct playout_frame {
+                int64_t ts;      /* extended RTP timestamp */
+                int64_t playout; /* playout time in microseconds since "epoch_" */
+                uvgrtp::frame::rtp_frame *frame;
+            };
+
+            void release_frames();
+
+            uvgrtp::rtp *rtp_;
+            uvgrtp::rtcp *rtcp_;
+
+            void *arg_;
+            jitter_release release_;
+
+            std::mutex mtx_;
+            std::condition_variable cv_;
+            std::deque<playout_frame> frames_;
+
+            /* Playout state of the current source, reset when the SSRC changes */
+            bool init_;
+            uint32_t ssrc_;
+            uvgrtp::clock::hrc::hrc_t epoch_;
+            int64_t max_ts_;      /* largest extended timestamp received */
+            int64_t released_ts_; /* extended timestamp of the last released frame */
+            double base_transit_; /* microseconds */
+            double delay_;        /* microseconds */
+    };
+};
+
+namespace uvg_rtp = uvgrtp;
@@ -19,14 +19,16 @@ namespace uvgrtp {
              * \brief RTP context destructor
              *
              * \details This does not destroy active sessions. They must be destroyed manually
-             * by calling uvgrtp::context::destroy_session()
+             * by calling uvgrtp::context::destroy_session() before the context is destroyed
+             * if any of their media streams use the shared reactor (see @ref RCE_SHARED_REACTOR)
              */
             ~context();
 
             /**
              * \brief Create a new RTP session
              *
-             * \param addr IPv4 address of the remote participant
+             * \param addr IPv4 or IPv6 address of the remote participant. A link-local
+             * IPv6 address must include the interface, for example "fe80::1%eth0"
              *
              * \return RTP session object
              *
@@ -44,8 +46,11 @@ namespace uvgrtp {
              * should bind itself to. If you are using uvgRTP for unidirectional streaming,
              * please take a look at @ref RCE_HOLEPUNCH_KEEPALIVE
              *
-             * \param remote_addr IPv4 address of the remote participant
-             * \param local_addr  IPv4 address of a local interface
+             * \param remote_addr IPv4 or IPv6 address of the remote participant
+             * \param local_addr  IPv4 or IPv6 address of a local interface
+             *
+             * If either address is IPv6, the media streams use dual-stack IPv6 sockets
+             * and an IPv4 address is used as an IPv4-mapped IPv6 address
              *
              * \return RTP session object
              *
@@ -77,6 +82,10 @@ namespace uvgrtp {
 
             /* CNAME is the same for all connections */
             std::string cname_;
+
+            /* Shared reactor for the media streams created with RCE_SHARED_REACTOR.
+             * Its threads are started when the first stream registers to it */
+            uvgrtp::reactor *reactor_;
         };
 };
 
@@ -3,10 +3,15 @@
 #include <unordered_map>
 #include <memory>
 
+#include "fec.hh"
 #include "holepuncher.hh"
+#include "jitter_buffer.hh"
+#include "multicast.hh"
 #include "pkt_dispatch.hh"
+#include "reactor.hh"
 #include "rtcp.hh"
 #include "socket.hh"
+#include "stats.hh"
 #include "srtp/srtcp.hh"
 #include "srtp/srtp.hh"
 #include "util.hh"
@@ -180,6 +185,53 @@ namespace uvgrtp {
              */
             rtp_error_t push_frame(std::unique_ptr<uint8_t[]> data, size_t data_len, uint32_t ts, int flags);
 
+            /**
+             * \brief Send data to remote participant at a given launch time
+             *
+             * \details The packets of the frame are given to the kernel immediately but
+             * the qdisc of the outgoing interface holds them until "launch_time" (SO_TXTIME),
+             * so the send time does not depend on when the calling thread is scheduled.
+             * Requires ::RCE_TXTIME, see it for the qdiscs that honor the launch time.
+             * A launch time that has already passed sends the frame immediately with fq,
+             * etf drops such packets
+             *
+             * \param data Pointer to data the that should be sent
+             * \param data_len Length of data
+             * \param ts 32-bit timestamp value for the data
+             * \param launch_time Launch time of the first packet in nanoseconds of ::RCC_TXTIME_CLOCK
+             * \param flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If one of the parameters are invalid or RCE_TXTIME is not enabled
+             * \retval  RTP_MEMORY_ERROR  If the data chunk is too large to be processed
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_GENERIC_ERROR If an unspecified error occurred
+             */
+            rtp_error_t push_frame(uint8_t *data, size_t data_len, uint32_t ts, uint64_t launch_time, int flags);
+
+            /**
+             * \brief Send data to remote participant at a given launch time
+             *
+             * \details Same as the push_frame() above but takes the ownership of "data"
+             *
+             * \param data Smart pointer to data the that should be sent
+             * \param data_len Length of data
+             * \param ts 32-bit timestamp value for the data
+             * \param launch_time Launch time of the first packet in nanoseconds of ::RCC_TXTIME_CLOCK
+             * \param flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If one of the parameters are invalid or RCE_TXTIME is not enabled
+             * \retval  RTP_MEMORY_ERROR  If the data chunk is too large to be processed
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_GENERIC_ERROR If an unspecified error occurred
+             */
+            rtp_error_t push_frame(std::unique_ptr<uint8_t[]> data, size_t data_len, uint32_t ts, uint64_t launch_time, int flags);
+
             /**
              * \brief Poll a frame indefinitely from the media stream object
              *
@@ -260,6 +312,58 @@ namespace uvgrtp {
              */
             rtp_error_t configure_ctx(int flag, ssize_t value);
 
+            /**
+             * \brief Join an IP multicast group
+             *
+             * \details If the remote address of the session is a multicast group, the media stream
+             * joins it automatically when it is created. This function can be used to receive
+             * from additional groups. The group is joined on the interface of the local address
+             * of the session, if one was given
+             *
+             * The TTL and loopback of the multicast packets can be set with
+             * ::RCC_MULTICAST_TTL and ::RCC_MULTICAST_LOOPBACK
+             *
+             * \param group IPv4 or IPv6 multicast address
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "group" is not a multicast address
+             * \retval RTP_GENERIC_ERROR If joining the group failed
+             * \retval RTP_NOT_INITIALIZED If the media stream has not been initialized
+             */
+            rtp_error_t join_multicast(std::string group);
+
+            /**
+             * \brief Leave an IP multicast group
+             *
+             * \param group IPv4 or IPv6 multicast address
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "group" is not a multicast address
+             * \retval RTP_GENERIC_ERROR If leaving the group failed
+             * \retval RTP_NOT_INITIALIZED If the media stream has not been initialized
+             */
+            rtp_error_t leave_multicast(std::string group);
+
+            /**
+             * \brief Read the performance counters of the media stream
+             *
+             * \details The counters are updated without locks by the threads that send and
+             * receive the packets, so calling this function does not slow the stream down.
+             * See ::uvgrtp::stream_stats for the meaning of each counter
+             *
+             * \param stats Snapshot of the counters is written here
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_INITIALIZED If the media stream has not been initialized
+             */
+            rtp_error_t get_stats(uvgrtp::stream_stats& stats);
+
             /// \cond DO_NOT_DOCUMENT
             /* Setter and getter for media-specific config that can be used f.ex with Opus */
             void  set_media_config(void *config);
@@ -268,6 +372,9 @@ namespace uvgrtp {
             /* Get unique key of the media stream
              * Used by session to index media streams */
             uint32_t get_key();
+
+            /* Set the shared reactor used by the stream if it is created with RCE_SHARED_REACTOR */
+            void set_reactor(uvgrtp::reactor *reactor);
             /// \endcond
 
             /**
@@ -296,6 +403,14 @@ namespace uvgrtp {
             /* free all allocated resources */
             rtp_error_t free_resources(rtp_error_t ret);
 
+            /* Start the holepuncher, RTCP and the packet dispatcher,
+             * either on their own threads or on the shared reactor */
+            rtp_error_t start_components();
+
+            /* Drop our own looped back packets only while we are a member of
+             * a multicast group and multicast loopback is enabled */
+            void update_own_ssrc_filter();
+
             uint32_t key_;
 
             uvgrtp::srtp   *srtp_;
@@ -304,7 +419,7 @@ namespace uvgrtp {
             uvgrtp::rtp    *rtp_;
             uvgrtp::rtcp   *rtcp_;
 
-            sockaddr_in addr_out_;
+            sockaddr_storage addr_out_;
             std::string addr_;
             std::string laddr_;
             int src_port_;
@@ -333,6 +448,22 @@ namespace uvgrtp {
 
             /* Thread that keeps the holepunched connection open for unidirectional streams */
             uvgrtp::holepuncher *holepuncher_;
+
+            /* Receiver of the FEC parity packets, used only with RCE_FEC */
+            uvgrtp::fec *fec_;
+
+            /* Playout scheduling of the received frames, used only with RCE_JITTER_BUFFER */
+            uvgrtp::jitter_buffer *jitter_buffer_;
+
+            /* Multicast group membership and options of the RTP socket */
+            uvgrtp::multicast *multicast_;
+
+            /* Number of multicast groups joined and whether multicast loopback is enabled (default) */
+            size_t mcast_groups_;
+            bool mcast_loopback_;
+
+            /* Shared reactor of the context, used only with RCE_SHARED_REACTOR */
+            uvgrtp::reactor *reactor_;
     };
 };
 
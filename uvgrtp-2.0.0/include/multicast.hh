@@ -1,33 +1,73 @@
 #pragma once
 
+#include <string>
+
+#include "socket.hh"
 #include "util.hh"
-#include "frame.hh"
 
 namespace uvgrtp {
-    class connection;
 
     const int MULTICAST_MAX_PEERS = 64;
 
+    /* IP multicast group membership and send options of one socket
+     *
+     * A media stream whose remote address is a multicast group joins the group and
+     * sends every packet once to the group address, so the packetization and encryption
+     * of a frame are done once no matter how many receivers have joined the group.
+     *
+     * IPv4 groups are configured with the IPPROTO_IP options and IPv6 groups with
+     * the IPPROTO_IPV6 options. "family" given to the constructor is the address family
+     * of the socket and it selects the options used for TTL, loopback and the interface */
     class multicast {
         public:
-           multicast();
-           ~multicast();
+            multicast(uvgrtp::socket *socket, short family);
+            ~multicast();
+
+            /* Return true if "addr" is an IPv4 (224.0.0.0/4) or IPv6 (ff00::/8) multicast address */
+            static bool is_multicast(std::string addr);
+            static bool is_multicast(const sockaddr_storage& addr);
+
+            /* Join multicast group "group" on the interface that has the local address "iface"
+             * or on the interface selected by the routing table if "iface" is empty.
+             * For IPv6, the interface is taken from the scope of "iface" ("fe80::1%eth0")
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "group" is not a multicast address
+             * Return RTP_GENERIC_ERROR if joining the group failed */
+            rtp_error_t join(std::string group, std::string iface);
+
+            /* Leave a multicast group joined with join()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "group" is not a multicast address
+             * Return RTP_GENERIC_ERROR if leaving the group failed */
+            rtp_error_t leave(std::string group, std::string iface);
+
+            /* Set the TTL (hop limit) of the packets sent to a multicast group
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "ttl" is not between 0 and 255
+             * Return RTP_GENERIC_ERROR if setting the option failed */
+            rtp_error_t set_ttl(int ttl);
 
-           /* Add RTP connection to multicast group */
-           rtp_error_t join_multicast(uvgrtp::connection *conn);
+            /* Enable or disable the delivery of our own multicast packets to the sockets of this host
+             *
+             * Return RTP_OK on success
+             * Return RTP_GENERIC_ERROR if setting the option failed */
+            rtp_error_t set_loopback(bool enable);
 
-           /* TODO:  */
-           rtp_error_t leave_multicast(uvgrtp::connection *conn);
+            /* Send the multicast packets through the interface that has the local address "iface"
+             *
+             * Return RTP_OK on success
+             * Return RTP_GENERIC_ERROR if setting the option failed */
+            rtp_error_t set_interface(std::string iface);
 
-           /* TODO:  */
-           rtp_error_t push_frame_multicast(uvgrtp::connection *sender, uvgrtp::frame::rtp_frame *frame);
+        private:
+            /* Add ("join" is true) or drop the membership of "group" */
+            rtp_error_t membership(std::string group, std::string iface, bool join);
 
-           /* TODO:  */
-           rtp_error_t push_frame_multicast(
-                uvgrtp::connection *sender,
-                uint8_t *data, uint32_t data_len,
-                rtp_format_t fmt, uint32_t timestamp
-           );
+            uvgrtp::socket *socket_;
+            short family_;
     };
 };
 
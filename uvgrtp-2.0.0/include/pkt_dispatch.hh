@@ -1,15 +1,31 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <unordered_map>
 
+#include "clock.hh"
 #include "frame.hh"
+#include "reactor.hh"
 #include "runner.hh"
 #include "socket.hh"
+#include "stats.hh"
 #include "util.hh"
 
 namespace uvgrtp {
 
+    class jitter_buffer;
+
+    /* How many datagrams are read from the socket with one system call
+     * and how large is each receive slot of the dispatcher */
+    const int RECV_BATCH_SIZE = 64;
+    const int RECV_SLOT_SIZE  = 8192;
+
+    /* How many completed frames can wait in the frame queue for pull_frame().
+     * If the application does not keep up, the oldest frame is dropped */
+    const int MAX_QUEUED_FRAMES = 512;
+
     typedef rtp_error_t (*packet_handler)(ssize_t, void *, int, uvgrtp::frame::rtp_frame **);
     typedef rtp_error_t (*packet_handler_aux)(void *, int, uvgrtp::frame::rtp_frame **);
     typedef rtp_error_t (*frame_getter)(void *, uvgrtp::frame::rtp_frame **);
@@ -64,12 +80,32 @@ namespace uvgrtp {
              * Return RTP_INVALID_VALUE if "hook" is nullptr */
             rtp_error_t install_receive_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame *));
 
+            /* Install a jitter buffer between the packet handlers and the application (RCE_JITTER_BUFFER)
+             *
+             * Completed frames are given to the jitter buffer and they are returned to the user
+             * through the frame queue or the receive hook at their playout time
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "jb" is nullptr
+             * Return RTP_MEMORY_ERROR if the release thread could not be created */
+            rtp_error_t install_jitter_buffer(uvgrtp::jitter_buffer *jb);
+
+            /* Update the receive and frame counters of "stats", must be called before start() */
+            void set_stats(uvgrtp::stats *stats);
+
             /* Start the RTP packet dispatcher
              *
              * Return RTP_OK on success
              * Return RTP_MEMORY_ERROR if allocation of a thread object fails */
             rtp_error_t start(uvgrtp::socket *socket, int flags);
 
+            /* Start the RTP packet dispatcher on a shared reactor instead of its own thread.
+             * The socket is read by a reactor thread whenever it becomes readable
+             *
+             * Return RTP_OK on success
+             * Return RTP_GENERIC_ERROR if the socket could not be added to the reactor */
+            rtp_error_t start(uvgrtp::socket *socket, int flags, uvgrtp::reactor *reactor);
+
             /* Stop the RTP packet dispatcher and wait until the receive loop is exited
              * to make sure that destroying the object in media_stream.cc is safe
              *
@@ -82,32 +118,95 @@ namespace uvgrtp {
              * that value tells it to.
              * If no frame is received within that time period, pull_frame() returns nullptr
              *
+             * The caller is woken up as soon as the dispatcher queues a frame or is stopped
+             *
              * Return pointer to RTP frame on success
              * Return nullptr if operation timed out or an error occurred */
             uvgrtp::frame::rtp_frame *pull_frame();
             uvgrtp::frame::rtp_frame *pull_frame(size_t ms);
 
         private:
+            struct queued_frame {
+                uvgrtp::frame::rtp_frame *frame;
+                uvgrtp::clock::hrc::hrc_t queued; /* when the frame was pushed to "frames_" */
+            };
+
+            /* Pop the oldest frame from "frames_", "frames_mtx_" must be held */
+            uvgrtp::frame::rtp_frame *pop_frame();
+
             /* RTP packet dispatcher thread */
             void runner(uvgrtp::socket *socket, int flags);
 
-            /* Return a processed RTP frame to user either through frame queue or receive hook */
+            /* Read and dispatch all datagrams that are waiting in the socket */
+            void receive(uvgrtp::socket *socket, int flags);
+
+            /* Called by the reactor when the socket becomes readable */
+            static void reactor_handler(void *arg);
+
+            /* Return a processed RTP frame to user, through the jitter buffer if one is installed */
             void return_frame(uvgrtp::frame::rtp_frame *frame);
 
+            /* Give a frame to the user either through frame queue or receive hook */
+            void deliver_frame(uvgrtp::frame::rtp_frame *frame);
+
+            /* Called by the jitter buffer when a frame reaches its playout time */
+            static void jitter_release(void *arg, uvgrtp::frame::rtp_frame *frame);
+
             /* Call auxiliary handlers of a primary handler */
             void call_aux_handlers(uint32_t key, int flags, uvgrtp::frame::rtp_frame **frame);
 
+            /* Pass one received UDP datagram to all primary handlers
+             * and to the auxiliary handlers of the primary handler that accepted it
+             *
+             * "arrival" is the receive time of the datagram as NTP timestamp */
+            void dispatch_packet(int nread, uint8_t *buffer, int flags, uint64_t arrival);
+
+            /* Give receive slot "slot" a new buffer from the pool if its current buffer
+             * is still used by a frame after the datagram has been dispatched */
+            void refill_slot(int slot);
+
             /* Primary handlers for the socket */
             std::unordered_map<uint32_t, packet_handlers> packet_handlers_;
 
             /* If receive hook has not been installed, frames are pushed to "frames_"
-             * and they can be retrieved using pull_frame() */
-            std::vector<uvgrtp::frame::rtp_frame *> frames_;
+             * and they can be retrieved using pull_frame()
+             *
+             * "frames_cv_" is signaled every time a frame is pushed and when the dispatcher is stopped */
+            std::deque<queued_frame> frames_;
             std::mutex frames_mtx_;
+            std::condition_variable frames_cv_;
             std::mutex exit_mtx_;
 
+            /* Pool of receive buffers. RTP frames created by the primary handler
+             * point to the buffer their datagram was received to */
+            uvgrtp::frame::dgram_pool *pool_;
+
+            /* Receive ring of RECV_BATCH_SIZE slots that is filled by recvmmsg(2).
+             * After the datagrams of a batch have been given to the handlers, a slot whose
+             * buffer is still referenced by a frame is refilled from the pool and the other
+             * slots are reused as is */
+            uvgrtp::frame::dgram_buffer *recv_bufs_[RECV_BATCH_SIZE];
+#ifdef __linux__
+            struct mmsghdr recv_hdrs_[RECV_BATCH_SIZE];
+            struct iovec   recv_iovs_[RECV_BATCH_SIZE];
+            char           recv_ctrl_[RECV_BATCH_SIZE][RECV_CTRL_SIZE];
+#endif
+
+            /* Arrival time of the datagram that is being dispatched,
+             * given to the frames that it completes */
+            uint64_t arrival_;
+
+            /* Shared reactor and the key of our socket in it, if the dispatcher was started on one */
+            uvgrtp::reactor *reactor_;
+            uint32_t reactor_key_;
+            uvgrtp::socket *socket_;
+            int flags_;
+
             void *recv_hook_arg_;
             void (*recv_hook_)(void *arg, uvgrtp::frame::rtp_frame *frame);
+
+            uvgrtp::jitter_buffer *jitter_;
+            uvgrtp::stats *stats_;
     };
 }
 
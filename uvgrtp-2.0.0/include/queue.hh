@@ -5,7 +5,9 @@
 #include <unordered_map>
 #include <vector>
 
+#include "clock.hh"
 #include "dispatch.hh"
+#include "fec.hh"
 #include "frame.hh"
 #include "rtp.hh"
 #include "socket.hh"
@@ -19,6 +21,10 @@ typedef SSIZE_T ssize_t;
 const int MAX_MSG_COUNT   = 5000;
 const int MAX_QUEUED_MSGS =  10;
 const int MAX_CHUNK_COUNT =   4;
+const int COPY_BLOCK_SIZE = 256 * 1024;
+
+/* How many of the most recently sent packets are kept for retransmission (RCE_RTCP_NACK) */
+const int RTX_HISTORY_SIZE = 1024;
 
 namespace uvgrtp {
 
@@ -70,13 +76,22 @@ namespace uvgrtp {
         /* Pointer to RTP authentication (if enabled) */
         uint8_t *rtp_auth_tags;
 
+        /* When SRTP encryption is used without RCE_SRTP_INPLACE_ENCRYPTION, the payloads
+         * are copied to these blocks and encrypted there. The blocks are allocated on demand
+         * and kept when the transaction is reused so that steady-state sending doesn't allocate.
+         *
+         * "copy_block" is the index of the block being filled and "copy_off" its first free byte */
+        std::vector<std::pair<size_t, uint8_t *>> copy_blocks;
+        size_t copy_block;
+        size_t copy_off;
+
         size_t chunk_ptr;
         size_t hdr_ptr;
         size_t rtphdr_ptr;
         size_t rtpauth_ptr;
 
         /* Address of receiver, used by sendmmsg(2) */
-        sockaddr_in out_addr;
+        sockaddr_storage out_addr;
 
         /* Used by the system call dispatcher for transaction deinitialization */
         uvgrtp::frame_queue *fqueue;
@@ -101,6 +116,13 @@ namespace uvgrtp {
 
     } transaction_t;
 
+    /* Copy of a sent packet (as it was sent to the network) kept for retransmission */
+    typedef struct rtx_packet {
+        bool valid;
+        uint16_t seq;
+        std::vector<uint8_t> data;
+    } rtx_packet_t;
+
     class frame_queue {
         public:
             frame_queue(uvgrtp::socket *socket, uvgrtp::rtp *rtp, int flags);
@@ -191,7 +213,43 @@ namespace uvgrtp {
              * significant memory leaks */
             void install_dealloc_hook(void (*dealloc_hook)(void *));
 
+            /* Resend the packets "seqs" if they are still in the retransmission history
+             *
+             * This is called by the RTCP thread when a generic NACK is received and it only uses
+             * the history and sendto(2) so it doesn't interfere with the thread that sends frames
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending a packet failed */
+            rtp_error_t retransmit(std::vector<uint16_t>& seqs);
+
+            /* RTCP NACK hook, "arg" is the frame queue */
+            static void nack_hook(void *arg, std::vector<uint16_t>& seqs);
+
         private:
+            /* Copy the packets of the active transaction to the retransmission history */
+            void save_history();
+
+            /* Reserve "len" bytes from the copy blocks of the active transaction
+             * and copy "data" there
+             *
+             * Return pointer to the copy on success
+             * Return nullptr if memory allocation failed */
+            uint8_t *copy_payload(uint8_t *data, size_t len);
+
+            /* Send "packets" in bursts of at most "pace_burst" bytes so that
+             * the average rate does not exceed the RCC_PACE_BITRATE of the stream
+             *
+             * Each burst is sent with one sendto() call (i.e., one sendmmsg(2) on Linux)
+             * and the calling thread sleeps between bursts when the token bucket runs empty
+             *
+             * If "launch_time" is not 0 (RCE_TXTIME), nothing is waited for. The bursts are given
+             * launch times that are apart by the time it takes to send a burst at the pacing rate
+             * and "launch_time" is set to the launch time of the last burst
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending a burst failed */
+            rtp_error_t send_paced(uvgrtp::pkt_vec& packets, size_t pace_rate, size_t pace_burst, uint64_t& launch_time);
+
             /* Both the application and SCD access "free_" and "queued_" structures so the
              * access must be protected by a mutex
              *
@@ -218,6 +276,33 @@ namespace uvgrtp {
 
             /* RTP context flags */
             int flags_;
+
+            /* Length of the SRTP authentication tag appended to each packet, 0 if none */
+            size_t auth_tag_len_;
+
+            /* Token bucket of the sender-side pacing, see RCC_PACE_BITRATE
+             *
+             * "pace_tokens_" tells how many bytes can be sent right now and it is
+             * refilled at the pacing rate, up to one burst, based on "pace_last_" */
+            double pace_tokens_;
+            uvgrtp::clock::hrc::hrc_t pace_last_;
+
+            /* Packets of the burst that is being sent, kept to avoid reallocations */
+            uvgrtp::pkt_vec burst_;
+
+            /* Retransmission history indexed by sequence number modulo RTX_HISTORY_SIZE
+             *
+             * The history is written by the sending thread and read by the RTCP thread */
+            std::mutex history_mtx_;
+            std::vector<rtx_packet_t> history_;
+
+            /* Parity packet encoder, nullptr if RCE_FEC is not enabled */
+            uvgrtp::fec *fec_;
+
+            /* RFC 4588 retransmission stream (RCC_RTX_PAYLOAD_TYPE) */
+            std::vector<uint8_t> rtx_buf_;
+            uint32_t rtx_ssrc_;
+            uint16_t rtx_seq_;
     };
 };
 
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "util.hh"
+
+namespace uvgrtp {
+
+    /* How many threads service the sockets and timers of all
+     * media streams that have been created with RCE_SHARED_REACTOR */
+    const int REACTOR_THREADS = 2;
+
+    /* How many ready events one reactor thread picks up with one epoll_wait(2) call */
+    const int REACTOR_MAX_EVENTS = 8;
+
+    typedef void (*reactor_handler)(void *arg);
+
+    /* Shared event loop for the media streams of a context
+     *
+     * Instead of each media stream running its own packet dispatcher, RTCP and holepuncher threads,
+     * the streams register their sockets and periodic timers to the reactor which services
+     * all of them from a small fixed pool of threads using epoll(7) and timerfd(2).
+     *
+     * A source (socket or timer) is armed with EPOLLONESHOT and rearmed only after its handler
+     * has returned so the handler of a source is never executed by two threads at the same time.
+     *
+     * The reactor is only available on Linux. On other platforms add_socket() and add_timer() fail
+     * and the media streams fall back to using their own threads */
+    class reactor {
+        public:
+            reactor();
+            ~reactor();
+
+            /* Call "handler" with "arg" whenever "fd" becomes readable.
+             * The handler should read from the socket until the read would block.
+             *
+             * Return a non-zero key that identifies the source on success
+             * Return 0 if the socket could not be added */
+            uint32_t add_socket(int fd, reactor_handler handler, void *arg);
+
+            /* Call "handler" with "arg" every "interval" milliseconds
+             *
+             * Return a non-zero key that identifies the source on success
+             * Return 0 if the timer could not be created */
+            uint32_t add_timer(uint32_t interval, reactor_handler handler, void *arg);
+
+            /* Remove a source from the reactor. When remove() returns, the handler
+             * of the source is not running and it will not be called again.
+             *
+             * remove() must not be called from the handler of the source it removes
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_FOUND if "key" does not identify a source */
+            rtp_error_t remove(uint32_t key);
+
+        private:
+            struct source {
+                int fd;
+                bool timer;
+                bool busy;
+                bool removed;
+                reactor_handler handler;
+                void *arg;
+            };
+
+            /* Start the reactor threads when the first source is added */
+            rtp_error_t start();
+
+            /* Register "src" to epoll and return its key or 0 on error */
+            uint32_t add_source(source *src);
+
+            /* Reactor thread */
+            void worker();
+
+            int epoll_fd_;
+
+            /* eventfd(2) that is signaled to make the reactor threads exit */
+            int exit_fd_;
+
+            uint32_t next_key_;
+
+            std::vector<std::thread> threads_;
+            std::unordered_map<uint32_t, source *> sources_;
+
+            /* "idle_cv_" is signaled when a handler returns so that remove() can wait for it */
+            std::mutex sources_mtx_;
+            std::condition_variable idle_cv_;
+    };
+};
+
+namespace uvg_rtp = uvgrtp;
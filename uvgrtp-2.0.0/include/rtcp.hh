@@ -1,12 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <bitset>
 #include <map>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "clock.hh"
 #include "frame.hh"
+#include "multicast.hh"
+#include "reactor.hh"
 #include "runner.hh"
 #include "socket.hh"
 #include "srtp/srtcp.hh"
@@ -27,6 +32,25 @@ namespace uvgrtp {
     const int MAX_MISORDER   = 100;
     const int MIN_TIMEOUT    = 5000;
 
+    /* Generic NACK (RCE_RTCP_NACK)
+     *
+     * A sequence number jump larger than NACK_MAX_GAP is treated as a restart of the stream
+     * instead of a burst of lost packets, at most NACK_MAX_PENDING lost packets are tracked at a time
+     * and every lost packet is requested at most NACK_MAX_RETRIES times, NACK_RETRY_INTERVAL
+     * milliseconds apart. Packets older than RCC_PKT_MAX_DELAY are no longer requested */
+    const int NACK_FMT            = 1;
+    const int NACK_MAX_GAP        = 512;
+    const int NACK_MAX_PENDING    = 1024;
+    const int NACK_MAX_RETRIES    = 3;
+    const int NACK_RETRY_INTERVAL = 20;
+
+    /* State of a lost RTP packet that has been requested with generic NACK */
+    struct rtcp_nack_info {
+        uvgrtp::clock::hrc::hrc_t detected;  /* when the loss was detected */
+        uvgrtp::clock::hrc::hrc_t requested; /* when the packet was last requested */
+        int retries;                          /* how many times the packet has been requested */
+    };
+
     struct rtcp_statistics {
         /* receiver stats */
         uint32_t received_pkts;  /* Number of packets received */
@@ -37,8 +61,8 @@ namespace uvgrtp {
         uint32_t sent_pkts;   /* Number of sent RTP packets */
         uint32_t sent_bytes;  /* Number of sent bytes excluding RTP Header */
 
-        uint32_t jitter;      /* TODO: */
-        uint32_t transit;     /* TODO: */
+        uint32_t jitter;      /* Interarrival jitter in RTP timestamp units (RFC 3550 A.8) */
+        uint32_t transit;     /* Relative transit time of the previous packet */
 
         /* Receiver clock related stuff */
         uint64_t initial_ntp; /* Wallclock reading when the first RTP packet was received */
@@ -56,7 +80,7 @@ namespace uvgrtp {
 
     struct rtcp_participant {
         uvgrtp::socket *socket; /* socket associated with this participant */
-        sockaddr_in address;     /* address of the participant */
+        sockaddr_storage address; /* address of the participant */
         struct rtcp_statistics stats; /* RTCP session statistics of the participant */
 
         int probation;           /* has the participant been fully accepted to the session */
@@ -83,6 +107,12 @@ namespace uvgrtp {
              * return RTP_OK on success and RTP_MEMORY_ERROR if the allocation fails */
             rtp_error_t start();
 
+            /* Start RTCP on a shared reactor instead of a runner thread. The participant sockets
+             * are read by the reactor and the reports are generated by a reactor timer
+             *
+             * return RTP_OK on success and RTP_GENERIC_ERROR if the reactor cannot be used */
+            rtp_error_t start(uvgrtp::reactor *reactor);
+
             /* End the RTCP session and send RTCP BYE to all participants
              *
              * return RTP_OK on success */
@@ -105,6 +135,7 @@ namespace uvgrtp {
             rtp_error_t handle_sdes_packet(uint8_t *frame, size_t size);
             rtp_error_t handle_bye_packet(uint8_t *frame, size_t size);
             rtp_error_t handle_app_packet(uint8_t *frame, size_t size);
+            rtp_error_t handle_nack_packet(uint8_t *frame, size_t size);
 
             /* Handle incoming RTCP packet (first make sure it's a valid RTCP packet)
              * This function will call one of the above functions internally
@@ -124,6 +155,21 @@ namespace uvgrtp {
             rtp_error_t send_app_packet(char *name, uint8_t subtype, size_t payload_len, uint8_t *payload);
             rtp_error_t send_bye_packet(std::vector<uint32_t> ssrcs);
 
+            /// \cond DO_NOT_DOCUMENT
+            /* Request retransmission of the RTP packets "seqs" of "media_ssrc" using
+             * an RTCP generic NACK (RFC 4585). "seqs" is sorted by the call
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "seqs" is empty
+             * Return RTP_NOT_FOUND if "media_ssrc" is not a participant
+             * Return RTP_SEND_ERROR if sending the packet did not succeed */
+            rtp_error_t send_nack_packet(uint32_t media_ssrc, std::vector<uint16_t>& seqs);
+
+            /* Install a hook that is called with the requested sequence numbers
+             * when a generic NACK for our media is received. "arg" is passed to the hook */
+            rtp_error_t install_nack_hook(void *arg, void (*hook)(void *, std::vector<uint16_t>&));
+            /// \endcond
+
             /// \cond DO_NOT_DOCUMENT
             /* Return the latest RTCP packet received from participant of "ssrc"
              * Return nullptr if we haven't received this kind of packet or if "ssrc" doesn't exist
@@ -177,6 +223,19 @@ namespace uvgrtp {
             /* Update various session statistics */
             void update_session_statistics(uvgrtp::frame::rtp_frame *frame);
 
+            /* Return the interarrival jitter of the RTP packets of "ssrc" in microseconds
+             * or 0 if no packets have been received from "ssrc" */
+            uint64_t get_jitter_us(uint32_t ssrc);
+
+            /* Set the TTL and loopback of the RTCP packets sent to a multicast group,
+             * see RCC_MULTICAST_TTL and RCC_MULTICAST_LOOPBACK
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "ttl" is not between 0 and 255
+             * Return RTP_GENERIC_ERROR if setting the option failed */
+            rtp_error_t set_multicast_ttl(int ttl);
+            rtp_error_t set_multicast_loopback(bool enable);
+
             /* Return SSRCs of all participants */
             std::vector<uint32_t> get_participants();
             /// \endcond
@@ -219,6 +278,10 @@ namespace uvgrtp {
         private:
             static void rtcp_runner(rtcp *rtcp);
 
+            /* Reactor handlers for incoming RTCP packets and for the report timer */
+            static void reactor_recv_handler(void *arg);
+            static void reactor_timer_handler(void *arg);
+
             /* when we start the RTCP instance, we don't know what the SSRC of the remote is
              * when an RTP packet is received, we must check if we've already received a packet
              * from this sender and if not, create new entry to receiver_stats_ map */
@@ -230,7 +293,10 @@ namespace uvgrtp {
              * If the address is new, it means we have detected an SSRC collision and the paket should
              * be dropped We also need to check whether this SSRC matches with our own SSRC and if it does
              * we need to send RTCP BYE and rejoin to the session */
-            bool collision_detected(uint32_t ssrc, sockaddr_in& src_addr);
+            bool collision_detected(uint32_t ssrc, sockaddr_storage& src_addr);
+
+            /* Return the participants that are reached through a multicast group */
+            std::vector<uvgrtp::rtcp_participant *> multicast_participants();
 
             /* Move participant from initial_peers_ to participants_ */
             rtp_error_t add_participant(uint32_t ssrc);
@@ -250,10 +316,22 @@ namespace uvgrtp {
              * packet-related statistics should not be updated */
             rtp_error_t update_participant_seq(uint32_t ssrc, uint16_t seq);
 
+            /* Track the sequence numbers of the received RTP packets and send generic NACK
+             * for the missing packets that are still worth retransmitting (RCE_RTCP_NACK) */
+            void update_nack_state(uvgrtp::frame::rtp_frame *frame);
+
+            /* Turn an RFC 4588 retransmission packet back into the original packet
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the packet is too short or the media SSRC is not known yet */
+            rtp_error_t restore_rtx_packet(uvgrtp::frame::rtp_frame *frame);
+
             /* Update the RTCP bandwidth variables
              *
              * "pkt_size" tells how much rtcp_byte_count_
-             * should be increased before calculating the new average */
+             * should be increased before calculating the new average
+             *
+             * The caller must hold send_mtx_ */
             void update_rtcp_bandwidth(size_t pkt_size);
 
             /* Functions for generating different kinds of reports.
@@ -309,8 +387,14 @@ namespace uvgrtp {
             size_t rtcp_pkt_count_;
             size_t rtcp_byte_count_;
 
-            /* Number of RTCP packets sent */
-            size_t rtcp_pkt_sent_count_;
+            /* Number of SRTCP packets sent
+             *
+             * This is incremented for every protected packet and used as its SRTCP index
+             * so that no two packets share the key stream or the receiver's replay window slot */
+            std::atomic<size_t> rtcp_pkt_sent_count_;
+
+            /* Size of the IP header of our RTCP packets, depends on the address family of the participants */
+            size_t ip_hdr_size_;
 
             /* Flag that is true if the application has not yet sent an RTCP packet. */
             bool initial_;
@@ -318,6 +402,11 @@ namespace uvgrtp {
             /* Copy of our own current SSRC */
             uint32_t ssrc_;
 
+            /* Our own reports come back to us only if we joined a multicast group
+             * for the reports and multicast loopback is enabled (default) */
+            bool mcast_member_;
+            std::atomic<bool> mcast_loopback_;
+
             /* NTP timestamp associated with initial RTP timestamp (aka t = 0) */
             uint64_t clock_start_;
 
@@ -343,10 +432,34 @@ namespace uvgrtp {
              * to pass to poll when RTCP runner is listening to incoming packets */
             std::vector<uvgrtp::socket> sockets_;
 
+            /* Shared reactor and the keys of our sources in it, if RTCP was started on one
+             *
+             * The reactor may call the receive and timer handlers from different threads
+             * so "reactor_mtx_" serializes them like the runner thread does */
+            uvgrtp::reactor *reactor_;
+            std::vector<uint32_t> reactor_keys_;
+            std::mutex reactor_mtx_;
+
+            /* NACKs are sent from the dispatcher thread, reports from the RTCP runner or reactor
+             * and SDES, APP and BYE packets from the application thread.
+             * "send_mtx_" serializes the sending, the bandwidth counters and changes to participants_ */
+            std::mutex send_mtx_;
+
             void (*sender_hook_)(uvgrtp::frame::rtcp_sender_report *);
             void (*receiver_hook_)(uvgrtp::frame::rtcp_receiver_report *);
             void (*sdes_hook_)(uvgrtp::frame::rtcp_sdes_packet *);
             void (*app_hook_)(uvgrtp::frame::rtcp_app_packet *);
+
+            void *nack_arg_;
+            void (*nack_hook_)(void *, std::vector<uint16_t>&);
+
+            /* Generic NACK receiver state: SSRC, payload type and the highest sequence number
+             * of the remote media and the lost packets that are being requested */
+            bool nack_init_;
+            uint32_t nack_ssrc_;
+            uint8_t nack_payload_;
+            uint16_t nack_max_seq_;
+            std::unordered_map<uint16_t, rtcp_nack_info> nack_missing_;
     };
 };
 
@@ -1,8 +1,11 @@
 #ifndef __RTP_HH_
 #define __RTP_HH_
 
+#include <atomic>
+
 #include "clock.hh"
 #include "frame.hh"
+#include "stats.hh"
 #include "util.hh"
 
 namespace uvgrtp {
@@ -17,8 +20,19 @@ namespace uvgrtp {
             uint32_t     get_clock_rate();
             size_t       get_payload_size();
             size_t       get_pkt_max_delay();
+            size_t       get_pace_rate();
+            size_t       get_pace_burst();
+            uint8_t      get_rtx_payload();
+            uint8_t      get_fec_payload();
+            size_t       get_fec_group_size();
+            size_t       get_playout_delay_min();
+            size_t       get_playout_delay_max();
+            uint64_t     get_launch_time();
             rtp_format_t get_payload();
 
+            /* Performance counters of the media stream that owns this RTP context */
+            uvgrtp::stats *get_stats();
+
             void inc_sent_pkts();
             void inc_sequence();
 
@@ -26,8 +40,16 @@ namespace uvgrtp {
             void set_payload(rtp_format_t fmt);
             void set_dynamic_payload(uint8_t payload);
             void set_timestamp(uint64_t timestamp);
+            void set_launch_time(uint64_t launch_time);
             void set_payload_size(size_t payload_size);
             void set_pkt_max_delay(size_t delay);
+            void set_pace_rate(size_t rate);
+            void set_pace_burst(size_t burst);
+            void set_rtx_payload(uint8_t payload);
+            void set_fec_payload(uint8_t payload);
+            void set_fec_group_size(size_t size);
+            void set_playout_delay_min(size_t delay);
+            void set_playout_delay_max(size_t delay);
 
             void fill_header(uint8_t *buffer);
             void update_sequence(uint8_t *buffer);
@@ -35,6 +57,14 @@ namespace uvgrtp {
             /* Validates the RTP header pointed to by "packet" */
             static rtp_error_t packet_handler(ssize_t size, void *packet, int flags, frame::rtp_frame **out);
 
+            /* Drop the packets that carry our own SSRC, i.e., the packets we sent to a multicast
+             * group that loop back to us. Enabled only with set_own_ssrc_filter() */
+            static rtp_error_t recv_packet_handler(void *arg, int flags, frame::rtp_frame **out);
+
+            /* Enable the filter of recv_packet_handler() when the stream is a member of
+             * a multicast group and receives its own packets (multicast loopback) */
+            void set_own_ssrc_filter(bool enable);
+
         private:
 
             uint32_t ssrc_;
@@ -52,6 +82,9 @@ namespace uvgrtp {
             /* Use custom timestamp for the outgoing RTP packets */
             uint64_t timestamp_;
 
+            /* Launch time (RCE_TXTIME) of the frame that is being sent, 0 if it is sent immediately */
+            uint64_t launch_time_;
+
             /* What is the maximum size of the payload available for this RTP instance
              *
              * By default, the value is set to 1443
@@ -64,6 +97,29 @@ namespace uvgrtp {
              *
              * Default value is 100ms */
             size_t delay_;
+
+            /* Rate (in bits per second) and burst size (in bytes) of the sender-side pacing
+             *
+             * Pacing is disabled by default (rate is 0) */
+            size_t pace_rate_;
+            size_t pace_burst_;
+
+            /* Payload type of RFC 4588 retransmissions, 0 if retransmissions are not sent as RTX */
+            uint8_t rtx_payload_;
+
+            /* Payload type of the FEC parity packets and how many media packets one parity packet protects */
+            uint8_t fec_payload_;
+            size_t fec_group_size_;
+
+            /* Limits (in milliseconds) of the playout delay of the jitter buffer */
+            size_t playout_min_;
+            size_t playout_max_;
+
+            /* Drop the received packets that carry our own SSRC. Outside of a multicast group
+             * such a packet comes from another source and is an SSRC collision */
+            std::atomic<bool> own_ssrc_filter_;
+
+            uvgrtp::stats stats_;
     };
 };
 
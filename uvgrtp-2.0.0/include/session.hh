@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "media_stream.hh"
+#include "reactor.hh"
 #include "zrtp.hh"
 
 namespace uvgrtp {
@@ -12,8 +13,8 @@ namespace uvgrtp {
     class session {
         public:
             /// \cond DO_NOT_DOCUMENT
-            session(std::string addr);
-            session(std::string remote_addr, std::string local_addr);
+            session(std::string addr, uvgrtp::reactor *reactor);
+            session(std::string remote_addr, std::string local_addr, uvgrtp::reactor *reactor);
             ~session();
             /// \endcond
 
@@ -24,6 +25,7 @@ namespace uvgrtp {
              *
              * If local_addr was provided when uvgrtp::session was created, uvgRTP binds
              * itself to local_addr:src_port, otherwise to INADDR_ANY:src_port
+             * (or in6addr_any:src_port if the remote address is IPv6)
              *
              * This object is used for both sending and receiving media, see documentation
              * for uvgrtp::media_stream for more details.
@@ -82,6 +84,9 @@ namespace uvgrtp {
             std::unordered_map<uint32_t, uvgrtp::media_stream *> streams_;
 
             std::mutex session_mtx_;
+
+            /* Shared reactor of the context, given to streams created with RCE_SHARED_REACTOR */
+            uvgrtp::reactor *reactor_;
     };
 };
 
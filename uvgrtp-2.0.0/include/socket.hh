@@ -2,10 +2,12 @@
 
 #ifdef _WIN32
 #include <winsock2.h>
+#include <ws2tcpip.h>
 #include <mswsock.h>
 #include <inaddr.h>
 #else
 #include <netinet/ip.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
 #include <sys/uio.h>
 #endif
@@ -13,6 +15,7 @@
 #include <vector>
 #include <string>
 
+#include "stats.hh"
 #include "util.hh"
 
 namespace uvgrtp {
@@ -23,6 +26,14 @@ namespace uvgrtp {
 
     const int MAX_BUFFER_COUNT = 256;
 
+    /* Size of the control buffer that holds the receive timestamps of one datagram */
+    const int RECV_CTRL_SIZE = 128;
+
+    /* Limits for one UDP Generic Segmentation Offload super-packet:
+     * the kernel accepts at most 64 segments and the whole packet must fit into one UDP datagram */
+    const int GSO_MAX_SEGMENTS = 64;
+    const int GSO_MAX_SIZE     = 65507;
+
     /* Vector of buffers that contain a full RTP frame */
     typedef std::vector<std::pair<size_t, uint8_t *>> buf_vec;
 
@@ -43,13 +54,17 @@ namespace uvgrtp {
 
             /* Create socket using "family", "type" and "protocol"
              *
-             * NOTE: Only family AF_INET (ie. IPv4) is supported
+             * "family" must be AF_INET or AF_INET6. An AF_INET6 socket is dual-stack:
+             * it can also be used with IPv4 addresses created by create_sockaddr()
              *
              * Return RTP_OK on success
              * return RTP_SOCKET_ERROR if creating the socket failed */
             rtp_error_t init(short family, int type, int protocol);
 
             /* Same as bind(2), assigns an address for the underlying socket object
+             *
+             * For AF_INET6, "host" must be INADDR_ANY or INADDR_LOOPBACK
+             * and it is bound to the IPv6 wildcard or loopback address
              *
              * Return RTP_OK on success
              * Return RTP_BIND_ERROR if the bind failed */
@@ -79,12 +94,22 @@ namespace uvgrtp {
             rtp_error_t sendto(pkt_vec& buffers, int flags, int *bytes_sent);
 
             /* Same as sendto() but the remote address given as parameter */
-            rtp_error_t sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags);
-            rtp_error_t sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent);
-            rtp_error_t sendto(sockaddr_in& addr, buf_vec& buffers, int flags);
-            rtp_error_t sendto(sockaddr_in& addr, buf_vec& buffers, int flags, int *bytes_sent);
-            rtp_error_t sendto(sockaddr_in& addr, pkt_vec& buffers, int flags);
-            rtp_error_t sendto(sockaddr_in& addr, pkt_vec& buffers, int flags, int *bytes_sent);
+            rtp_error_t sendto(sockaddr_storage& addr, uint8_t *buf, size_t buf_len, int flags);
+            rtp_error_t sendto(sockaddr_storage& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent);
+            rtp_error_t sendto(sockaddr_storage& addr, buf_vec& buffers, int flags);
+            rtp_error_t sendto(sockaddr_storage& addr, buf_vec& buffers, int flags, int *bytes_sent);
+            rtp_error_t sendto(sockaddr_storage& addr, pkt_vec& buffers, int flags);
+            rtp_error_t sendto(sockaddr_storage& addr, pkt_vec& buffers, int flags, int *bytes_sent);
+
+            /* Same as sendto() but the kernel holds the packets until "launch_time" (RCE_TXTIME)
+             *
+             * "launch_time" is in nanoseconds of the clock given to enable_txtime(). If the socket
+             * does not have SO_TXTIME enabled or "launch_time" is 0, the packets are sent immediately
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR on error */
+            rtp_error_t sendto_at(uint8_t *buf, size_t buf_len, int flags, uint64_t launch_time);
+            rtp_error_t sendto_at(pkt_vec& buffers, int flags, uint64_t launch_time);
 
             /* Same as recv(2), receives a message from socket (remote address not known)
              *
@@ -104,28 +129,86 @@ namespace uvgrtp {
              * Return RTP_OK on success and write the amount of bytes sent to "bytes_sent"
              * Return RTP_INTERRUPTED if the call was interrupted due to timeout and set "bytes_sent" to 0
              * Return RTP_GENERIC_ERROR on error and set "bytes_sent" to -1 */
-            rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_in *sender, int *bytes_read);
-            rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_in *sender);
+            rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_storage *sender, int *bytes_read);
+            rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_storage *sender);
             rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int flags, int *bytes_read);
             rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int flags);
 
-            /* Create sockaddr_in object using the provided information
-             * NOTE: "family" must be AF_INET */
-            sockaddr_in create_sockaddr(short family, unsigned host, short port);
+#ifdef __linux__
+            /* Same as recvmmsg(2), receives up to "vlen" messages from remote into "hdrs"
+             *
+             * The caller is responsible for initializing the I/O vectors of "hdrs"
+             * and the length of each received message is written to "msg_len" of its header
+             *
+             * Write the number of messages read to "msgs_read" if it's not NULL
+             *
+             * Return RTP_OK on success and write the number of messages read to "msgs_read"
+             * Return RTP_INTERRUPTED if there were no messages to read and set "msgs_read" to 0
+             * Return RTP_GENERIC_ERROR on error and set "msgs_read" to -1 */
+            rtp_error_t recvmmsg(struct mmsghdr *hdrs, unsigned vlen, int flags, int *msgs_read);
+
+            /* Ask the kernel to timestamp every received datagram with the wall clock
+             *
+             * SO_TIMESTAMPING is preferred and SO_TIMESTAMPNS is used if it is not supported
+             *
+             * The timestamps are returned as control messages so the headers given to
+             * recvmmsg() must have a control buffer of at least RECV_CTRL_SIZE bytes
+             *
+             * Return RTP_OK on success
+             * Return RTP_GENERIC_ERROR if neither option is supported */
+            rtp_error_t enable_rx_timestamps();
+
+            /* Return the kernel receive timestamp of a message read with recvmmsg() as NTP
+             * timestamp. Return 0 if the message has no timestamp */
+            static uint64_t get_rx_timestamp(struct msghdr *hdr);
 
-            /* Create sockaddr_in object using the provided information
-             * NOTE: "family" must be AF_INET */
-            sockaddr_in create_sockaddr(short family, std::string host, short port);
+            /* Enable SO_TXTIME so that the packets sent with sendto_at() leave at their launch time
+             *
+             * "clock" is the clock of the launch times, f.ex. CLOCK_MONOTONIC for the fq qdisc.
+             * The packets that the qdisc drops because of their launch time are reported
+             * in the error queue which is read after every send
+             *
+             * Return RTP_OK on success
+             * Return RTP_GENERIC_ERROR if the kernel does not support SO_TXTIME */
+            rtp_error_t enable_txtime(int clock);
+#endif
+
+            /* Create socket address object using the provided information
+             * NOTE: "family" must be AF_INET or AF_INET6, see bind() for the meaning of "host" */
+            static sockaddr_storage create_sockaddr(short family, unsigned host, short port);
+
+            /* Create socket address object using the provided information
+             *
+             * "family" must be AF_INET or AF_INET6. For AF_INET6, "host" can have a scope
+             * ("fe80::1%eth0") and an IPv4 address is converted to an IPv4-mapped IPv6 address
+             *
+             * If the scope is not valid, the family of the returned address is AF_UNSPEC */
+            static sockaddr_storage create_sockaddr(short family, std::string host, short port);
+
+            /* Convert the scope of an IPv6 address ("eth0" or "2" in "fe80::1%eth0") to an interface index
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the scope is empty, out of range or not a known interface */
+            static rtp_error_t get_scope_id(std::string scope, uint32_t *index);
+
+            /* Return AF_INET6 if "host" is an IPv6 address and AF_INET otherwise */
+            static short get_family(std::string host);
+
+            /* Return the size of the address structure of "addr" for bind(2) and sendto(2) */
+            static socklen_t get_sockaddr_len(const sockaddr_storage& addr);
+
+            /* Return true if "a" and "b" have the same address and port */
+            static bool sockaddr_equal(const sockaddr_storage& a, const sockaddr_storage& b);
 
             /* Get reference to the actual socket object */
             socket_t& get_raw_socket();
 
             /* Initialize the private "addr_" object with "addr"
              * This is used when calling send() */
-            void set_sockaddr(sockaddr_in addr);
+            void set_sockaddr(sockaddr_storage addr);
 
             /* Get the out address for the socket if it exists */
-            sockaddr_in& get_out_address();
+            sockaddr_storage& get_out_address();
 
             /* Install a packet handler for vector-based send operations.
              *
@@ -136,20 +219,37 @@ namespace uvgrtp {
              * "arg" is an optional parameter that can be passed to the handler when it's called */
             rtp_error_t install_handler(void *arg, packet_handler_vec handler);
 
+            /* Count every packet sent through this socket to "stats" */
+            void set_stats(uvgrtp::stats *stats);
+
         private:
             /* helper function for sending UPD packets, see documentation for sendto() above */
-            rtp_error_t __sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent);
+            rtp_error_t __sendto(sockaddr_storage& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent, uint64_t launch_time);
             rtp_error_t __recv(uint8_t *buf, size_t buf_len, int flags, int *bytes_read);
-            rtp_error_t __recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_in *sender, int *bytes_read);
+            rtp_error_t __recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_storage *sender, int *bytes_read);
 
             /* __sendtov() does the same as __sendto but it combines multiple buffers into one frame and sends them */
-            rtp_error_t __sendtov(sockaddr_in& addr, buf_vec& buffers, int flags, int *bytes_sent);
-            rtp_error_t __sendtov(sockaddr_in& addr, uvgrtp::pkt_vec& buffers, int flags, int *bytes_sent);
+            rtp_error_t __sendtov(sockaddr_storage& addr, buf_vec& buffers, int flags, int *bytes_sent);
+            rtp_error_t __sendtov(sockaddr_storage& addr, uvgrtp::pkt_vec& buffers, int flags, int *bytes_sent, uint64_t launch_time);
+
+#ifdef __linux__
+            /* Write an SCM_TXTIME control message for "launch_time" to "ctrl"
+             * and return the number of bytes it takes */
+            static size_t set_txtime_cmsg(char *ctrl, uint64_t launch_time);
+
+            /* Read the packets the qdisc has dropped because of their launch time from the
+             * error queue of the socket and count them. A non-empty error queue makes poll(2)
+             * report POLLERR so it must not be left to grow */
+            void drain_txtime_errors();
+#endif
 
             socket_t socket_;
-            sockaddr_in addr_;
+            sockaddr_storage addr_;
             int flags_;
 
+            /* Send counters of the media stream, nullptr if the packets are not counted */
+            uvgrtp::stats *stats_;
+
             /* __sendto() calls these handlers in order before sending the packet */
             std::vector<socket_packet_handler> buf_handlers_;
 
@@ -161,6 +261,23 @@ namespace uvgrtp {
 #else
             struct mmsghdr header_;
             struct iovec   chunks_[MAX_BUFFER_COUNT];
+
+            /* sendmmsg(2) headers, I/O vectors and UDP_SEGMENT control messages used by
+             * __sendtov(pkt_vec). They are kept across calls and only grown when
+             * a transaction needs more of them than the previous ones did */
+            std::vector<struct mmsghdr> send_hdrs_;
+            std::vector<struct iovec>   send_iovs_;
+            std::vector<char>           send_ctrl_;
+
+            /* How many RTP packets are sent with each header of "send_hdrs_" */
+            std::vector<size_t> send_segs_;
+
+            /* Consecutive RTP packets of equal size are sent as one UDP GSO super-packet
+             * if the kernel supports UDP_SEGMENT and system call clustering has not been disabled */
+            bool gso_;
+
+            /* SO_TXTIME has been enabled, the launch times given to sendto_at() are passed to the kernel */
+            bool txtime_;
 #endif
     };
 };
@@ -10,7 +10,6 @@
 #endif
 
 #include <cstdint>
-#include <unordered_set>
 #include <vector>
 
 #include "../debug.hh"
@@ -24,9 +23,25 @@
 #define SALT_LENGTH         14 /* 112 bits */
 #define AUTH_TAG_LENGTH     10
 #define SRTCP_INDEX_LENGTH   4
+#define GCM_TAG_LENGTH      16
+#define GCM_IV_LENGTH       12
+/* Packets tracked by the replay window. It covers the RTX_HISTORY_SIZE most recent
+ * packets so that a retransmission (RCE_RTCP_NACK) of any of them is still accepted */
+#define REPLAY_WINDOW_SIZE  1024
 
 namespace uvgrtp {
 
+    namespace crypto {
+        namespace aes {
+            class ctr;
+            class gcm;
+        };
+
+        namespace hmac {
+            class sha1;
+        };
+    };
+
     /* Vector of buffers that contain a full RTP frame */
     typedef std::vector<std::pair<size_t, uint8_t *>> buf_vec;
 
@@ -36,7 +51,8 @@ namespace uvgrtp {
     };
 
     enum ETYPE {
-        AES_128 = 0,
+        AES_128     = 0,
+        AES_128_GCM = 1,
     };
 
     enum HTYPE {
@@ -105,8 +121,12 @@ namespace uvgrtp {
         size_t n_a; /* size of hmac key */
 
         /* following fields are receiver-only */
-        uint16_t s_l;    /* highest received sequence number */
-        uint8_t *replay; /* list of recently received and authenticated SRTP packets */
+        uint64_t s_l;      /* highest received packet index */
+        bool replay_init;  /* has a packet been received, i.e. is "s_l" valid */
+
+        /* replay window, bit "index % REPLAY_WINDOW_SIZE" is set if packet "index"
+         * has been received, for the packets s_l - REPLAY_WINDOW_SIZE + 1 ... s_l */
+        uint64_t replay[REPLAY_WINDOW_SIZE / 64];
 
         int flags; /* context configuration flags */
 
@@ -141,12 +161,22 @@ namespace uvgrtp {
             /* Has RTP packet authentication been enabled? */
             bool authenticate_rtp();
 
+            /* Is the AEAD_AES_128_GCM profile used? */
+            bool use_aead();
+
+            /* How many bytes of authentication tag is appended to each RTP packet
+             * when a stream is created with "flags" (0 if the packets are not authenticated) */
+            static size_t get_tag_length(int flags);
+
             /* Get reference to the SRTP context (including session keys) */
             srtp_ctx_t *get_ctx();
 
-            /* Returns true if the packet having this HMAC digest is replayed
+            /* Check packet "index" (ROC || SEQ for SRTP, SRTCP index for SRTCP) against
+             * the replay window and mark it received. Must be called only for authenticated packets.
+             *
+             * Returns true if the packet has been received before or is too old for the window
              * Returns false if replay protection has not been enabled */
-            bool is_replayed_packet(uint8_t *digest);
+            bool is_replayed_packet(uint64_t index);
 
         protected:
             rtp_error_t derive_key(int label, uint8_t *key, uint8_t *salt, uint8_t *out, size_t len);
@@ -157,15 +187,14 @@ namespace uvgrtp {
              * Return RTP_INVALID_VALUE if one of the parameters is invalid */
             rtp_error_t create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt);
 
+            /* Create the 12-byte IV of RFC 7714 for AES-GCM */
+            rtp_error_t create_gcm_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt);
+
             /* Internal init method that initialize the SRTP context using values in key_ctx_.master */
             rtp_error_t init(int type, int flags);
             /* SRTP context containing all session information and keys */
             srtp_ctx_t *srtp_ctx_;
 
-            /* Map containing all authentication tags of received packets (separate for SRTP and SRTCP)
-             * Used to implement replay protection */
-            std::unordered_set<uint64_t> replay_list_;
-
             /* If NULL cipher is enabled, it means that RTP packets are not
              * encrypted but other security mechanisms described in RFC 3711 may be used */
             bool use_null_cipher_;
@@ -175,6 +204,21 @@ namespace uvgrtp {
              *
              * The authentication tag will occupy the last 8 bytes of the RTP packet */
             bool authenticate_rtp_;
+
+            /* Set if RCE_SRTP_AEAD_AES_128_GCM was given */
+            bool use_aead_;
+
+            /* Cipher and MAC state is keyed once when the session keys are derived and
+             * then reused for every packet, only the IV changes between packets.
+             *
+             * "local_" objects are used for outgoing and "remote_" objects for incoming packets
+             * so the sender and receiver threads don't share state */
+            uvgrtp::crypto::aes::ctr *local_ctr_;
+            uvgrtp::crypto::aes::ctr *remote_ctr_;
+            uvgrtp::crypto::hmac::sha1 *local_hmac_;
+            uvgrtp::crypto::hmac::sha1 *remote_hmac_;
+            uvgrtp::crypto::aes::gcm *local_gcm_;
+            uvgrtp::crypto::aes::gcm *remote_gcm_;
     };
 };
 
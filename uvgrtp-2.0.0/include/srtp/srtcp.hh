@@ -13,7 +13,7 @@ namespace uvgrtp {
              *
              * Report RTP_OK on succes
              * Return RTP_INVALID_VALUE if IV creation fails */
-            rtp_error_t encrypt(uint32_t ssrc, uint16_t seq, uint8_t *buffer, size_t len);
+            rtp_error_t encrypt(uint32_t ssrc, uint32_t index, uint8_t *buffer, size_t len);
 
             /* Calculate authentication tag for the RTCP packet
              *
@@ -35,7 +35,7 @@ namespace uvgrtp {
              * Return RTP_INVALID_VALUE if IV creation fails
              * Return RTP_AUTH_TAG_MISMATCH if authentication tag is incorrect
              * Return RTP_MEMORY_ERROR if memory allocation fails */
-            rtp_error_t decrypt(uint32_t ssrc, uint32_t seq, uint8_t *buffer, size_t len);
+            rtp_error_t decrypt(uint32_t ssrc, uint32_t index, uint8_t *buffer, size_t len);
     };
 };
 
@@ -12,6 +12,11 @@ namespace uvgrtp {
             /* TODO:  */
             rtp_error_t encrypt(uint32_t ssrc, uint16_t seq, uint8_t *buffer, size_t len);
 
+            /* Encrypt "len" bytes of "buffer" in place using AES-GCM, authenticate
+             * the ciphertext and the RTP header "aad" and write the tag to "tag" */
+            rtp_error_t encrypt_aead(uint32_t ssrc, uint16_t seq, uint8_t *aad, size_t aad_len,
+                                     uint8_t *buffer, size_t len, uint8_t *tag);
+
             /* TODO:  */
             rtp_error_t decrypt(uint8_t *buffer, size_t len);
 
@@ -20,6 +25,16 @@ namespace uvgrtp {
 
             /* Encrypt the payload of an RTP packet and add authentication tag (if enabled) */
             static rtp_error_t send_packet_handler(void *arg, buf_vec& buffers);
+
+        private:
+            /* Return the packet index (ROC || SEQ) of an outgoing packet and update the ROC */
+            uint64_t get_send_index(uint16_t seq);
+
+            /* Return the packet index (ROC || SEQ) of an incoming packet without updating the ROC */
+            uint64_t estimate_recv_index(uint16_t seq, uint32_t ts);
+
+            /* Return the packet index (ROC || SEQ) of an incoming packet and update the ROC */
+            uint64_t get_recv_index(uint16_t seq, uint32_t ts);
     };
 };
 
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+
+    /** Number of buckets in a latency histogram of ::uvgrtp::stream_stats
+     *
+     * Bucket 0 counts values below 1 microsecond and bucket i values
+     * from 2^(i-1) to 2^i - 1 microseconds. The last bucket also counts
+     * every value that is larger than that (about 4 seconds) */
+    const int STATS_LATENCY_BUCKETS = 24;
+
+    /** Number of buckets in a batch size histogram of ::uvgrtp::stream_stats
+     *
+     * Bucket i counts system calls that moved from 2^(i-1) to 2^i - 1 packets,
+     * the last bucket also counts all larger batches */
+    const int STATS_BATCH_BUCKETS = 12;
+
+    /**
+     * \brief Snapshot of the performance counters of a media stream
+     *
+     * \details The counters start from zero when the media stream is created
+     * and they are never reset. The rate of an event is the difference of two
+     * snapshots divided by the time between them
+     */
+    struct stream_stats {
+        uint64_t sent_packets;     ///< RTP, RTX and FEC packets given to the kernel
+        uint64_t sent_bytes;       ///< Bytes of the sent packets, including RTP headers
+        uint64_t send_syscalls;    ///< sendto(2)/sendmsg(2)/sendmmsg(2) calls that sent the packets
+        uint64_t txtime_errors;    ///< Packets the qdisc dropped because their launch time was missed or invalid (::RCE_TXTIME)
+
+        uint64_t recv_packets;     ///< Datagrams read from the RTP socket
+        uint64_t recv_bytes;       ///< Bytes of the read datagrams
+        uint64_t recv_syscalls;    ///< recvfrom(2)/recvmmsg(2) calls that returned datagrams
+
+        uint64_t frames_completed; ///< Frames given to the application
+        uint64_t frames_dropped;   ///< Incomplete, late and overflowing frames that were discarded
+
+        /// Number of send system calls by how many packets they sent
+        uint64_t send_batch[STATS_BATCH_BUCKETS];
+
+        /// Number of receive system calls by how many datagrams they returned
+        uint64_t recv_batch[STATS_BATCH_BUCKETS];
+
+        /// Time from the first received fragment of a frame to the completion of the frame
+        uint64_t reassembly_us[STATS_LATENCY_BUCKETS];
+
+        /// Time a completed frame waited in the frame queue until pull_frame() returned it
+        uint64_t pull_latency_us[STATS_LATENCY_BUCKETS];
+    };
+
+    /// \cond DO_NOT_DOCUMENT
+
+    /* Live counters behind uvgrtp::stream_stats
+     *
+     * Every update is a relaxed atomic addition done once per system call or
+     * once per frame so the counters are always enabled. The sender and the receiver
+     * update different counters so they do not contend for the same cache lines */
+    class stats {
+        public:
+            stats();
+            ~stats();
+
+            /* One send system call that sent "packets" packets of "bytes" bytes in total */
+            void add_send(size_t packets, size_t bytes);
+
+            /* The qdisc dropped a packet because of its launch time and reported it in the error queue */
+            void add_txtime_error();
+
+            /* One receive system call that returned "packets" datagrams of "bytes" bytes in total */
+            void add_recv(size_t packets, size_t bytes);
+
+            void add_completed_frame();
+            void add_dropped_frame();
+
+            void add_reassembly_time(uint64_t us);
+            void add_pull_latency(uint64_t us);
+
+            /* Copy the current values of the counters to "out" */
+            void snapshot(uvgrtp::stream_stats& out) const;
+
+        private:
+            typedef std::atomic<uint64_t> counter;
+
+            static void add(counter& c, uint64_t value);
+            static void copy(uint64_t *dst, const counter *src, size_t n);
+
+            /* Index of the histogram bucket of "value" when there are "nbuckets" buckets */
+            static size_t bucket(uint64_t value, size_t nbuckets);
+
+            struct alignas(64) {
+                counter packets;
+                counter bytes;
+                counter syscalls;
+                counter batch[STATS_BATCH_BUCKETS];
+                counter txtime_errors;
+            } send_;
+
+            struct alignas(64) {
+                counter packets;
+                counter bytes;
+                counter syscalls;
+                counter batch[STATS_BATCH_BUCKETS];
+                counter completed;
+                counter dropped;
+                counter reassembly[STATS_LATENCY_BUCKETS];
+                counter pull_latency[STATS_LATENCY_BUCKETS];
+            } recv_;
+    };
+
+    /// \endcond
+};
+
+namespace uvg_rtp = uvgrtp;
@@ -36,11 +36,17 @@ typedef SSIZE_T ssize_t;
 const int MAX_PACKET       = 65536;
 const int MAX_PAYLOAD      = 1446;
 const int PKT_MAX_DELAY    = 100;
+const int PACE_BURST_SIZE  = 16384;
+const int FEC_GROUP_SIZE   = 8;
+const int FEC_PAYLOAD_TYPE = 127;
+const int PLAYOUT_DELAY_MIN = 10;
+const int PLAYOUT_DELAY_MAX = 200;
 
 /* TODO: add ability for user to specify these? */
 enum HEADER_SIZES {
     ETH_HDR_SIZE  = 14,
     IPV4_HDR_SIZE = 20,
+    IPV6_HDR_SIZE = 40,
     UDP_HDR_SIZE  =  8,
     RTP_HDR_SIZE  = 12
 };
@@ -182,6 +188,7 @@ enum RTP_CTX_ENABLE_FLAGS {
 
     /** If SRTP is enabled and RCE_INPLACE_ENCRYPTION flag is *not* given,
      * uvgRTP will make a copy of the frame given to push_frame().
+     * The copies are made to memory blocks that are reused between frames.
      *
      * If the frame is writable and the application no longer needs the frame,
      * RCE_INPLACE_ENCRYPTION should be given to create_stream() to prevent
@@ -220,7 +227,67 @@ enum RTP_CTX_ENABLE_FLAGS {
      * in the firewall open */
     RCE_HOLEPUNCH_KEEPALIVE       = 1 << 14,
 
-    RCE_LAST                      = 1 << 15,
+    /** Service the receive socket, RTCP and holepuncher keepalives of the media stream
+     * from the shared epoll-based reactor of uvgrtp::context instead of creating
+     * separate threads for them. Reduces the number of threads when there are many streams.
+     *
+     * Linux only, on other platforms the stream falls back to using its own threads */
+    RCE_SHARED_REACTOR            = 1 << 15,
+
+    /** Protect RTP packets with the AEAD_AES_128_GCM profile of RFC 7714
+     * instead of AES-CM and HMAC-SHA1
+     *
+     * Every packet is encrypted and authenticated (the RTP header is authenticated
+     * but not encrypted) and carries a 16-byte authentication tag, so RCE_SRTP_AUTHENTICATE_RTP
+     * is implied. AES-NI/PCLMULQDQ or ARMv8 cryptography extensions are used when the CPU has them.
+     *
+     * NOTE: this flag must be coupled with RCE_SRTP and cannot be used with RCE_SRTP_NULL_CIPHER.
+     * SRTCP still uses AES-CM and HMAC-SHA1 */
+    RCE_SRTP_AEAD_AES_128_GCM     = 1 << 16,
+
+    /** Recover lost packets with RTCP generic NACK feedback (RFC 4585)
+     *
+     * The receiver requests the missing sequence numbers as soon as it notices a gap
+     * and repeats the request a few times until the frame deadline (RCC_PKT_MAX_DELAY).
+     * The sender keeps a copy of its most recent packets and resends the requested ones,
+     * either as such or as RFC 4588 RTX packets if RCC_RTX_PAYLOAD_TYPE has been set.
+     *
+     * NOTE: this flag must be coupled with RCE_RTCP and both ends must enable it */
+    RCE_RTCP_NACK                 = 1 << 17,
+
+    /** Protect the packets of each frame with XOR parity packets so that the receiver
+     * can rebuild a lost packet without waiting for a retransmission
+     *
+     * The packets of a frame are interleaved into groups of at most RCC_FEC_GROUP_SIZE packets
+     * and one parity packet is sent for each group, so one lost packet per group (or a burst
+     * of lost packets no longer than the number of groups) can be recovered.
+     *
+     * NOTE: both ends must enable this flag and use the same RCC_FEC_PAYLOAD_TYPE */
+    RCE_FEC                       = 1 << 18,
+
+    /** Pass the received frames through a jitter buffer that orders them by RTP timestamp
+     * and releases them to pull_frame() or the receive hook at their playout time
+     *
+     * The playout delay follows the interarrival jitter measured by RTCP, within the limits
+     * set with RCC_PLAYOUT_DELAY_MIN and RCC_PLAYOUT_DELAY_MAX. A frame that arrives after a newer
+     * frame has been released is dropped */
+    RCE_JITTER_BUFFER             = 1 << 19,
+
+    /** Let the kernel send each frame at the launch time given to push_frame() (SO_TXTIME)
+     *
+     * The packets are handed to the kernel immediately and the qdisc of the outgoing
+     * interface holds them until their launch time, so the send time does not depend on
+     * when the sending thread is scheduled. The launch time is in nanoseconds of the clock
+     * selected with RCC_TXTIME_CLOCK. If RCC_PACE_BITRATE is set, the bursts of a frame get
+     * consecutive launch times instead of the sender sleeping between them.
+     * Packets that the qdisc drops because of their launch time are counted in
+     * stream_stats::txtime_errors.
+     *
+     * NOTE: Linux only. The interface must use a qdisc that honors the launch time, fq with
+     * the default CLOCK_MONOTONIC or etf with CLOCK_TAI. Other qdiscs send the packets immediately */
+    RCE_TXTIME                    = 1 << 20,
+
+    RCE_LAST                      = 1 << 21,
 };
 
 /**
@@ -264,13 +331,76 @@ enum RTP_CTX_CONFIGURATION_FLAGS {
     /** Set a maximum value for the Ethernet frame size assumed by uvgRTP.
      *
      * Default is 1500, from this Ethernet, IPv4 and UDP, and RTP headers
-     * are removed from this, giving a payload size of 1446 bytes
+     * are removed from this, giving a payload size of 1446 bytes.
+     * With IPv6 the payload size is 20 bytes smaller
      *
      * If application wishes to use small UDP datagrams for some reason,
      * it can set MTU size to, for example, 500 bytes or if it wishes
      * to use jumbo frames, it can set the MTU size to 9000 bytes */
     RCC_MTU_SIZE         = 5,
 
+    /** Pace the outgoing packets of a media stream to this rate (in bits per second)
+     *
+     * Default is 0 which disables pacing and each frame is sent with one burst
+     *
+     * Large frames (e.g. intra frames of a high bitrate video) are fragmented into
+     * hundreds of packets which, when sent back-to-back, easily overflow
+     * the switch queues or the receiver's socket buffer. With pacing enabled,
+     * the packets of a frame are sent in bursts of RCC_PACE_BURST bytes and
+     * the sender sleeps between the bursts so that the average rate does not
+     * exceed the value set here. The value should be higher than the bitrate of
+     * the media so that the frames are still sent within one frame interval */
+    RCC_PACE_BITRATE     = 6,
+
+    /** How many bytes are sent in one burst when pacing is enabled with RCC_PACE_BITRATE
+     *
+     * Default is 16 kB */
+    RCC_PACE_BURST       = 7,
+
+    /** Send the retransmissions requested with RCE_RTCP_NACK as RFC 4588 RTX packets
+     * that use this dynamic payload type and their own SSRC and sequence numbers
+     *
+     * Default is 0 which resends the original packets. Both ends must use the same value.
+     * RTX cannot be used with SRTP, a stream with SRTP always resends the original packets */
+    RCC_RTX_PAYLOAD_TYPE = 8,
+
+    /** How many media packets are protected by one parity packet when RCE_FEC is enabled
+     *
+     * Default is 8, i.e., 12.5 % bandwidth overhead. A smaller value costs more bandwidth
+     * but survives more losses, 1 sends every packet twice */
+    RCC_FEC_GROUP_SIZE   = 9,
+
+    /** Dynamic payload type of the parity packets sent with RCE_FEC
+     *
+     * Default is 127. The value must not be used by the media of the stream */
+    RCC_FEC_PAYLOAD_TYPE = 10,
+
+    /** Smallest playout delay (in milliseconds) of the jitter buffer enabled with RCE_JITTER_BUFFER
+     *
+     * Default is 10 ms */
+    RCC_PLAYOUT_DELAY_MIN = 11,
+
+    /** Largest playout delay (in milliseconds) of the jitter buffer enabled with RCE_JITTER_BUFFER
+     *
+     * Default is 200 ms */
+    RCC_PLAYOUT_DELAY_MAX = 12,
+
+    /** TTL (IPv6 hop limit) of the RTP and RTCP packets sent to a multicast group
+     *
+     * Default is 1, i.e., the packets do not leave the local network */
+    RCC_MULTICAST_TTL     = 13,
+
+    /** Whether the multicast packets are also delivered to the receivers on this host
+     *
+     * Default is 1 (enabled), 0 disables the loopback */
+    RCC_MULTICAST_LOOPBACK = 14,
+
+    /** Clock of the launch times given to push_frame() when RCE_TXTIME is enabled
+     *
+     * Default is CLOCK_MONOTONIC (1) which is used by the fq qdisc,
+     * the etf qdisc uses CLOCK_TAI (11) */
+    RCC_TXTIME_CLOCK      = 15,
+
     RCC_LAST
 };
 
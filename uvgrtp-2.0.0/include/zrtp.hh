@@ -166,7 +166,7 @@ namespace uvgrtp {
              *
              * Return RTP_OK on success
              * Return RTP_TIMEOUT if remote did not send messages in timely manner */
-            rtp_error_t init(uint32_t ssrc, uvgrtp::socket *socket, sockaddr_in& addr);
+            rtp_error_t init(uint32_t ssrc, uvgrtp::socket *socket, sockaddr_storage& addr);
 
             /* Get SRTP keys for the session that was just initialized
              *
@@ -199,13 +199,13 @@ namespace uvgrtp {
              *
              * Return RTP_OK on success
              * Return RTP_TIMEOUT if remote did not send messages in timely manner */
-            rtp_error_t init_dhm(uint32_t ssrc, uvgrtp::socket *socket, sockaddr_in& addr);
+            rtp_error_t init_dhm(uint32_t ssrc, uvgrtp::socket *socket, sockaddr_storage& addr);
 
             /* Initialize ZRTP session between us and remote using Multistream mode
              *
              * Return RTP_OK on success
              * Return RTP_TIMEOUT if remote did not send messages in timely manner */
-            rtp_error_t init_msm(uint32_t ssrc, uvgrtp::socket *socket, sockaddr_in& addr);
+            rtp_error_t init_msm(uint32_t ssrc, uvgrtp::socket *socket, sockaddr_storage& addr);
 
             /* Generate zid for this ZRTP instance. ZID is a unique, 96-bit long ID */
             void generate_zid();
@@ -281,7 +281,7 @@ namespace uvgrtp {
 
             uint32_t ssrc_;
             uvgrtp::socket *socket_;
-            sockaddr_in addr_;
+            sockaddr_storage addr_;
 
             /* Has the ZRTP connection been initialized using DH */
             bool initialized_;
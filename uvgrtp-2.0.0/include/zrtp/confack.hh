@@ -22,7 +22,7 @@ namespace uvgrtp {
                 ~confack();
 
                 /* TODO:  */
-                rtp_error_t send_msg(uvgrtp::socket *socket, sockaddr_in& addr);
+                rtp_error_t send_msg(uvgrtp::socket *socket, sockaddr_storage& addr);
 
                 /* TODO:  */
                 rtp_error_t parse_msg(uvgrtp::zrtp_msg::receiver& receiver);
@@ -32,7 +32,7 @@ namespace uvgrtp {
                 ~dh_key_exchange();
 
                 /* TODO:  */
-                rtp_error_t send_msg(uvgrtp::socket *socket, sockaddr_in& addr);
+                rtp_error_t send_msg(uvgrtp::socket *socket, sockaddr_storage& addr);
 
                 /* TODO:  */
                 rtp_error_t parse_msg(uvgrtp::zrtp_msg::receiver& receiver, zrtp_session_t& session);
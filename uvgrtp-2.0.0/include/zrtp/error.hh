@@ -21,7 +21,7 @@ namespace uvgrtp {
                 error(int error_code);
                 ~error();
 
-                rtp_error_t send_msg(uvgrtp::socket *socket, sockaddr_in& addr);
+                rtp_error_t send_msg(uvgrtp::socket *socket, sockaddr_storage& addr);
 
                 rtp_error_t parse_msg(uvgrtp::zrtp_msg::receiver& receiver);
 
@@ -20,7 +20,7 @@ namespace uvgrtp {
                 hello_ack();
                 ~hello_ack();
 
-                rtp_error_t send_msg(uvgrtp::socket *socket, sockaddr_in& addr);
+                rtp_error_t send_msg(uvgrtp::socket *socket, sockaddr_storage& addr);
 
                 rtp_error_t parse_msg(uvgrtp::zrtp_msg::receiver& receiver);
 
@@ -33,11 +33,19 @@ uint64_t uvgrtp::clock::ntp::now()
     uint64_t tv_ntp, tv_usecs;
 
     tv_ntp = tv.tv_sec + EPOCH;
-    tv_usecs = (float)(NTP_SCALE_FRAC * tv.tv_usec) / (float)1000000UL;
+    tv_usecs = (NTP_SCALE_FRAC * tv.tv_usec) / 1000000UL;
 
     return (tv_ntp << 32) | tv_usecs;
 }
 
+uint64_t uvgrtp::clock::ntp::from_timespec(const struct timespec& ts)
+{
+    uint64_t ntp_secs = (uint64_t)ts.tv_sec + EPOCH;
+    uint64_t ntp_frac = (NTP_SCALE_FRAC * (uint64_t)ts.tv_nsec) / 1000000000UL;
+
+    return (ntp_secs << 32) | ntp_frac;
+}
+
 uint64_t uvgrtp::clock::ntp::diff(uint64_t ntp1, uint64_t ntp2)
 {
     return ntp_diff_ms(ntp1, ntp2);
@@ -50,6 +58,15 @@ uint64_t uvgrtp::clock::ntp::diff_now(uint64_t then)
     return ntp_diff_ms(now, then);
 }
 
+uint32_t uvgrtp::clock::ntp::diff_rtp(uint64_t ntp1, uint64_t ntp2, uint32_t clock_rate)
+{
+    uint64_t diff = ntp1 - ntp2;
+
+    /* whole seconds and the 32-bit fraction are scaled separately so that nothing overflows */
+    return (uint32_t)(diff >> 32) * clock_rate
+        + (uint32_t)(((diff & 0xffffffff) * clock_rate) >> 32);
+}
+
 uvgrtp::clock::hrc::hrc_t uvgrtp::clock::hrc::now()
 {
     return std::chrono::high_resolution_clock::now();
@@ -175,6 +175,63 @@ void uvgrtp::crypto::aes::ctr::decrypt(uint8_t *output, uint8_t *input, size_t l
 #endif
 }
 
+void uvgrtp::crypto::aes::ctr::set_iv(uint8_t *iv)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.Resynchronize(iv);
+    dec_.Resynchronize(iv);
+#else
+    (void)iv;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+uvgrtp::crypto::aes::gcm::gcm(uint8_t *key, size_t key_size)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.SetKey(key, key_size);
+    dec_.SetKey(key, key_size);
+#else
+    (void)key, (void)key_size;
+#endif
+}
+
+uvgrtp::crypto::aes::gcm::~gcm()
+{
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(uint8_t *output, uint8_t *input, size_t len,
+                                       uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len,
+                                       uint8_t *tag, size_t tag_len)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.EncryptAndAuthenticate(output, tag, tag_len, iv, iv_len, aad, aad_len, input, len);
+#else
+    (void)output, (void)input, (void)len, (void)iv, (void)iv_len;
+    (void)aad, (void)aad_len, (void)tag, (void)tag_len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+bool uvgrtp::crypto::aes::gcm::decrypt(uint8_t *output, uint8_t *input, size_t len,
+                                       uint8_t *iv, size_t iv_len, uint8_t *aad, size_t aad_len,
+                                       uint8_t *tag, size_t tag_len)
+{
+#ifdef __RTP_CRYPTO__
+    return dec_.DecryptAndVerify(output, tag, tag_len, iv, iv_len, aad, aad_len, input, len);
+#else
+    (void)output, (void)input, (void)len, (void)iv, (void)iv_len;
+    (void)aad, (void)aad_len, (void)tag, (void)tag_len;
+
+    LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
 uvgrtp::crypto::aes::cfb::cfb(uint8_t *key, size_t key_size, uint8_t *iv)
 #ifdef __RTP_CRYPTO__
     :enc_(key, key_size, iv),
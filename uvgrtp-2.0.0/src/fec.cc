@@ -0,0 +1,252 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include <cstring>
+
+#include "debug.hh"
+#include "fec.hh"
+#include "random.hh"
+
+static void __xor(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t a, b;
+
+        memcpy(&a, dst + i, sizeof(a));
+        memcpy(&b, src + i, sizeof(b));
+        a ^= b;
+        memcpy(dst + i, &a, sizeof(a));
+    }
+
+    for (; i < len; ++i)
+        dst[i] ^= src[i];
+}
+
+uvgrtp::fec::fec(uvgrtp::rtp *rtp):
+    rtp_(rtp)
+{
+    seq_ = uvgrtp::random::generate_32() & 0xffff;
+    staged_.valid = false;
+}
+
+uvgrtp::fec::~fec()
+{
+}
+
+rtp_error_t uvgrtp::fec::protect(uvgrtp::socket *socket, uvgrtp::pkt_vec& packets, uint64_t launch_time)
+{
+    size_t npkts   = packets.size();
+    size_t ngroups = (npkts + rtp_->get_fec_group_size() - 1) / rtp_->get_fec_group_size();
+    rtp_error_t ret = RTP_OK;
+
+    for (size_t group = 0; group < ngroups; ++group) {
+        size_t max_len = 0;
+        uint16_t count = 0;
+
+        for (size_t i = group; i < npkts; i += ngroups) {
+            size_t len = 0;
+
+            for (auto& buf : packets[i])
+                len += buf.first;
+
+            max_len = std::max(max_len, len - RTP_HDR_SIZE);
+        }
+
+        parity_.assign(RTP_HDR_SIZE + FEC_HDR_SIZE + max_len, 0);
+
+        uint8_t *hdr     = &parity_[RTP_HDR_SIZE];
+        uint8_t *payload = &parity_[RTP_HDR_SIZE + FEC_HDR_SIZE];
+
+        for (size_t i = group; i < npkts; i += ngroups, ++count) {
+            size_t off = 0;
+
+            for (auto& buf : packets[i]) {
+                size_t j = 0;
+
+                /* only the first two bytes and the timestamp of the RTP header are protected,
+                 * the sequence number and the SSRC are known by the receiver */
+                for (; j < buf.first && off + j < RTP_HDR_SIZE; ++j) {
+                    size_t pos = off + j;
+
+                    if (pos < 2 || (pos >= 4 && pos < 8))
+                        hdr[pos] ^= buf.second[j];
+                }
+
+                if (j < buf.first)
+                    __xor(payload + off + j - RTP_HDR_SIZE, buf.second + j, buf.first - j);
+
+                off += buf.first;
+            }
+
+            *(uint16_t *)&hdr[2] ^= htons((uint16_t)(off - RTP_HDR_SIZE));
+        }
+
+        uint8_t *first = packets[group][0].second;
+
+        parity_[0] = 2 << 6;
+        parity_[1] = rtp_->get_fec_payload() & 0x7f;
+
+        *(uint16_t *)&parity_[2] = htons(seq_++);
+        memcpy(&parity_[4], &first[4], sizeof(uint32_t) * 2);
+
+        memcpy(&hdr[8], &first[2], sizeof(uint16_t));
+        *(uint16_t *)&hdr[10] = htons(count);
+        *(uint16_t *)&hdr[12] = htons((uint16_t)ngroups);
+
+        if (socket->sendto_at(parity_.data(), parity_.size(), 0, launch_time) != RTP_OK)
+            ret = RTP_SEND_ERROR;
+    }
+
+    return ret;
+}
+
+void uvgrtp::fec::stage_packet(uint16_t seq, uint8_t *dgram, size_t len)
+{
+    staged_.valid = true;
+    staged_.seq   = seq;
+    staged_.data.assign(dgram, dgram + len);
+}
+
+rtp_error_t uvgrtp::fec::recover(uvgrtp::frame::rtp_frame *frame)
+{
+    if (frame->payload_len < (size_t)FEC_HDR_SIZE || history_.empty())
+        return RTP_INVALID_VALUE;
+
+    uint8_t *hdr    = frame->payload;
+    uint16_t base   = ntohs(*(uint16_t *)&hdr[8]);
+    uint16_t count  = ntohs(*(uint16_t *)&hdr[10]);
+    uint16_t stride = ntohs(*(uint16_t *)&hdr[12]);
+    size_t max_len  = frame->payload_len - FEC_HDR_SIZE;
+    int missing     = -1;
+
+    if (!count || !stride)
+        return RTP_INVALID_VALUE;
+
+    for (uint16_t i = 0; i < count; ++i) {
+        uint16_t seq = base + i * stride;
+        auto& slot   = history_[seq % FEC_RECV_HISTORY];
+
+        if (slot.valid && slot.seq == seq)
+            continue;
+
+        if (missing != -1)
+            return RTP_NOT_FOUND;
+        missing = i;
+    }
+
+    if (missing == -1)
+        return RTP_NOT_FOUND;
+
+    /* XOR the received packets of the group into the parity packet */
+    for (uint16_t i = 0; i < count; ++i) {
+        if (i == missing)
+            continue;
+
+        auto& data = history_[(uint16_t)(base + i * stride) % FEC_RECV_HISTORY].data;
+        size_t len = data.size() - RTP_HDR_SIZE;
+
+        if (len > max_len)
+            return RTP_INVALID_VALUE;
+
+        hdr[0] ^= data[0];
+        hdr[1] ^= data[1];
+        *(uint16_t *)&hdr[2] ^= htons((uint16_t)len);
+        __xor(&hdr[4], &data[4], sizeof(uint32_t));
+        __xor(&hdr[FEC_HDR_SIZE], &data[RTP_HDR_SIZE], len);
+    }
+
+    uint16_t seq = base + missing * stride;
+    size_t len   = ntohs(*(uint16_t *)&hdr[2]);
+
+    if (len > max_len || ((hdr[0] >> 6) & 0x3) != 2 || (hdr[0] & 0x3f)) {
+        LOG_DEBUG("Failed to rebuild packet %u", seq);
+        return RTP_INVALID_VALUE;
+    }
+
+    /* Write the rebuilt packet over the parity packet, it has the same SSRC */
+    uint8_t *dgram = frame->dgram;
+
+    dgram[0] = hdr[0];
+    dgram[1] = hdr[1];
+    *(uint16_t *)&dgram[2] = htons(seq);
+    memcpy(&dgram[4], &hdr[4], sizeof(uint32_t));
+    memmove(&dgram[RTP_HDR_SIZE], &hdr[FEC_HDR_SIZE], len);
+
+    frame->header.marker    = (dgram[1] & 0x80) ? 1 : 0;
+    frame->header.payload   = (dgram[1] & 0x7f);
+    frame->header.seq       = seq;
+    frame->header.timestamp = ntohl(*(uint32_t *)&dgram[4]);
+    frame->payload          = &dgram[RTP_HDR_SIZE];
+    frame->payload_len      = len;
+    frame->dgram_size       = RTP_HDR_SIZE + len;
+
+    stage_packet(seq, dgram, frame->dgram_size);
+
+    LOG_DEBUG("Rebuilt packet %u", seq);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::fec::packet_handler(void *arg, int flags, frame::rtp_frame **out)
+{
+    (void)flags;
+
+    auto fec   = (uvgrtp::fec *)arg;
+    auto frame = *out;
+
+    /* a copy left by a packet that SRTP rejected must not be saved under another packet */
+    fec->staged_.valid = false;
+
+    if (frame->header.payload == fec->rtp_->get_fec_payload()) {
+        if (fec->recover(frame) == RTP_OK)
+            return RTP_PKT_MODIFIED;
+
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return RTP_OK;
+    }
+
+    /* RFC 4588 retransmissions have their own sequence numbers, they are restored by RTCP */
+    if (fec->rtp_->get_rtx_payload() && frame->header.payload == fec->rtp_->get_rtx_payload())
+        return RTP_PKT_NOT_HANDLED;
+
+    fec->stage_packet(frame->header.seq, frame->dgram, frame->dgram_size);
+    return RTP_PKT_NOT_HANDLED;
+}
+
+rtp_error_t uvgrtp::fec::history_handler(void *arg, int flags, frame::rtp_frame **out)
+{
+    (void)flags;
+
+    auto fec   = (uvgrtp::fec *)arg;
+    auto frame = *out;
+
+    if (!fec->staged_.valid || fec->staged_.seq != frame->header.seq)
+        return RTP_PKT_NOT_HANDLED;
+
+    fec->staged_.valid = false;
+
+    if (fec->history_.empty()) {
+        fec->history_.resize(FEC_RECV_HISTORY);
+
+        for (auto& packet : fec->history_)
+            packet.valid = false;
+    }
+
+    auto& slot = fec->history_[frame->header.seq % FEC_RECV_HISTORY];
+
+    if (slot.valid && slot.seq == frame->header.seq) {
+        LOG_DEBUG("Dropping duplicate packet %u", frame->header.seq);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return RTP_OK;
+    }
+
+    slot.valid = true;
+    slot.seq   = frame->header.seq;
+    slot.data.swap(fec->staged_.data);
+
+    return RTP_PKT_NOT_HANDLED;
+}
@@ -167,8 +167,9 @@ rtp_error_t uvgrtp::formats::h264::push_nal_unit(uint8_t *data, size_t data_len,
 }
 
 uvgrtp::formats::h264::h264(uvgrtp::socket *socket, uvgrtp::rtp *rtp, int flags):
-    h26x(socket, rtp, flags)
+    h26x(socket, rtp, flags), finfo_{}
 {
+    finfo_.rtp_ctx = rtp;
 }
 
 uvgrtp::formats::h264::~h264()
@@ -85,6 +85,10 @@ static rtp_error_t __handle_stap_a(uvgrtp::formats::h264_frame_info_t *finfo, uv
         finfo->queued.push_back(retframe);
     }
 
+    /* all NAL units have been copied out of the aggregation packet */
+    (void)uvgrtp::frame::dealloc_frame(frame);
+    *out = nullptr;
+
     return RTP_MULTIPLE_PKTS_READY;
 }
 
@@ -115,6 +119,7 @@ static void __drop_frame(uvgrtp::formats::h264_frame_info_t *finfo, uint32_t ts)
         (void)uvgrtp::frame::dealloc_frame(fragment.second);
 
     finfo->frames.erase(ts);
+    finfo->rtp_ctx->get_stats()->add_dropped_frame();
 }
 
 rtp_error_t uvgrtp::formats::h264::packet_handler(void *arg, int flags, uvgrtp::frame::rtp_frame **out)
@@ -279,6 +284,7 @@ rtp_error_t uvgrtp::formats::h264::packet_handler(void *arg, int flags, uvgrtp::
             if (nal_type == NT_INTRA)
                 intra = INVALID_TS;
 
+            finfo->rtp_ctx->get_stats()->add_reassembly_time(uvgrtp::clock::hrc::diff_now_us(finfo->frames.at(c_ts).sframe_time));
             *out = complete;
             finfo->frames.erase(c_ts);
             return RTP_PKT_READY;
@@ -182,11 +182,20 @@ rtp_error_t uvgrtp::formats::h265::push_nal_unit(uint8_t *data, size_t data_len,
 uvgrtp::formats::h265::h265(uvgrtp::socket *socket, uvgrtp::rtp *rtp, int flags):
     h26x(socket, rtp, flags), finfo_{}
 {
-    finfo_.rtp_ctx = rtp;
+    finfo_.rtp_ctx    = rtp;
+    finfo_.intra      = 0xffffffff;
+    finfo_.wait_intra = false;
 }
 
 uvgrtp::formats::h265::~h265()
 {
+    for (auto& f : finfo_.frames) {
+        for (auto& fragment : f.second.fragments)
+            (void)uvgrtp::frame::dealloc_frame(fragment);
+    }
+
+    for (auto& f : finfo_.queued)
+        (void)uvgrtp::frame::dealloc_frame(f);
 }
 
 uvgrtp::formats::h265_frame_info_t *uvgrtp::formats::h265::get_h265_frame_info()
@@ -1,8 +1,7 @@
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
-#include <map>
-#include <unordered_set>
 
 #include "debug.hh"
 #include "queue.hh"
@@ -53,33 +52,116 @@ static int __get_frag(uvgrtp::frame::rtp_frame *frame)
     return FT_MIDDLE;
 }
 
-static inline uint8_t __get_nal(uvgrtp::frame::rtp_frame *frame)
+static inline uint8_t __nal_class(uint8_t type)
 {
-    switch (frame->payload[2] & 0x3f) {
-        case 19: return NT_INTRA;
-        case 1:  return NT_INTER;
-        default: break;
-    }
+    /* IRAP pictures (BLA, IDR and CRA) are random access points,
+     * the rest of the VCL NAL units depend on earlier pictures */
+    if (type >= 16 && type <= 21)
+        return NT_INTRA;
+
+    if (type <= 9)
+        return NT_INTER;
 
     return NT_OTHER;
 }
 
+static inline uint8_t __get_nal(uvgrtp::frame::rtp_frame *frame)
+{
+    return __nal_class(frame->payload[2] & 0x3f);
+}
+
 static inline bool __frame_late(uvgrtp::formats::h265_info_t& hinfo, size_t max_delay)
 {
     return (uvgrtp::clock::hrc::diff_now(hinfo.sframe_time) >= max_delay);
 }
 
+static bool __is_dropped(uvgrtp::formats::h265_frame_info_t *finfo, uint32_t ts)
+{
+    for (size_t i = 0; i < finfo->dropped_num; ++i) {
+        if (finfo->dropped[i] == ts)
+            return true;
+    }
+
+    return false;
+}
+
 static void __drop_frame(uvgrtp::formats::h265_frame_info_t *finfo, uint32_t ts)
 {
-    uint16_t s_seq = finfo->frames.at(ts).s_seq;
-    uint16_t e_seq = finfo->frames.at(ts).e_seq;
+    auto& hinfo    = finfo->frames.at(ts);
+    uint16_t s_seq = hinfo.s_seq;
+    uint16_t e_seq = hinfo.e_seq;
 
     LOG_INFO("Dropping frame %u, %u - %u", ts, s_seq, e_seq);
 
-    for (auto& fragment : finfo->frames.at(ts).fragments)
-        (void)uvgrtp::frame::dealloc_frame(fragment.second);
+    for (auto& fragment : hinfo.fragments)
+        (void)uvgrtp::frame::dealloc_frame(fragment);
+
+    if (finfo->intra == ts)
+        finfo->intra = INVALID_TS;
 
     finfo->frames.erase(ts);
+    finfo->rtp_ctx->get_stats()->add_dropped_frame();
+
+    /* remember the timestamp so that stray fragments of the frame are discarded */
+    finfo->dropped[finfo->dropped_pos] = ts;
+    finfo->dropped_pos = (finfo->dropped_pos + 1) % uvgrtp::formats::H265_DROPPED_MAX;
+
+    if (finfo->dropped_num < uvgrtp::formats::H265_DROPPED_MAX)
+        finfo->dropped_num++;
+
+    /* the decoder cannot use inter frames that refer to the lost frame */
+    finfo->wait_intra = true;
+    finfo->lost++;
+}
+
+/* Drop every late frame and, if the window is still full, the oldest frame.
+ * Called before a new frame is started so that incomplete frames never accumulate */
+static void __evict_frames(uvgrtp::formats::h265_frame_info_t *finfo, bool enable_idelay)
+{
+    size_t max_delay = finfo->rtp_ctx->get_pkt_max_delay();
+
+    for (auto it = finfo->frames.begin(); it != finfo->frames.end(); ) {
+        auto next = std::next(it);
+
+        if (__frame_late(it->second, max_delay)) {
+            /* with intra delay enabled an intra frame is kept until a newer one replaces it */
+            if (it->second.nal_type != NT_INTRA || !enable_idelay)
+                __drop_frame(finfo, it->first);
+        }
+
+        it = next;
+    }
+
+    if (finfo->frames.size() < uvgrtp::formats::H265_FRAME_WINDOW)
+        return;
+
+    auto oldest = finfo->frames.begin();
+
+    for (auto it = finfo->frames.begin(); it != finfo->frames.end(); ++it) {
+        if (it->second.sframe_time < oldest->second.sframe_time)
+            oldest = it;
+    }
+
+    __drop_frame(finfo, oldest->first);
+}
+
+/* Return true if a completed frame of type "nal_type" should be withheld from the user */
+static bool __gate_frame(uvgrtp::formats::h265_frame_info_t *finfo, uint8_t nal_type, bool enable_idelay)
+{
+    if (!enable_idelay)
+        return false;
+
+    if (nal_type == NT_INTRA) {
+        finfo->wait_intra = false;
+        return false;
+    }
+
+    if (nal_type == NT_INTER && (finfo->wait_intra || finfo->intra != INVALID_TS)) {
+        finfo->discarded++;
+        return true;
+    }
+
+    return false;
 }
 
 static rtp_error_t __handle_ap(uvgrtp::formats::h265_frame_info_t *finfo, uvgrtp::frame::rtp_frame **out)
@@ -113,6 +195,10 @@ static rtp_error_t __handle_ap(uvgrtp::formats::h265_frame_info_t *finfo, uvgrtp
         finfo->queued.push_back(retframe);
     }
 
+    /* all NAL units have been copied out of the aggregation packet */
+    (void)uvgrtp::frame::dealloc_frame(frame);
+    *out = nullptr;
+
     return RTP_MULTIPLE_PKTS_READY;
 }
 
@@ -122,7 +208,7 @@ rtp_error_t uvgrtp::formats::h265::packet_handler(void *arg, int flags, uvgrtp::
     bool enable_idelay = !(flags & RCE_NO_H26X_INTRA_DELAY);
     auto finfo = (uvgrtp::formats::h265_frame_info_t *)arg;
 
-    /* Use "intra" to keep track of intra frames
+    /* "finfo->intra" keeps track of intra frames
      *
      * If uvgRTP is in the process of receiving fragments of an incomplete intra frame,
      * "intra" shall be the timestamp value of that intra frame.
@@ -133,9 +219,10 @@ rtp_error_t uvgrtp::formats::h265::packet_handler(void *arg, int flags, uvgrtp::
      * If "intra" contains INVALID_TS and all packets of an inter frame have been received,
      * the inter frame is returned to user.  If intra contains a value other than INVALID_TS
      * (meaning an intra frame is in progress) and a new intra frame is received, the old intra frame
-     * pointed to by "intra" and new intra frame shall take the place of active intra frame */
-    uint32_t intra = INVALID_TS;
-
+     * pointed to by "intra" and new intra frame shall take the place of active intra frame
+     *
+     * "finfo->wait_intra" is set whenever a frame is lost. Until the next intra frame has been
+     * received, completed inter frames are discarded as the decoder could not use them anyway */
     const size_t H265_HDR_SIZE =
         uvgrtp::frame::HEADER_SIZE_H265_NAL +
         uvgrtp::frame::HEADER_SIZE_H265_FU;
@@ -151,22 +238,23 @@ rtp_error_t uvgrtp::formats::h265::packet_handler(void *arg, int flags, uvgrtp::
         return __handle_ap(finfo, out);
 
     if (frag_type == FT_NOT_FRAG) {
-        if (flags & RCE_H26X_PREPEND_SC) {
-            uint8_t *pl = new uint8_t[(*out)->payload_len + 4];
+        if (__gate_frame(finfo, __nal_class((frame->payload[0] >> 1) & 0x3f), enable_idelay)) {
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            *out = nullptr;
+            return RTP_OK;
+        }
 
-            if (!pl) {
-                LOG_ERROR("Failed to allocate space for a start code");
-                return RTP_GENERIC_ERROR;
-            }
+        /* The payload points to the received datagram and it's preceded by
+         * at least the RTP header which has already been parsed so the start code
+         * can be written over the end of the RTP header without copying the payload */
+        if (flags & RCE_H26X_PREPEND_SC) {
+            uint8_t *pl = (*out)->payload - 4;
 
             pl[0] = 0;
             pl[1] = 0;
             pl[2] = 0;
             pl[3] = 1;
 
-            std::memcpy(pl + 4, (*out)->payload, (*out)->payload_len);
-            delete[] (*out)->payload;
-
             (*out)->payload      = pl;
             (*out)->payload_len += 4;
         }
@@ -181,115 +269,103 @@ rtp_error_t uvgrtp::formats::h265::packet_handler(void *arg, int flags, uvgrtp::
         return RTP_GENERIC_ERROR;
     }
 
+    auto it = finfo->frames.find(c_ts);
+
     /* initialize new frame */
-    if (finfo->frames.find(c_ts) == finfo->frames.end()) {
+    if (it == finfo->frames.end()) {
 
         /* make sure we haven't discarded the frame "c_ts" before */
-        if (finfo->dropped.find(c_ts) != finfo->dropped.end()) {
+        if (__is_dropped(finfo, c_ts)) {
             LOG_WARN("packet belonging to a dropped frame was received!");
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            *out = nullptr;
             return RTP_GENERIC_ERROR;
         }
 
+        __evict_frames(finfo, enable_idelay);
+
         /* drop old intra if a new one is received */
         if (nal_type == NT_INTRA) {
-            if (intra != INVALID_TS && enable_idelay) {
-                __drop_frame(finfo, intra);
-                finfo->dropped.insert(intra);
-            }
-            intra = c_ts;
+            if (finfo->intra != INVALID_TS && enable_idelay)
+                __drop_frame(finfo, finfo->intra);
+            finfo->intra = c_ts;
         }
 
-        finfo->frames[c_ts].s_seq = INVALID_SEQ;
-        finfo->frames[c_ts].e_seq = INVALID_SEQ;
+        auto& hinfo = finfo->frames[c_ts];
 
-        if (frag_type == FT_START) finfo->frames[c_ts].s_seq = c_seq;
-        if (frag_type == FT_END)   finfo->frames[c_ts].e_seq = c_seq;
+        hinfo.s_seq = INVALID_SEQ;
+        hinfo.e_seq = INVALID_SEQ;
 
-        finfo->frames[c_ts].sframe_time   = uvgrtp::clock::hrc::now();
-        finfo->frames[c_ts].total_size    = frame->payload_len - H265_HDR_SIZE;
-        finfo->frames[c_ts].pkts_received = 1;
+        if (frag_type == FT_START) hinfo.s_seq = c_seq;
+        if (frag_type == FT_END)   hinfo.e_seq = c_seq;
 
-        finfo->frames[c_ts].fragments[c_seq] = frame;
+        hinfo.nal_type      = nal_type;
+        hinfo.sframe_time   = uvgrtp::clock::hrc::now();
+        hinfo.total_size    = frame->payload_len - H265_HDR_SIZE;
+        hinfo.pkts_received = 1;
+
+        hinfo.fragments.clear();
+        hinfo.fragments.push_back(frame);
         return RTP_OK;
     }
 
-    finfo->frames[c_ts].pkts_received += 1;
-    finfo->frames[c_ts].total_size    += (frame->payload_len - H265_HDR_SIZE);
+    auto& hinfo = it->second;
 
-    if (frag_type == FT_START) {
-        finfo->frames[c_ts].s_seq = c_seq;
-        finfo->frames[c_ts].fragments[c_seq] = frame;
+    hinfo.pkts_received += 1;
+    hinfo.total_size    += (frame->payload_len - H265_HDR_SIZE);
+    hinfo.fragments.push_back(frame);
 
-        for (auto& fragment : finfo->frames[c_ts].temporary) {
-            uint16_t fseq = fragment->header.seq;
-            uint32_t seq  = (c_seq > fseq) ? 0x10000 + fseq : fseq;
-
-            finfo->frames[c_ts].fragments[seq] = fragment;
-        }
-        finfo->frames[c_ts].temporary.clear();
-    }
+    if (frag_type == FT_START)
+        hinfo.s_seq = c_seq;
 
     if (frag_type == FT_END)
-        finfo->frames[c_ts].e_seq = c_seq;
-
-    /* Out-of-order nature poses an interesting problem when reconstructing the frame:
-     * how to store the fragments such that we mustn't shuffle them around when frame reconstruction takes place?
-     *
-     * std::map is an option but the overflow of 16-bit sequence number counter makes that a little harder because
-     * if the first few fragments of a frame are near 65535, the rest of the fragments are going to have sequence
-     * numbers less than that and thus our frame reconstruction breaks.
-     *
-     * This can be solved by checking if current fragment's sequence is less than start fragment's sequence number
-     * (overflow has occurred) and correcting the current sequence by adding 0x10000 to its value so it appears
-     * in order with other fragments */
-    if (frag_type != FT_START) {
-        if (finfo->frames[c_ts].s_seq != INVALID_SEQ) {
-            /* overflow has occurred, adjust the sequence number of current
-             * fragment so it appears in order with other fragments of the frame
-             *
-             * Note: if the frame is huge (~94 MB), this will not work but it's not a realistic scenario */
-            finfo->frames[c_ts].fragments[((finfo->frames[c_ts].s_seq > c_seq) ? 0x10000 + c_seq : c_seq)] = frame;
-        } else {
-            /* position for the fragment cannot be calculated so move the fragment to a temporary storage */
-            finfo->frames[c_ts].temporary.push_back(frame);
-        }
-    }
+        hinfo.e_seq = c_seq;
 
-    if (finfo->frames[c_ts].s_seq != INVALID_SEQ && finfo->frames[c_ts].e_seq != INVALID_SEQ) {
-        size_t received = 0;
+    if (hinfo.s_seq != INVALID_SEQ && hinfo.e_seq != INVALID_SEQ) {
+        uint16_t s_seq  = (uint16_t)hinfo.s_seq;
+        uint16_t e_seq  = (uint16_t)hinfo.e_seq;
+        size_t received = (uint16_t)(e_seq - s_seq) + 1;
         size_t fptr     = 0;
-        size_t s_seq    = finfo->frames[c_ts].s_seq;
-        size_t e_seq    = finfo->frames[c_ts].e_seq;
-
-        if (s_seq > e_seq)
-            received = 0xffff - s_seq + e_seq + 2;
-        else
-            received = e_seq - s_seq + 1;
 
         /* we've received every fragment and the frame can be reconstructed */
-        if (received == finfo->frames[c_ts].pkts_received) {
+        if (received == hinfo.pkts_received) {
+            if (nal_type == NT_INTRA && finfo->intra == c_ts)
+                finfo->intra = INVALID_TS;
 
-            /* intra is still in progress, do not return the inter */
-            if (nal_type == NT_INTER && intra != INVALID_TS && enable_idelay) {
-                __drop_frame(finfo, c_ts);
-                finfo->dropped.insert(c_ts);
+            /* intra is still in progress or a frame was lost, do not return the inter */
+            if (__gate_frame(finfo, nal_type, enable_idelay)) {
+                for (auto& fragment : hinfo.fragments)
+                    (void)uvgrtp::frame::dealloc_frame(fragment);
+
+                finfo->frames.erase(it);
+                *out = nullptr;
                 return RTP_OK;
             }
 
+            /* Fragments are stored in arrival order. Sort them relative to the start fragment
+             * so that the 16-bit sequence number wrapping around inside a frame does not
+             * change their order */
+            std::sort(hinfo.fragments.begin(), hinfo.fragments.end(),
+                [s_seq](uvgrtp::frame::rtp_frame *a, uvgrtp::frame::rtp_frame *b) {
+                    return (uint16_t)(a->header.seq - s_seq) < (uint16_t)(b->header.seq - s_seq);
+                }
+            );
+
             uint8_t nal_header[2] = {
                 (uint8_t)((frame->payload[0] & 0x81) | ((frame->payload[2] & 0x3f) << 1)),
                 (uint8_t)frame->payload[1]
             };
 
-            uvgrtp::frame::rtp_frame *complete = uvgrtp::frame::alloc_rtp_frame();
-
-            complete->payload_len =
-                finfo->frames[c_ts].total_size
-                + uvgrtp::frame::HEADER_SIZE_H265_NAL +
-                + ((flags & RCE_H26X_PREPEND_SC) ? 4 : 0);
+            uvgrtp::frame::rtp_frame *complete = uvgrtp::frame::alloc_rtp_frame(
+                hinfo.total_size
+                + uvgrtp::frame::HEADER_SIZE_H265_NAL
+                + ((flags & RCE_H26X_PREPEND_SC) ? 4 : 0)
+            );
 
-            if (!(complete->payload = new uint8_t[complete->payload_len])) {
+            if (!complete) {
                 LOG_ERROR("Failed to allocate memory for RTP frame");
+                *out = nullptr;
+                __drop_frame(finfo, c_ts);
                 return RTP_GENERIC_ERROR;
             }
 
@@ -301,35 +377,33 @@ rtp_error_t uvgrtp::formats::h265::packet_handler(void *arg, int flags, uvgrtp::
                 fptr                 += 4;
             }
 
-            std::memcpy(&complete->header,        &(*out)->header, RTP_HDR_SIZE);
-            std::memcpy(&complete->payload[fptr], nal_header,      NAL_HDR_SIZE);
+            std::memcpy(&complete->header,        &frame->header, RTP_HDR_SIZE);
+            std::memcpy(&complete->payload[fptr], nal_header,     NAL_HDR_SIZE);
 
             fptr += uvgrtp::frame::HEADER_SIZE_H265_NAL;
 
-            for (auto& fragment : finfo->frames.at(c_ts).fragments) {
+            for (auto& fragment : hinfo.fragments) {
                 std::memcpy(
                     &complete->payload[fptr],
-                    &fragment.second->payload[H265_HDR_SIZE],
-                    fragment.second->payload_len - H265_HDR_SIZE
+                    &fragment->payload[H265_HDR_SIZE],
+                    fragment->payload_len - H265_HDR_SIZE
                 );
-                fptr += fragment.second->payload_len - H265_HDR_SIZE;
-                (void)uvgrtp::frame::dealloc_frame(fragment.second);
+                fptr += fragment->payload_len - H265_HDR_SIZE;
+                (void)uvgrtp::frame::dealloc_frame(fragment);
             }
 
-            if (nal_type == NT_INTRA)
-                intra = INVALID_TS;
-
+            finfo->rtp_ctx->get_stats()->add_reassembly_time(uvgrtp::clock::hrc::diff_now_us(hinfo.sframe_time));
             *out = complete;
-            finfo->frames.erase(c_ts);
+            finfo->frames.erase(it);
             return RTP_PKT_READY;
         }
     }
 
-    if (__frame_late(finfo->frames.at(c_ts), finfo->rtp_ctx->get_pkt_max_delay())) {
-        if (nal_type != NT_INTRA || (nal_type == NT_INTRA && !enable_idelay)) {
+    *out = nullptr;
+
+    if (__frame_late(hinfo, finfo->rtp_ctx->get_pkt_max_delay())) {
+        if (nal_type != NT_INTRA || (nal_type == NT_INTRA && !enable_idelay))
             __drop_frame(finfo, c_ts);
-            finfo->dropped.insert(c_ts);
-        }
     }
 
     return RTP_OK;
@@ -76,6 +76,7 @@ static void __drop_frame(uvgrtp::formats::h266_frame_info_t *finfo, uint32_t ts)
         (void)uvgrtp::frame::dealloc_frame(fragment.second);
 
     finfo->frames.erase(ts);
+    finfo->rtp_ctx->get_stats()->add_dropped_frame();
 }
 
 rtp_error_t uvgrtp::formats::h266::packet_handler(void *arg, int flags, uvgrtp::frame::rtp_frame **out)
@@ -113,22 +114,17 @@ rtp_error_t uvgrtp::formats::h266::packet_handler(void *arg, int flags, uvgrtp::
     /*     return __handle_ap(finfo, out); */
 
     if (frag_type == FT_NOT_FRAG) {
+        /* The payload points to the received datagram and it's preceded by
+         * at least the RTP header which has already been parsed so the start code
+         * can be written over the end of the RTP header without copying the payload */
         if (flags & RCE_H26X_PREPEND_SC) {
-            uint8_t *pl = new uint8_t[(*out)->payload_len + 4];
-
-            if (!pl) {
-                LOG_ERROR("Failed to allocate space for a start code");
-                return RTP_GENERIC_ERROR;
-            }
+            uint8_t *pl = (*out)->payload - 4;
 
             pl[0] = 0;
             pl[1] = 0;
             pl[2] = 0;
             pl[3] = 1;
 
-            std::memcpy(pl + 4, (*out)->payload, (*out)->payload_len);
-            delete[] (*out)->payload;
-
             (*out)->payload      = pl;
             (*out)->payload_len += 4;
         }
@@ -252,6 +248,7 @@ rtp_error_t uvgrtp::formats::h266::packet_handler(void *arg, int flags, uvgrtp::
 
             if (!(complete->payload = new uint8_t[complete->payload_len])) {
                 LOG_ERROR("Failed to allocate memory for RTP frame");
+                *out = nullptr;
                 return RTP_GENERIC_ERROR;
             }
 
@@ -281,6 +278,7 @@ rtp_error_t uvgrtp::formats::h266::packet_handler(void *arg, int flags, uvgrtp::
             if (nal_type == NT_INTRA)
                 intra = INVALID_TS;
 
+            finfo->rtp_ctx->get_stats()->add_reassembly_time(uvgrtp::clock::hrc::diff_now_us(finfo->frames.at(c_ts).sframe_time));
             *out = complete;
             finfo->frames.erase(c_ts);
             return RTP_PKT_READY;
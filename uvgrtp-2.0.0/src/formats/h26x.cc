@@ -14,221 +14,167 @@
 
 #include "formats/h26x.hh"
 
-#define PTR_DIFF(a, b)  ((ptrdiff_t)((char *)(a) - (char *)(b)))
-
-#define haszero64_le(v) (((v) - 0x0101010101010101) & ~(v) & 0x8080808080808080UL)
-#define haszero32_le(v) (((v) - 0x01010101)         & ~(v) & 0x80808080UL)
-
-#define haszero64_be(v) (((v) - 0x1010101010101010) & ~(v) & 0x0808080808080808UL)
-#define haszero32_be(v) (((v) - 0x10101010)         & ~(v) & 0x08080808UL)
-
-#ifndef __LITTLE_ENDIAN
-#define __LITTLE_ENDIAN 1337
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define H26X_SIMD_SCAN
+#ifdef _MSC_VER
+#include <intrin.h>
 #endif
-
-#ifndef __BYTE_ORDER
-#define __BYTE_ORDER __LITTLE_ENDIAN
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define H26X_SIMD_SCAN
 #endif
 
-static inline unsigned __find_h26x_start(uint32_t value)
+/* Start code at data[i], i >= offset: 0x000001 is a 3-byte start code,
+ * or a 4-byte one if the byte before it is also zero and belongs to the searched area.
+ * Return the position of the first byte after the start code */
+static inline ssize_t __start_code_at(const uint8_t *data, size_t offset, size_t i, uint8_t& start_len)
 {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-    uint16_t u = (value >> 16) & 0xffff;
-    uint16_t l = (value >>  0) & 0xffff;
-
-    bool t1 = (l == 0);
-    bool t2 = ((u & 0xff) == 0x01);
-    bool t3 = (u == 0x0100);
-    bool t4 = (((l >> 8) & 0xff) == 0);
-#else
-    uint16_t u = (value >>  0) & 0xffff;
-    uint16_t l = (value >> 16) & 0xffff;
+    start_len = (i > offset && data[i - 1] == 0) ? 4 : 3;
+    return i + 3;
+}
 
-    bool t1 = (l == 0);
-    bool t2 = (((u >> 8) & 0xff) == 0x01);
-    bool t3 = (u == 0x0001);
-    bool t4 = ((l & 0xff) == 0);
-#endif
+/* Byte-by-byte scan of data[pos] - data[len - 1]. If data[i + 2] is greater than one,
+ * no start code can begin at i, i + 1 or i + 2 so three bytes can be skipped at once */
+static inline ssize_t __find_start_tail(const uint8_t *data, size_t len, size_t offset, size_t pos, uint8_t& start_len)
+{
+    for (size_t i = pos; i + 3 < len; ++i) {
+        if (data[i + 2] > 1) {
+            i += 2;
+            continue;
+        }
 
-    if (t1) {
-        /* 0x00000001 */
-        if (t3)
-            return 4;
-
-        /* "value" definitely has a start code (0x000001XX), but at this
-         * point we can't know for sure whether it's 3 or 4 bytes long.
-         *
-         * Return 5 to indicate that start length could not be determined
-         * and that caller must check previous dword's last byte for 0x00 */
-        if (t2)
-            return 5;
-    } else if (t4 && t3) {
-        /* 0xXX000001 */
-        return 4;
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+            return __start_code_at(data, offset, i, start_len);
     }
 
-    return 0;
+    return -1;
+}
+
+#ifdef H26X_SIMD_SCAN
+/* Index of the lowest set bit of a comparison mask, "mask" must not be zero */
+static inline unsigned __first_set_bit(uint64_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, mask);
+    return (unsigned)idx;
+#else
+    return (unsigned)__builtin_ctzll(mask);
+#endif
 }
 
-/* NOTE: the area 0 - len (ie data[0] - data[len - 1]) must be addressable
- * Do not add offset to "data" ptr before passing it to find_h26x_start_code()! */
+/* Vector scan: for each position i in a block, compare data[i], data[i + 1] and data[i + 2]
+ * against 0x00, 0x00 and 0x01 using three unaligned loads, AND the results and locate
+ * the first set lane. The input is only read, never written */
 ssize_t uvgrtp::formats::h26x::find_h26x_start_code(
-    uint8_t *data,
+    const uint8_t *data,
     size_t len,
     size_t offset,
     uint8_t& start_len
 )
 {
-    bool prev_z   = false;
-    bool cur_z    = false;
-    size_t pos    = offset;
-    size_t rpos   = len - (len % 8) - 1;
-    uint8_t *ptr  = data + offset;
-    uint8_t *tmp  = nullptr;
-    uint8_t lb    = 0;
-    uint32_t prev = UINT32_MAX;
-
-    uint64_t prefetch = UINT64_MAX;
-    uint32_t value    = UINT32_MAX;
-    unsigned ret      = 0;
-
-    /* We can get rid of the bounds check when looping through
-     * non-zero 8 byte chunks by setting the last byte to zero.
-     *
-     * This added zero will make the last 8 byte zero check to fail
-     * and when we get out of the loop we can check if we've reached the end */
-    lb = data[rpos];
-    data[rpos] = 0;
-
-    while (pos + 8 < len) {
-        prefetch = *(uint64_t *)ptr;
-
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        if (!prev_z && !(cur_z = haszero64_le(prefetch))) {
-#else
-        if (!prev_z && !(cur_z = haszero64_be(prefetch))) {
-#endif
-            /* pos is not used in the following loop so it makes little sense to
-             * update it on every iteration. Faster way to do the loop is to save
-             * ptr's current value before loop, update only ptr in the loop and when
-             * the loop is exited, calculate the difference between tmp and ptr to get
-             * the number of iterations done * 8 */
-            tmp = ptr;
-
-            do {
-                ptr      += 8;
-                prefetch  = *(uint64_t *)ptr;
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-                cur_z     = haszero64_le(prefetch);
-#else
-                cur_z     = haszero64_be(prefetch);
-#endif
-            } while (!cur_z);
+    size_t pos = offset;
+
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one  = _mm256_set1_epi8(1);
 
-            pos += PTR_DIFF(ptr, tmp);
+    /* the last lane of the block must be followed by at least one byte of payload */
+    while (pos + 32 + 3 <= len) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(data + pos));
 
-            if (pos + 8 >= len)
-                break;
+        /* a start code can only begin at a zero byte, skip blocks without any */
+        if (!_mm256_movemask_epi8(_mm256_cmpeq_epi8(b0, zero))) {
+            pos += 32;
+            continue;
         }
 
-        value = *(uint32_t *)ptr;
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(data + pos + 1));
+        __m256i b2 = _mm256_loadu_si256((const __m256i *)(data + pos + 2));
 
-        if (cur_z)
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-            cur_z = haszero32_le(value);
-#else
-            cur_z = haszero32_be(value);
-#endif
+        __m256i m = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(b0, zero), _mm256_cmpeq_epi8(b1, zero)),
+            _mm256_cmpeq_epi8(b2, one)
+        );
 
-        if (!prev_z && !cur_z)
-            goto end;
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
 
-        /* Previous dword had zeros but this doesn't. The only way there might be a start code
-         * is if the most significant byte of current dword is 0x01 */
-        if (prev_z && !cur_z) {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-            /* previous dword: 0xXX000000 or 0xXXXX0000 and current dword 0x01XXXXXX */
-            if (((value  >> 0) & 0xff) == 0x01 && ((prev >> 16) & 0xffff) == 0) {
-                start_len = (((prev >>  8) & 0xffffff) == 0) ? 4 : 3;
-#else
-            if (((value >> 24) & 0xff) == 0x01 && ((prev >>  0) & 0xffff) == 0) {
-                start_len = (((prev >>  0) & 0xffffff) == 0) ? 4 : 3;
+        if (mask)
+            return __start_code_at(data, offset, pos + __first_set_bit(mask), start_len);
+
+        pos += 32;
+    }
 #endif
-                data[rpos] = lb;
-                return pos + 1;
-            }
+
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i zero16 = _mm_setzero_si128();
+    const __m128i one16  = _mm_set1_epi8(1);
+
+    while (pos + 16 + 3 <= len) {
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(data + pos));
+
+        if (!_mm_movemask_epi8(_mm_cmpeq_epi8(b0, zero16))) {
+            pos += 16;
+            continue;
         }
 
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(data + pos + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i *)(data + pos + 2));
 
-        {
-            if ((ret = start_len = __find_h26x_start(value)) > 0) {
-                if (ret == 5) {
-                    ret = 3;
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-                    start_len = (((prev >> 24) & 0xff) == 0) ? 4 : 3;
-#else
-                    start_len = (((prev >>  0) & 0xff) == 0) ? 4 : 3;
-#endif
-                }
+        __m128i m = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(b0, zero16), _mm_cmpeq_epi8(b1, zero16)),
+            _mm_cmpeq_epi8(b2, one16)
+        );
 
-                data[rpos] = lb;
-                return pos + ret;
-            }
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(m);
 
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-            uint16_t u = (value >> 16) & 0xffff;
-            uint16_t l = (value >>  0) & 0xffff;
-            uint16_t p = (prev  >> 16) & 0xffff;
+        if (mask)
+            return __start_code_at(data, offset, pos + __first_set_bit(mask), start_len);
 
-            bool t1 = ((p & 0xffff) == 0);
-            bool t2 = (((p >> 8) & 0xff) == 0);
-            bool t4 = (l == 0x0100);
-            bool t5 = (l == 0x0000 && u == 0x01);
-#else
-            uint16_t u = (value >>  0) & 0xffff;
-            uint16_t l = (value >> 16) & 0xffff;
-            uint16_t p = (prev  >>  0) & 0xffff;
-
-            bool t1 = ((p & 0xffff) == 0);
-            bool t2 = ((p & 0xff) == 0);
-            bool t4 = (l == 0x0001);
-            bool t5 = (l == 0x0000 && u == 0x01);
-#endif
-            if (t1 && t4) {
-                /* previous dword 0xxxxx0000 and current dword is 0x0001XXXX */
-                if (t4) {
-                    start_len = 4;
-                    data[rpos] = lb;
-                    return pos + 2;
-                }
-            /* Previous dwod was 0xXXXXXX00 */
-            } else if (t2) {
-                /* Current dword is 0x000001XX */
-                if (t5) {
-                    start_len = 4;
-                    data[rpos] = lb;
-                    return pos + 3;
-                }
-
-                /* Current dword is 0x0001XXXX */
-                else if (t4) {
-                    start_len = 3;
-                    data[rpos] = lb;
-                    return pos + 2;
-                }
-            }
+        pos += 16;
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t zero16 = vdupq_n_u8(0);
+    const uint8x16_t one16  = vdupq_n_u8(1);
 
+    while (pos + 16 + 3 <= len) {
+        uint8x16_t z0 = vceqq_u8(vld1q_u8(data + pos), zero16);
+
+        if (vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(z0), 4)), 0) == 0) {
+            pos += 16;
+            continue;
         }
-end:
-        prev_z = cur_z;
-        pos += 4;
-        ptr += 4;
-        prev = value;
+
+        uint8x16_t m = vandq_u8(
+            vandq_u8(z0, vceqq_u8(vld1q_u8(data + pos + 1), zero16)),
+            vceqq_u8(vld1q_u8(data + pos + 2), one16)
+        );
+
+        /* narrow each 8-bit lane to 4 bits so the whole comparison result fits in 64 bits */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+
+        if (mask)
+            return __start_code_at(data, offset, pos + (__first_set_bit(mask) >> 2), start_len);
+
+        pos += 16;
     }
+#endif
 
-    data[rpos] = lb;
-    return -1;
+    return __find_start_tail(data, len, offset, pos, start_len);
 }
+#else
+/* Portable scan for targets without SIMD support */
+ssize_t uvgrtp::formats::h26x::find_h26x_start_code(
+    const uint8_t *data,
+    size_t len,
+    size_t offset,
+    uint8_t& start_len
+)
+{
+    return __find_start_tail(data, len, offset, offset, start_len);
+}
+#endif
 
 rtp_error_t uvgrtp::formats::h26x::push_h26x_frame(uint8_t *data, size_t data_len, int flags)
 {
@@ -2,6 +2,7 @@
 #else
 #endif
 
+#include <algorithm>
 #include <map>
 #include <unordered_map>
 
@@ -14,10 +15,15 @@ uvgrtp::formats::media::media(uvgrtp::socket *socket, uvgrtp::rtp *rtp_ctx, int
     socket_(socket), rtp_ctx_(rtp_ctx), flags_(flags), minfo_{}
 {
     fqueue_ = new uvgrtp::frame_queue(socket, rtp_ctx, flags);
+    minfo_.rtp_ctx = rtp_ctx;
 }
 
 uvgrtp::formats::media::~media()
 {
+    for (auto& f : minfo_.frames) {
+        for (auto& frag : f.second.fragments)
+            (void)uvgrtp::frame::dealloc_frame(frag);
+    }
 }
 
 rtp_error_t uvgrtp::formats::media::push_frame(uint8_t *data, size_t data_len, int flags)
@@ -92,6 +98,108 @@ uvgrtp::formats::media_frame_info_t *uvgrtp::formats::media::get_media_frame_inf
     return &minfo_;
 }
 
+uvgrtp::frame_queue *uvgrtp::formats::media::get_frame_queue()
+{
+    return fqueue_;
+}
+
+static bool __is_dropped(uvgrtp::formats::media_frame_info_t *minfo, uint32_t ts)
+{
+    for (size_t i = 0; i < minfo->dropped_num; ++i) {
+        if (minfo->dropped[i] == ts)
+            return true;
+    }
+
+    return false;
+}
+
+static bool __has_fragment(uvgrtp::formats::media_info_t& mframe, uint16_t seq)
+{
+    /* duplicates are usually retransmissions of recent fragments so search from the end */
+    for (auto it = mframe.fragments.rbegin(); it != mframe.fragments.rend(); ++it) {
+        if ((*it)->header.seq == seq)
+            return true;
+    }
+
+    return false;
+}
+
+static void __drop_frame(uvgrtp::formats::media_frame_info_t *minfo, uint32_t ts)
+{
+    auto& mframe = minfo->frames.at(ts);
+
+    LOG_DEBUG("Dropping partial generic frame, ts %u, %zu fragments received", ts, mframe.npkts);
+
+    for (auto& frag : mframe.fragments)
+        (void)uvgrtp::frame::dealloc_frame(frag);
+
+    minfo->frames.erase(ts);
+    minfo->lost++;
+    minfo->rtp_ctx->get_stats()->add_dropped_frame();
+
+    /* remember the timestamp so that stray fragments of the frame are discarded */
+    minfo->dropped[minfo->dropped_pos] = ts;
+    minfo->dropped_pos = (minfo->dropped_pos + 1) % uvgrtp::formats::GENERIC_DROPPED_MAX;
+
+    if (minfo->dropped_num < uvgrtp::formats::GENERIC_DROPPED_MAX)
+        minfo->dropped_num++;
+}
+
+/* Evict every partial frame that has exceeded its deadline. If the window is still
+ * full after that, evict the oldest frame to make room for a new one */
+static void __evict_frames(uvgrtp::formats::media_frame_info_t *minfo)
+{
+    size_t max_delay = minfo->rtp_ctx->get_pkt_max_delay();
+    auto now         = uvgrtp::clock::hrc::now();
+
+    for (auto it = minfo->frames.begin(); it != minfo->frames.end(); ) {
+        auto next = std::next(it);
+
+        if (uvgrtp::clock::hrc::diff(now, it->second.sframe_time) >= max_delay)
+            __drop_frame(minfo, it->first);
+
+        it = next;
+    }
+
+    if (minfo->frames.size() < uvgrtp::formats::GENERIC_FRAME_WINDOW)
+        return;
+
+    auto oldest = minfo->frames.begin();
+
+    for (auto it = minfo->frames.begin(); it != minfo->frames.end(); ++it) {
+        if (it->second.sframe_time < oldest->second.sframe_time)
+            oldest = it;
+    }
+
+    __drop_frame(minfo, oldest->first);
+}
+
+static uvgrtp::frame::rtp_frame *__assemble_frame(uvgrtp::formats::media_info_t& mframe)
+{
+    uint16_t s_seq = (uint16_t)mframe.s_seq;
+
+    /* Sort relative to the first fragment so that sequence number wrap-around
+     * inside a frame does not reorder the payload */
+    std::sort(mframe.fragments.begin(), mframe.fragments.end(),
+        [s_seq](uvgrtp::frame::rtp_frame *a, uvgrtp::frame::rtp_frame *b) {
+            return (uint16_t)(a->header.seq - s_seq) < (uint16_t)(b->header.seq - s_seq);
+        }
+    );
+
+    auto retframe = uvgrtp::frame::alloc_rtp_frame(mframe.size);
+    size_t ptr    = 0;
+
+    std::memcpy(&retframe->header, &mframe.fragments.back()->header, sizeof(retframe->header));
+
+    for (auto& frag : mframe.fragments) {
+        std::memcpy(retframe->payload + ptr, frag->payload, frag->payload_len);
+        ptr += frag->payload_len;
+        (void)uvgrtp::frame::dealloc_frame(frag);
+    }
+
+    return retframe;
+}
+
 rtp_error_t uvgrtp::formats::media::packet_handler(void *arg, int flags, uvgrtp::frame::rtp_frame **out)
 {
     auto minfo   = (uvgrtp::formats::media_frame_info_t *)arg;
@@ -105,51 +213,60 @@ rtp_error_t uvgrtp::formats::media::packet_handler(void *arg, int flags, uvgrtp:
     if (!(flags & RCE_FRAGMENT_GENERIC))
         return RTP_PKT_READY;
 
-    if (minfo->frames.find(ts) != minfo->frames.end()) {
-        minfo->frames[ts].npkts++;
-        minfo->frames[ts].fragments[seq] = frame;
-        minfo->frames[ts].size += frame->payload_len;
+    auto it = minfo->frames.find(ts);
+
+    if (it != minfo->frames.end()) {
+        auto& mframe = it->second;
+
+        if (__has_fragment(mframe, (uint16_t)seq)) {
+            LOG_DEBUG("Dropping duplicate fragment %u of generic frame %u", seq, ts);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            *out = nullptr;
+            return RTP_OK;
+        }
+
+        mframe.npkts++;
+        mframe.fragments.push_back(frame);
+        mframe.size += frame->payload_len;
         *out = nullptr;
 
         if (frame->header.marker)
-            minfo->frames[ts].e_seq = seq;
-
-        if (minfo->frames[ts].e_seq != INVALID_SEQ && minfo->frames[ts].s_seq != INVALID_SEQ) {
-            if (minfo->frames[ts].s_seq > minfo->frames[ts].e_seq)
-                recv = 0xffff - minfo->frames[ts].s_seq + minfo->frames[ts].e_seq + 2;
-            else
-                recv = minfo->frames[ts].e_seq - minfo->frames[ts].s_seq + 1;
-
-            if (recv == minfo->frames[ts].npkts) {
-                auto retframe = uvgrtp::frame::alloc_rtp_frame(minfo->frames[ts].size);
-                size_t ptr    = 0;
-
-                std::memcpy(&retframe->header, &frame->header, sizeof(frame->header));
-
-                for (auto& frag : minfo->frames[ts].fragments) {
-                    std::memcpy(
-                        retframe->payload + ptr,
-                        frag.second->payload,
-                        frag.second->payload_len
-                    );
-                    ptr += frag.second->payload_len;
-                    (void)uvgrtp::frame::dealloc_frame(frag.second);
-                }
-
-                minfo->frames.erase(ts);
-                (void)uvgrtp::frame::dealloc_frame(*out);
-                *out = retframe;
+            mframe.e_seq = seq;
+
+        if (mframe.e_seq != INVALID_SEQ && mframe.s_seq != INVALID_SEQ) {
+            recv = (uint16_t)(mframe.e_seq - mframe.s_seq) + 1;
+
+            if (recv == mframe.npkts) {
+                minfo->rtp_ctx->get_stats()->add_reassembly_time(uvgrtp::clock::hrc::diff_now_us(mframe.sframe_time));
+                *out = __assemble_frame(mframe);
+                minfo->frames.erase(it);
                 return RTP_PKT_READY;
             }
         }
+
+        if (uvgrtp::clock::hrc::diff_now(mframe.sframe_time) >= minfo->rtp_ctx->get_pkt_max_delay())
+            __drop_frame(minfo, ts);
     } else {
+        if (__is_dropped(minfo, ts)) {
+            LOG_DEBUG("Discarding fragment %u of dropped generic frame %u", seq, ts);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            *out = nullptr;
+            return RTP_OK;
+        }
+
         if (frame->header.marker) {
-            minfo->frames[ts].npkts          = 1;
-            minfo->frames[ts].s_seq          = seq;
-            minfo->frames[ts].e_seq          = INVALID_SEQ;
-            minfo->frames[ts].fragments[seq] = frame;
-            minfo->frames[ts].size           = frame->payload_len;
-            *out                             = nullptr;
+            __evict_frames(minfo);
+
+            auto& mframe = minfo->frames[ts];
+
+            mframe.sframe_time = uvgrtp::clock::hrc::now();
+            mframe.npkts       = 1;
+            mframe.s_seq       = seq;
+            mframe.e_seq       = INVALID_SEQ;
+            mframe.size        = frame->payload_len;
+            mframe.fragments.clear();
+            mframe.fragments.push_back(frame);
+            *out               = nullptr;
         } else {
             return RTP_PKT_READY;
         }
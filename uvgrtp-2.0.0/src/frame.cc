@@ -1,4 +1,5 @@
 #include <cstring>
+#include <new>
 
 #include "debug.hh"
 #include "frame.hh"
@@ -52,11 +53,34 @@ uvgrtp::frame::rtp_frame *uvgrtp::frame::alloc_rtp_frame(size_t payload_len, siz
     return frame;
 }
 
+uvgrtp::frame::rtp_frame *uvgrtp::frame::alloc_rtp_frame(uvgrtp::frame::dgram_buffer *buffer)
+{
+    if (!buffer) {
+        rtp_errno = RTP_INVALID_VALUE;
+        return nullptr;
+    }
+
+    uvgrtp::frame::rtp_frame *frame = &buffer->frame;
+
+    std::memset(frame, 0, sizeof(uvgrtp::frame::rtp_frame));
+
+    frame->dgram_buf = buffer;
+    uvgrtp::frame::dgram_pool::ref_buffer(buffer);
+
+    return frame;
+}
+
 rtp_error_t uvgrtp::frame::dealloc_frame(uvgrtp::frame::rtp_frame *frame)
 {
     if (!frame)
         return RTP_INVALID_VALUE;
 
+    /* CSRC list, extension header and payload of the frame point to the receive buffer */
+    if (frame->dgram_buf) {
+        uvgrtp::frame::dgram_pool::put_buffer(frame->dgram_buf);
+        return RTP_OK;
+    }
+
     if (frame->csrc)
         delete[] frame->csrc;
 
@@ -102,3 +126,103 @@ rtp_error_t uvgrtp::frame::dealloc_frame(uvgrtp::frame::zrtp_frame *frame)
     delete[] frame;
     return RTP_OK;
 }
+
+uvgrtp::frame::dgram_pool::dgram_pool(size_t dgram_size):
+    dgram_size_(dgram_size),
+    outstanding_(0),
+    released_(false)
+{
+}
+
+uvgrtp::frame::dgram_pool::~dgram_pool()
+{
+}
+
+uvgrtp::frame::dgram_buffer *uvgrtp::frame::dgram_pool::get_buffer()
+{
+    uvgrtp::frame::dgram_buffer *buffer = nullptr;
+
+    mtx_.lock();
+    outstanding_++;
+
+    if (!free_.empty()) {
+        buffer = free_.back();
+        free_.pop_back();
+    }
+    mtx_.unlock();
+
+    if (!buffer) {
+        uint8_t *mem = new uint8_t[sizeof(uvgrtp::frame::dgram_buffer) + dgram_size_];
+
+        buffer       = new (mem) uvgrtp::frame::dgram_buffer;
+        buffer->pool = this;
+    }
+
+    buffer->refs = 1;
+    return buffer;
+}
+
+void uvgrtp::frame::dgram_pool::release()
+{
+    mtx_.lock();
+
+    for (auto& buffer : free_) {
+        buffer->~dgram_buffer();
+        delete[] (uint8_t *)buffer;
+    }
+    free_.clear();
+
+    released_ = true;
+
+    if (outstanding_) {
+        mtx_.unlock();
+        return;
+    }
+    mtx_.unlock();
+
+    delete this;
+}
+
+void uvgrtp::frame::dgram_pool::return_buffer(uvgrtp::frame::dgram_buffer *buffer)
+{
+    mtx_.lock();
+
+    if (!released_) {
+        free_.push_back(buffer);
+        outstanding_--;
+        mtx_.unlock();
+        return;
+    }
+
+    buffer->~dgram_buffer();
+    delete[] (uint8_t *)buffer;
+
+    if (--outstanding_) {
+        mtx_.unlock();
+        return;
+    }
+    mtx_.unlock();
+
+    delete this;
+}
+
+void uvgrtp::frame::dgram_pool::ref_buffer(uvgrtp::frame::dgram_buffer *buffer)
+{
+    buffer->refs++;
+}
+
+void uvgrtp::frame::dgram_pool::put_buffer(uvgrtp::frame::dgram_buffer *buffer)
+{
+    if (--buffer->refs == 0)
+        buffer->pool->return_buffer(buffer);
+}
+
+uint8_t *uvgrtp::frame::dgram_pool::get_dgram(uvgrtp::frame::dgram_buffer *buffer)
+{
+    return (uint8_t *)buffer + sizeof(uvgrtp::frame::dgram_buffer);
+}
+
+uvgrtp::frame::dgram_buffer *uvgrtp::frame::dgram_pool::get_dgram_buffer(void *dgram)
+{
+    return (uvgrtp::frame::dgram_buffer *)((uint8_t *)dgram - sizeof(uvgrtp::frame::dgram_buffer));
+}
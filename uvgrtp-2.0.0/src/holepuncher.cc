@@ -4,8 +4,13 @@
 
 #define THRESHOLD 2000
 
+/* How often the reactor timer checks whether a keepalive is needed */
+#define INTERVAL  500
+
 uvgrtp::holepuncher::holepuncher(uvgrtp::socket *socket):
     socket_(socket),
+    reactor_(nullptr),
+    reactor_key_(0),
     last_dgram_sent_(0)
 {
 }
@@ -23,8 +28,23 @@ rtp_error_t uvgrtp::holepuncher::start()
     return uvgrtp::runner::start();
 }
 
+rtp_error_t uvgrtp::holepuncher::start(uvgrtp::reactor *reactor)
+{
+    reactor_ = reactor;
+
+    if (!(reactor_key_ = reactor_->add_timer(INTERVAL, reactor_handler, this)))
+        return RTP_GENERIC_ERROR;
+
+    return uvgrtp::runner::start();
+}
+
 rtp_error_t uvgrtp::holepuncher::stop()
 {
+    if (reactor_key_) {
+        (void)reactor_->remove(reactor_key_);
+        reactor_key_ = 0;
+    }
+
     return uvgrtp::runner::stop(); 
 }
 
@@ -33,16 +53,29 @@ void uvgrtp::holepuncher::notify()
     last_dgram_sent_ = uvgrtp::clock::ntp::now();
 }
 
+void uvgrtp::holepuncher::send_keepalive()
+{
+    uint8_t payload = 0x00;
+    socket_->sendto(&payload, 1, 0);
+    last_dgram_sent_ = uvgrtp::clock::ntp::now();
+}
+
+void uvgrtp::holepuncher::reactor_handler(void *arg)
+{
+    auto hp = (uvgrtp::holepuncher *)arg;
+
+    if (uvgrtp::clock::ntp::diff_now(hp->last_dgram_sent_) >= THRESHOLD)
+        hp->send_keepalive();
+}
+
 void uvgrtp::holepuncher::keepalive()
 {
     while (active()) {
         if (uvgrtp::clock::ntp::diff_now(last_dgram_sent_) < THRESHOLD) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            std::this_thread::sleep_for(std::chrono::milliseconds(INTERVAL));
             continue;
         }
 
-        uint8_t payload = 0x00;
-        socket_->sendto(&payload, 1, 0);
-        last_dgram_sent_ = uvgrtp::clock::ntp::now();
+        send_keepalive();
     }
 }
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <vector>
+
+#include "debug.hh"
+#include "jitter_buffer.hh"
+
+uvgrtp::jitter_buffer::jitter_buffer(uvgrtp::rtp *rtp, uvgrtp::rtcp *rtcp):
+    rtp_(rtp),
+    rtcp_(rtcp),
+    arg_(nullptr),
+    release_(nullptr),
+    init_(false),
+    ssrc_(0),
+    max_ts_(0),
+    released_ts_(LLONG_MIN),
+    base_transit_(0),
+    delay_(0)
+{
+}
+
+uvgrtp::jitter_buffer::~jitter_buffer()
+{
+    (void)stop();
+}
+
+rtp_error_t uvgrtp::jitter_buffer::start(void *arg, uvgrtp::jitter_release release)
+{
+    if (!release)
+        return RTP_INVALID_VALUE;
+
+    arg_     = arg;
+    release_ = release;
+    active_  = true;
+
+    if (!(runner_ = new std::thread(&uvgrtp::jitter_buffer::release_frames, this))) {
+        active_ = false;
+        return RTP_MEMORY_ERROR;
+    }
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::jitter_buffer::stop()
+{
+    mtx_.lock();
+    active_ = false;
+    mtx_.unlock();
+    cv_.notify_all();
+
+    if (runner_ && runner_->joinable())
+        runner_->join();
+
+    for (auto& pf : frames_)
+        (void)uvgrtp::frame::dealloc_frame(pf.frame);
+    frames_.clear();
+
+    return RTP_OK;
+}
+
+void uvgrtp::jitter_buffer::insert(uvgrtp::frame::rtp_frame *frame)
+{
+    auto now        = uvgrtp::clock::hrc::now();
+    double rate     = rtp_->get_clock_rate();
+    double min      = rtp_->get_playout_delay_min() * 1000.0;
+    double max      = rtp_->get_playout_delay_max() * 1000.0;
+    uint64_t jitter = rtcp_ ? rtcp_->get_jitter_us(frame->header.ssrc) : 0;
+
+    std::vector<uvgrtp::frame::rtp_frame *> stale;
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    if (!init_ || frame->header.ssrc != ssrc_) {
+        /* new source, whatever is left of the previous one is played out immediately */
+        for (auto& pf : frames_)
+            stale.push_back(pf.frame);
+        frames_.clear();
+
+        init_         = true;
+        ssrc_         = frame->header.ssrc;
+        epoch_        = now;
+        max_ts_       = frame->header.timestamp;
+        released_ts_  = LLONG_MIN;
+        base_transit_ = -(max_ts_ * 1000000.0 / rate);
+        delay_        = min;
+    }
+
+    /* extend the timestamp relative to the largest one so that wrap-around keeps the order */
+    int64_t ts = max_ts_ + (int32_t)(frame->header.timestamp - (uint32_t)max_ts_);
+    max_ts_    = std::max(max_ts_, ts);
+
+    if (ts < released_ts_) {
+        LOG_DEBUG("Frame arrived after a newer frame was played out, dropping it");
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        rtp_->get_stats()->add_dropped_frame();
+        return;
+    }
+
+    double arrival = (double)std::chrono::duration_cast<std::chrono::microseconds>(now - epoch_).count();
+    double ts_us   = ts * 1000000.0 / rate;
+    double transit = arrival - ts_us;
+
+    /* The base transit is the fastest delivery seen. It is raised slowly towards
+     * the current transit so that a sender clock running slower than ours does
+     * not make the frames late forever */
+    if (transit < base_transit_)
+        base_transit_ = transit;
+    else
+        base_transit_ += (transit - base_transit_) / 4096;
+
+    delay_ += (std::min(std::max((double)JITTER_MULTIPLIER * jitter, min), max) - delay_) / 16;
+
+    int64_t playout = (int64_t)std::min(ts_us + base_transit_ + delay_, arrival + max);
+
+    auto it = frames_.end();
+
+    while (it != frames_.begin() && std::prev(it)->ts > ts)
+        --it;
+
+    bool head = (it == frames_.begin());
+    frames_.insert(it, { ts, playout, frame });
+
+    lock.unlock();
+
+    for (auto& stale_frame : stale)
+        release_(arg_, stale_frame);
+
+    if (head)
+        cv_.notify_one();
+}
+
+void uvgrtp::jitter_buffer::release_frames()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    while (active_) {
+        if (frames_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+
+        auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+            uvgrtp::clock::hrc::now() - epoch_
+        ).count();
+
+        if (frames_.front().playout > now) {
+            cv_.wait_for(lock, std::chrono::microseconds(frames_.front().playout - now));
+            continue;
+        }
+
+        auto frame   = frames_.front().frame;
+        released_ts_ = frames_.front().ts;
+        frames_.pop_front();
+
+        lock.unlock();
+        release_(arg_, frame);
+        lock.lock();
+    }
+}
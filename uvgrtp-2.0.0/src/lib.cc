@@ -11,7 +11,8 @@ thread_local rtp_error_t rtp_errno;
 
 uvgrtp::context::context()
 {
-    cname_  = uvgrtp::context::generate_cname();
+    cname_   = uvgrtp::context::generate_cname();
+    reactor_ = new uvgrtp::reactor();
 
 #ifdef _WIN32
     WSADATA wsd;
@@ -26,6 +27,8 @@ uvgrtp::context::context()
 
 uvgrtp::context::~context()
 {
+    delete reactor_;
+
 #ifdef _WIN32
     WSACleanup();
 #endif
@@ -36,7 +39,7 @@ uvgrtp::session *uvgrtp::context::create_session(std::string address)
     if (address == "")
         return nullptr;
 
-    return new uvgrtp::session(address);
+    return new uvgrtp::session(address, reactor_);
 }
 
 uvgrtp::session *uvgrtp::context::create_session(std::string remote_addr, std::string local_addr)
@@ -44,7 +47,7 @@ uvgrtp::session *uvgrtp::context::create_session(std::string remote_addr, std::s
     if (remote_addr == "" || local_addr == "")
         return nullptr;
 
-    return new uvgrtp::session(remote_addr, local_addr);
+    return new uvgrtp::session(remote_addr, local_addr, reactor_);
 }
 
 rtp_error_t uvgrtp::context::destroy_session(uvgrtp::session *session)
@@ -1,4 +1,5 @@
 #include <cstring>
+#include <ctime>
 #include <errno.h>
 
 #include "debug.hh"
@@ -23,7 +24,13 @@ uvgrtp::media_stream::media_stream(std::string addr, int src_port, int dst_port,
     rtp_handler_key_(0),
     pkt_dispatcher_(nullptr),
     media_(nullptr),
-    holepuncher_(nullptr)
+    holepuncher_(nullptr),
+    fec_(nullptr),
+    jitter_buffer_(nullptr),
+    multicast_(nullptr),
+    mcast_groups_(0),
+    mcast_loopback_(true),
+    reactor_(nullptr)
 {
     fmt_      = fmt;
     addr_     = addr;
@@ -56,6 +63,9 @@ uvgrtp::media_stream::~media_stream()
     if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE)
         holepuncher_->stop();
 
+    if (ctx_config_.flags & RCE_JITTER_BUFFER)
+        jitter_buffer_->stop();
+
     (void)free_resources(RTP_OK);
 }
 
@@ -63,12 +73,47 @@ rtp_error_t uvgrtp::media_stream::init_connection()
 {
     rtp_error_t ret = RTP_OK;
 
+    /* Use an IPv6 socket if either address is IPv6, it handles IPv4 addresses as IPv4-mapped */
+    short family = uvgrtp::socket::get_family(addr_);
+
+    if (laddr_ != "" && uvgrtp::socket::get_family(laddr_) == AF_INET6)
+        family = AF_INET6;
+
     if (!(socket_ = new uvgrtp::socket(ctx_config_.flags)))
         return ret;
 
-    if ((ret = socket_->init(AF_INET, SOCK_DGRAM, 0)) != RTP_OK)
+    if ((ret = socket_->init(family, SOCK_DGRAM, 0)) != RTP_OK)
         return ret;
 
+#ifdef __linux__
+    /* Without kernel timestamps the arrival times and the jitter include the dispatcher's wakeup latency */
+    (void)socket_->enable_rx_timestamps();
+#endif
+
+    if (ctx_config_.flags & RCE_TXTIME) {
+#ifdef __linux__
+        if ((ret = socket_->enable_txtime(CLOCK_MONOTONIC)) != RTP_OK)
+            return ret;
+#else
+        LOG_ERROR("RCE_TXTIME is supported only on Linux");
+        return RTP_NOT_SUPPORTED;
+#endif
+    }
+
+    if (!(multicast_ = new uvgrtp::multicast(socket_, family)))
+        return RTP_MEMORY_ERROR;
+
+    /* Several receivers of a multicast group can run on the same host. The local address
+     * only selects the interface of the group, binding to it would filter out the group traffic */
+    bool group = uvgrtp::multicast::is_multicast(addr_);
+
+    if (group) {
+        int enable = 1;
+
+        if ((ret = socket_->setsockopt(SOL_SOCKET, SO_REUSEADDR, (const char *)&enable, sizeof(int))) != RTP_OK)
+            return ret;
+    }
+
 #ifdef _WIN32
     /* Make the socket non-blocking */
     int enabled = 1;
@@ -77,16 +122,19 @@ rtp_error_t uvgrtp::media_stream::init_connection()
         LOG_ERROR("Failed to make the socket non-blocking!");
 #endif
 
-    if (laddr_ != "") {
-        sockaddr_in bind_addr = socket_->create_sockaddr(AF_INET, laddr_, src_port_);
-        socket_t socket       = socket_->get_raw_socket();
+    if (laddr_ != "" && !group) {
+        sockaddr_storage bind_addr = socket_->create_sockaddr(family, laddr_, src_port_);
+        socket_t socket            = socket_->get_raw_socket();
 
-        if (bind(socket, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) == -1) {
+        if (bind_addr.ss_family == AF_UNSPEC)
+            return RTP_INVALID_VALUE;
+
+        if (bind(socket, (struct sockaddr *)&bind_addr, uvgrtp::socket::get_sockaddr_len(bind_addr)) == -1) {
             log_platform_error("bind(2) failed");
             return RTP_BIND_ERROR;
         }
     } else {
-        if ((ret = socket_->bind(AF_INET, INADDR_ANY, src_port_)) != RTP_OK)
+        if ((ret = socket_->bind(family, INADDR_ANY, src_port_)) != RTP_OK)
             return ret;
     }
 
@@ -100,9 +148,23 @@ rtp_error_t uvgrtp::media_stream::init_connection()
     if ((ret = socket_->setsockopt(SOL_SOCKET, SO_RCVBUF, (const char *)&buf_size, sizeof(int))) != RTP_OK)
         return ret;
 
-    addr_out_ = socket_->create_sockaddr(AF_INET, addr_, dst_port_);
+    addr_out_ = socket_->create_sockaddr(family, addr_, dst_port_);
+
+    if (addr_out_.ss_family == AF_UNSPEC)
+        return RTP_INVALID_VALUE;
+
     socket_->set_sockaddr(addr_out_);
 
+    if (group) {
+        if (laddr_ != "" && (ret = multicast_->set_interface(laddr_)) != RTP_OK)
+            return ret;
+
+        if ((ret = multicast_->join(addr_, laddr_)) != RTP_OK)
+            return ret;
+
+        ++mcast_groups_;
+    }
+
     return ret;
 }
 
@@ -172,12 +234,78 @@ rtp_error_t uvgrtp::media_stream::free_resources(rtp_error_t ret)
     delete rtp_;
     delete srtp_;
     delete srtcp_;
+    delete jitter_buffer_;
+    delete multicast_;
     delete pkt_dispatcher_;
     delete holepuncher_;
+    delete fec_;
     delete media_;
     return ret;
 }
 
+void uvgrtp::media_stream::set_reactor(uvgrtp::reactor *reactor)
+{
+    reactor_ = reactor;
+}
+
+rtp_error_t uvgrtp::media_stream::start_components()
+{
+    rtp_error_t ret;
+
+    /* MAX_PAYLOAD leaves room for an IPv4 header, the IPv6 header is larger.
+     * The parity packets of RCE_FEC carry a FEC header in addition to the largest payload */
+    size_t overhead = uvgrtp::base_srtp::get_tag_length(ctx_config_.flags);
+
+    if (addr_out_.ss_family == AF_INET6)
+        overhead += IPV6_HDR_SIZE - IPV4_HDR_SIZE;
+
+    if (ctx_config_.flags & RCE_FEC)
+        overhead += uvgrtp::FEC_HDR_SIZE;
+
+    rtp_->set_payload_size(MAX_PAYLOAD - overhead);
+
+    socket_->set_stats(rtp_->get_stats());
+    pkt_dispatcher_->set_stats(rtp_->get_stats());
+
+    /* Without RCE_SHARED_REACTOR each component runs on its own thread */
+    uvgrtp::reactor *reactor = (ctx_config_.flags & RCE_SHARED_REACTOR) ? reactor_ : nullptr;
+
+    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE) {
+        if (!(holepuncher_ = new uvgrtp::holepuncher(socket_)))
+            return free_resources(RTP_MEMORY_ERROR);
+
+        if (!reactor || holepuncher_->start(reactor) != RTP_OK)
+            holepuncher_->start();
+    }
+
+    if (ctx_config_.flags & RCE_RTCP) {
+        rtcp_->add_participant(addr_, src_port_ + 1, dst_port_ + 1, rtp_->get_clock_rate());
+
+        if (ctx_config_.flags & RCE_RTCP_NACK)
+            rtcp_->install_nack_hook(media_->get_frame_queue(), uvgrtp::frame_queue::nack_hook);
+
+        if (!reactor || rtcp_->start(reactor) != RTP_OK)
+            rtcp_->start();
+    }
+
+    if (ctx_config_.flags & RCE_JITTER_BUFFER) {
+        if (!(jitter_buffer_ = new uvgrtp::jitter_buffer(rtp_, rtcp_)))
+            return free_resources(RTP_MEMORY_ERROR);
+
+        if ((ret = pkt_dispatcher_->install_jitter_buffer(jitter_buffer_)) != RTP_OK)
+            return free_resources(ret);
+    }
+
+    if (reactor) {
+        if ((ret = pkt_dispatcher_->start(socket_, ctx_config_.flags, reactor)) == RTP_OK)
+            return ret;
+
+        LOG_WARN("Failed to use the shared reactor, starting packet dispatcher thread");
+    }
+
+    return pkt_dispatcher_->start(socket_, ctx_config_.flags);
+}
+
 rtp_error_t uvgrtp::media_stream::init()
 {
     if (init_connection() != RTP_OK) {
@@ -197,24 +325,26 @@ rtp_error_t uvgrtp::media_stream::init()
     socket_->install_handler(rtcp_, rtcp_->send_packet_handler_vec);
 
     rtp_handler_key_ = pkt_dispatcher_->install_handler(rtp_->packet_handler);
-    pkt_dispatcher_->install_aux_handler(rtp_handler_key_, rtcp_, rtcp_->recv_packet_handler, nullptr);
+    pkt_dispatcher_->install_aux_handler(rtp_handler_key_, rtp_, rtp_->recv_packet_handler, nullptr);
+    update_own_ssrc_filter();
 
-    if (create_media(fmt_) != RTP_OK)
-        return free_resources(RTP_MEMORY_ERROR);
-
-    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE) {
-        if (!(holepuncher_ = new uvgrtp::holepuncher(socket_)))
+    if (ctx_config_.flags & RCE_FEC) {
+        if (!(fec_ = new uvgrtp::fec(rtp_)))
             return free_resources(RTP_MEMORY_ERROR);
-        holepuncher_->start();
-    }
 
-    if (ctx_config_.flags & RCE_RTCP) {
-        rtcp_->add_participant(addr_, src_port_ + 1, dst_port_ + 1, rtp_->get_clock_rate());
-        rtcp_->start();
+        pkt_dispatcher_->install_aux_handler(rtp_handler_key_, fec_, fec_->packet_handler, nullptr);
     }
 
+    pkt_dispatcher_->install_aux_handler(rtp_handler_key_, rtcp_, rtcp_->recv_packet_handler, nullptr);
+
+    if (fec_)
+        pkt_dispatcher_->install_aux_handler(rtp_handler_key_, fec_, fec_->history_handler, nullptr);
+
+    if (create_media(fmt_) != RTP_OK)
+        return free_resources(RTP_MEMORY_ERROR);
+
     initialized_ = true;
-    return pkt_dispatcher_->start(socket_, ctx_config_.flags);
+    return start_components();
 }
 
 rtp_error_t uvgrtp::media_stream::init(uvgrtp::zrtp *zrtp)
@@ -262,28 +392,27 @@ rtp_error_t uvgrtp::media_stream::init(uvgrtp::zrtp *zrtp)
     rtp_handler_key_  = pkt_dispatcher_->install_handler(rtp_->packet_handler);
     zrtp_handler_key_ = pkt_dispatcher_->install_handler(zrtp->packet_handler);
 
-    pkt_dispatcher_->install_aux_handler(rtp_handler_key_, rtcp_, rtcp_->recv_packet_handler, nullptr);
-    pkt_dispatcher_->install_aux_handler(rtp_handler_key_, srtp_, srtp_->recv_packet_handler, nullptr);
-
-    if (create_media(fmt_) != RTP_OK)
-        return free_resources(RTP_MEMORY_ERROR);
+    pkt_dispatcher_->install_aux_handler(rtp_handler_key_, rtp_, rtp_->recv_packet_handler, nullptr);
+    update_own_ssrc_filter();
 
-    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE) {
-        if (!(holepuncher_ = new uvgrtp::holepuncher(socket_)))
+    if (ctx_config_.flags & RCE_FEC) {
+        if (!(fec_ = new uvgrtp::fec(rtp_)))
             return free_resources(RTP_MEMORY_ERROR);
-        holepuncher_->start();
-    }
 
-    if (ctx_config_.flags & RCE_RTCP) {
-        rtcp_->add_participant(addr_, src_port_ + 1, dst_port_ + 1, rtp_->get_clock_rate());
-        rtcp_->start();
+        pkt_dispatcher_->install_aux_handler(rtp_handler_key_, fec_, fec_->packet_handler, nullptr);
     }
 
-    if (ctx_config_.flags & RCE_SRTP_AUTHENTICATE_RTP)
-        rtp_->set_payload_size(MAX_PAYLOAD - AUTH_TAG_LENGTH);
+    pkt_dispatcher_->install_aux_handler(rtp_handler_key_, rtcp_, rtcp_->recv_packet_handler, nullptr);
+    pkt_dispatcher_->install_aux_handler(rtp_handler_key_, srtp_, srtp_->recv_packet_handler, nullptr);
+
+    if (fec_)
+        pkt_dispatcher_->install_aux_handler(rtp_handler_key_, fec_, fec_->history_handler, nullptr);
+
+    if (create_media(fmt_) != RTP_OK)
+        return free_resources(RTP_MEMORY_ERROR);
 
     initialized_ = true;
-    return pkt_dispatcher_->start(socket_, ctx_config_.flags);
+    return start_components();
 }
 
 rtp_error_t uvgrtp::media_stream::add_srtp_ctx(uint8_t *key, uint8_t *salt)
@@ -331,29 +460,27 @@ rtp_error_t uvgrtp::media_stream::add_srtp_ctx(uint8_t *key, uint8_t *salt)
     socket_->install_handler(srtp_, srtp_->send_packet_handler);
 
     rtp_handler_key_ = pkt_dispatcher_->install_handler(rtp_->packet_handler);
+    pkt_dispatcher_->install_aux_handler(rtp_handler_key_, rtp_, rtp_->recv_packet_handler, nullptr);
+    update_own_ssrc_filter();
+
+    if (ctx_config_.flags & RCE_FEC) {
+        if (!(fec_ = new uvgrtp::fec(rtp_)))
+            return free_resources(RTP_MEMORY_ERROR);
+
+        pkt_dispatcher_->install_aux_handler(rtp_handler_key_, fec_, fec_->packet_handler, nullptr);
+    }
 
     pkt_dispatcher_->install_aux_handler(rtp_handler_key_, rtcp_, rtcp_->recv_packet_handler, nullptr);
     pkt_dispatcher_->install_aux_handler(rtp_handler_key_, srtp_, srtp_->recv_packet_handler, nullptr);
 
+    if (fec_)
+        pkt_dispatcher_->install_aux_handler(rtp_handler_key_, fec_, fec_->history_handler, nullptr);
+
     if (create_media(fmt_) != RTP_OK)
         return free_resources(RTP_MEMORY_ERROR);
 
-    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE) {
-        if (!(holepuncher_ = new uvgrtp::holepuncher(socket_)))
-            return free_resources(RTP_MEMORY_ERROR);
-        holepuncher_->start();
-    }
-
-    if (ctx_config_.flags & RCE_RTCP) {
-        rtcp_->add_participant(addr_, src_port_ + 1, dst_port_ + 1, rtp_->get_clock_rate());
-        rtcp_->start();
-    }
-
-    if (ctx_config_.flags & RCE_SRTP_AUTHENTICATE_RTP)
-        rtp_->set_payload_size(MAX_PAYLOAD - AUTH_TAG_LENGTH);
-
     initialized_ = true;
-    return pkt_dispatcher_->start(socket_, ctx_config_.flags);
+    return start_components();
 }
 
 rtp_error_t uvgrtp::media_stream::push_frame(uint8_t *data, size_t data_len, int flags)
@@ -420,6 +547,58 @@ rtp_error_t uvgrtp::media_stream::push_frame(std::unique_ptr<uint8_t[]> data, si
     return ret;
 }
 
+rtp_error_t uvgrtp::media_stream::push_frame(uint8_t *data, size_t data_len, uint32_t ts, uint64_t launch_time, int flags)
+{
+    rtp_error_t ret = RTP_GENERIC_ERROR;
+
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!(ctx_config_.flags & RCE_TXTIME)) {
+        LOG_ERROR("Launch time requires RCE_TXTIME");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE)
+        holepuncher_->notify();
+
+    rtp_->set_timestamp(ts);
+    rtp_->set_launch_time(launch_time);
+    ret = media_->push_frame(data, data_len, flags);
+    rtp_->set_launch_time(0);
+    rtp_->set_timestamp(INVALID_TS);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::push_frame(std::unique_ptr<uint8_t[]> data, size_t data_len, uint32_t ts, uint64_t launch_time, int flags)
+{
+    rtp_error_t ret = RTP_GENERIC_ERROR;
+
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!(ctx_config_.flags & RCE_TXTIME)) {
+        LOG_ERROR("Launch time requires RCE_TXTIME");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE)
+        holepuncher_->notify();
+
+    rtp_->set_timestamp(ts);
+    rtp_->set_launch_time(launch_time);
+    ret = media_->push_frame(std::move(data), data_len, flags);
+    rtp_->set_launch_time(0);
+    rtp_->set_timestamp(INVALID_TS);
+
+    return ret;
+}
+
 uvgrtp::frame::rtp_frame *uvgrtp::media_stream::pull_frame()
 {
     if (!initialized_) {
@@ -546,10 +725,14 @@ rtp_error_t uvgrtp::media_stream::configure_ctx(int flag, ssize_t value)
         break;
 
         case RCC_MTU_SIZE: {
-            size_t hdr = ETH_HDR_SIZE + IPV4_HDR_SIZE + UDP_HDR_SIZE + RTP_HDR_SIZE;
+            size_t hdr = ETH_HDR_SIZE + UDP_HDR_SIZE + RTP_HDR_SIZE;
 
-            if (ctx_config_.flags & RCE_SRTP_AUTHENTICATE_RTP)
-                hdr += AUTH_TAG_LENGTH;
+            hdr += (addr_out_.ss_family == AF_INET6) ? IPV6_HDR_SIZE : IPV4_HDR_SIZE;
+
+            hdr += uvgrtp::base_srtp::get_tag_length(ctx_config_.flags);
+
+            if (ctx_config_.flags & RCE_FEC)
+                hdr += uvgrtp::FEC_HDR_SIZE;
 
             if (value <= hdr)
                 return RTP_INVALID_VALUE;
@@ -558,6 +741,103 @@ rtp_error_t uvgrtp::media_stream::configure_ctx(int flag, ssize_t value)
         }
         break;
 
+        case RCC_PACE_BITRATE: {
+            if (value < 0)
+                return RTP_INVALID_VALUE;
+
+            rtp_->set_pace_rate(value);
+        }
+        break;
+
+        case RCC_PACE_BURST: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            rtp_->set_pace_burst(value);
+        }
+        break;
+
+        case RCC_RTX_PAYLOAD_TYPE: {
+            if (value != 0 && (value < 96 || value > 127))
+                return RTP_INVALID_VALUE;
+
+            if (value && (ctx_config_.flags & RCE_SRTP)) {
+                LOG_WARN("RTX cannot be used with SRTP, the original packets are resent");
+                return RTP_NOT_SUPPORTED;
+            }
+
+            rtp_->set_rtx_payload(value);
+        }
+        break;
+
+        case RCC_FEC_GROUP_SIZE: {
+            if (value <= 0 || value > MAX_MSG_COUNT)
+                return RTP_INVALID_VALUE;
+
+            rtp_->set_fec_group_size(value);
+        }
+        break;
+
+        case RCC_FEC_PAYLOAD_TYPE: {
+            if (value < 96 || value > 127)
+                return RTP_INVALID_VALUE;
+
+            rtp_->set_fec_payload(value);
+        }
+        break;
+
+        case RCC_PLAYOUT_DELAY_MIN: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            rtp_->set_playout_delay_min(value);
+        }
+        break;
+
+        case RCC_PLAYOUT_DELAY_MAX: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            rtp_->set_playout_delay_max(value);
+        }
+        break;
+
+        case RCC_MULTICAST_TTL: {
+            if (value < 0 || value > 255)
+                return RTP_INVALID_VALUE;
+
+            if ((ret = multicast_->set_ttl((int)value)) != RTP_OK)
+                return ret;
+
+            if (ctx_config_.flags & RCE_RTCP)
+                ret = rtcp_->set_multicast_ttl((int)value);
+        }
+        break;
+
+        case RCC_MULTICAST_LOOPBACK: {
+            if ((ret = multicast_->set_loopback(!!value)) != RTP_OK)
+                return ret;
+
+            mcast_loopback_ = !!value;
+            update_own_ssrc_filter();
+
+            if (ctx_config_.flags & RCE_RTCP)
+                ret = rtcp_->set_multicast_loopback(!!value);
+        }
+        break;
+
+        case RCC_TXTIME_CLOCK: {
+            if (!(ctx_config_.flags & RCE_TXTIME) || value < 0)
+                return RTP_INVALID_VALUE;
+
+#ifdef __linux__
+            ret = socket_->enable_txtime((int)value);
+#else
+            ret = RTP_NOT_SUPPORTED;
+#endif
+        }
+        break;
+
         default:
             return RTP_INVALID_VALUE;
     }
@@ -570,6 +850,56 @@ uint32_t uvgrtp::media_stream::get_key()
     return key_;
 }
 
+rtp_error_t uvgrtp::media_stream::join_multicast(std::string group)
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    rtp_error_t ret = multicast_->join(group, laddr_);
+
+    if (ret == RTP_OK) {
+        ++mcast_groups_;
+        update_own_ssrc_filter();
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::leave_multicast(std::string group)
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    rtp_error_t ret = multicast_->leave(group, laddr_);
+
+    if (ret == RTP_OK) {
+        --mcast_groups_;
+        update_own_ssrc_filter();
+    }
+
+    return ret;
+}
+
+void uvgrtp::media_stream::update_own_ssrc_filter()
+{
+    rtp_->set_own_ssrc_filter(mcast_groups_ > 0 && mcast_loopback_);
+}
+
+rtp_error_t uvgrtp::media_stream::get_stats(uvgrtp::stream_stats& stats)
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    rtp_->get_stats()->snapshot(stats);
+    return RTP_OK;
+}
+
 uvgrtp::rtcp *uvgrtp::media_stream::get_rtcp()
 {
     return rtcp_;
@@ -1,41 +1,161 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+
+#include <cstring>
+
+#include "debug.hh"
 #include "multicast.hh"
 
-uvgrtp::multicast::multicast()
+uvgrtp::multicast::multicast(uvgrtp::socket *socket, short family):
+    socket_(socket),
+    family_(family)
 {
 }
 
 uvgrtp::multicast::~multicast()
 {
+    /* the memberships are dropped when the socket is closed */
 }
 
-rtp_error_t uvgrtp::multicast::join_multicast(uvgrtp::connection *conn)
+bool uvgrtp::multicast::is_multicast(const sockaddr_storage& addr)
 {
-    (void)conn;
+    if (addr.ss_family == AF_INET6) {
+        auto addr6 = (const sockaddr_in6 *)&addr;
 
-    return RTP_OK;
+        /* an IPv4-mapped group is still a group */
+        if (IN6_IS_ADDR_V4MAPPED(&addr6->sin6_addr))
+            return (addr6->sin6_addr.s6_addr[12] & 0xf0) == 0xe0;
+
+        return addr6->sin6_addr.s6_addr[0] == 0xff;
+    }
+
+    return (ntohl(((const sockaddr_in *)&addr)->sin_addr.s_addr) & 0xf0000000) == 0xe0000000;
 }
 
-rtp_error_t uvgrtp::multicast::leave_multicast(uvgrtp::connection *conn)
+bool uvgrtp::multicast::is_multicast(std::string addr)
 {
-    (void)conn;
+    if (addr == "")
+        return false;
 
-    return RTP_OK;
+    short family = uvgrtp::socket::get_family(addr);
+
+    return is_multicast(uvgrtp::socket::create_sockaddr(family, addr, 0));
 }
 
-rtp_error_t uvgrtp::multicast::push_frame_multicast(
-    uvgrtp::connection *sender,
-    uint8_t *data, uint32_t data_len,
-    rtp_format_t fmt, uint32_t timestamp
-)
+rtp_error_t uvgrtp::multicast::membership(std::string group, std::string iface, bool join)
 {
-    (void)sender, (void)data, (void)data_len, (void)fmt, (void)timestamp;
+    if (!is_multicast(group)) {
+        LOG_ERROR("%s is not a multicast address", group.c_str());
+        return RTP_INVALID_VALUE;
+    }
+
+    int ret;
+
+    if (uvgrtp::socket::get_family(group) == AF_INET6) {
+        sockaddr_storage addr = socket_->create_sockaddr(AF_INET6, group, 0);
+        struct ipv6_mreq mreq;
+
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.ipv6mr_multiaddr = ((sockaddr_in6 *)&addr)->sin6_addr;
+
+        if (iface != "") {
+            sockaddr_storage local = socket_->create_sockaddr(AF_INET6, iface, 0);
+
+            if (local.ss_family == AF_UNSPEC)
+                return RTP_INVALID_VALUE;
+
+            mreq.ipv6mr_interface = ((sockaddr_in6 *)&local)->sin6_scope_id;
+        }
+
+        ret = ::setsockopt(socket_->get_raw_socket(), IPPROTO_IPV6, join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP,
+                (const char *)&mreq, sizeof(mreq));
+    } else {
+        sockaddr_storage addr = socket_->create_sockaddr(AF_INET, group, 0);
+        struct ip_mreq mreq;
+
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.imr_multiaddr        = ((sockaddr_in *)&addr)->sin_addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+
+        if (iface != "") {
+            sockaddr_storage local = socket_->create_sockaddr(AF_INET, iface, 0);
+            mreq.imr_interface     = ((sockaddr_in *)&local)->sin_addr;
+        }
+
+        ret = ::setsockopt(socket_->get_raw_socket(), IPPROTO_IP, join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP,
+                (const char *)&mreq, sizeof(mreq));
+    }
+
+    if (ret < 0) {
+        log_platform_error(join ? "Failed to join multicast group" : "Failed to leave multicast group");
+        return RTP_GENERIC_ERROR;
+    }
 
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::multicast::push_frame_multicast(uvgrtp::connection *sender, uvgrtp::frame::rtp_frame *frame)
+rtp_error_t uvgrtp::multicast::join(std::string group, std::string iface)
 {
-    (void)sender, (void)frame;
+#ifdef __linux__
+    /* By default Linux delivers the traffic of every group joined by any socket
+     * of the host to all sockets bound to the port, receive only our own groups */
+    int all = 0;
 
-    return RTP_OK;
+    if (family_ == AF_INET6) {
+#ifdef IPV6_MULTICAST_ALL
+        (void)::setsockopt(socket_->get_raw_socket(), IPPROTO_IPV6, IPV6_MULTICAST_ALL, &all, sizeof(all));
+#endif
+    } else {
+        (void)::setsockopt(socket_->get_raw_socket(), IPPROTO_IP, IP_MULTICAST_ALL, &all, sizeof(all));
+    }
+#endif
+
+    return membership(group, iface, true);
+}
+
+rtp_error_t uvgrtp::multicast::leave(std::string group, std::string iface)
+{
+    return membership(group, iface, false);
+}
+
+rtp_error_t uvgrtp::multicast::set_ttl(int ttl)
+{
+    if (ttl < 0 || ttl > 255)
+        return RTP_INVALID_VALUE;
+
+    if (family_ == AF_INET6)
+        return socket_->setsockopt(IPPROTO_IPV6, IPV6_MULTICAST_HOPS, (const char *)&ttl, sizeof(ttl));
+
+    return socket_->setsockopt(IPPROTO_IP, IP_MULTICAST_TTL, (const char *)&ttl, sizeof(ttl));
+}
+
+rtp_error_t uvgrtp::multicast::set_loopback(bool enable)
+{
+    int loop = enable ? 1 : 0;
+
+    if (family_ == AF_INET6)
+        return socket_->setsockopt(IPPROTO_IPV6, IPV6_MULTICAST_LOOP, (const char *)&loop, sizeof(loop));
+
+    return socket_->setsockopt(IPPROTO_IP, IP_MULTICAST_LOOP, (const char *)&loop, sizeof(loop));
+}
+
+rtp_error_t uvgrtp::multicast::set_interface(std::string iface)
+{
+    if (uvgrtp::socket::get_family(iface) == AF_INET6) {
+        sockaddr_storage local = socket_->create_sockaddr(AF_INET6, iface, 0);
+
+        if (local.ss_family == AF_UNSPEC)
+            return RTP_INVALID_VALUE;
+
+        unsigned int index = ((sockaddr_in6 *)&local)->sin6_scope_id;
+
+        return socket_->setsockopt(IPPROTO_IPV6, IPV6_MULTICAST_IF, (const char *)&index, sizeof(index));
+    }
+
+    sockaddr_storage local = socket_->create_sockaddr(AF_INET, iface, 0);
+
+    return socket_->setsockopt(IPPROTO_IP, IP_MULTICAST_IF,
+            (const char *)&((sockaddr_in *)&local)->sin_addr, sizeof(in_addr));
 }
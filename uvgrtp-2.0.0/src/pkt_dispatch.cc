@@ -7,18 +7,52 @@
 #include <cstring>
 
 #include "debug.hh"
+#include "jitter_buffer.hh"
 #include "pkt_dispatch.hh"
 #include "random.hh"
 #include "util.hh"
 
 uvgrtp::pkt_dispatcher::pkt_dispatcher():
+    arrival_(0),
+    reactor_(nullptr),
+    reactor_key_(0),
+    socket_(nullptr),
+    flags_(0),
     recv_hook_arg_(nullptr),
-    recv_hook_(nullptr)
+    recv_hook_(nullptr),
+    jitter_(nullptr),
+    stats_(nullptr)
 {
+    pool_ = new uvgrtp::frame::dgram_pool(RECV_SLOT_SIZE);
+
+    for (int i = 0; i < RECV_BATCH_SIZE; ++i)
+        recv_bufs_[i] = pool_->get_buffer();
+
+#ifdef __linux__
+    std::memset(recv_hdrs_, 0, sizeof(recv_hdrs_));
+
+    for (int i = 0; i < RECV_BATCH_SIZE; ++i) {
+        recv_iovs_[i].iov_base = uvgrtp::frame::dgram_pool::get_dgram(recv_bufs_[i]);
+        recv_iovs_[i].iov_len  = RECV_SLOT_SIZE;
+
+        recv_hdrs_[i].msg_hdr.msg_iov        = &recv_iovs_[i];
+        recv_hdrs_[i].msg_hdr.msg_iovlen     = 1;
+        recv_hdrs_[i].msg_hdr.msg_control    = recv_ctrl_[i];
+        recv_hdrs_[i].msg_hdr.msg_controllen = RECV_CTRL_SIZE;
+    }
+#endif
 }
 
 uvgrtp::pkt_dispatcher::~pkt_dispatcher()
 {
+    for (auto& qf : frames_)
+        (void)uvgrtp::frame::dealloc_frame(qf.frame);
+
+    for (int i = 0; i < RECV_BATCH_SIZE; ++i)
+        uvgrtp::frame::dgram_pool::put_buffer(recv_bufs_[i]);
+
+    /* frames that the application still holds keep the pool alive */
+    pool_->release();
 }
 
 rtp_error_t uvgrtp::pkt_dispatcher::start(uvgrtp::socket *socket, int flags)
@@ -30,9 +64,33 @@ rtp_error_t uvgrtp::pkt_dispatcher::start(uvgrtp::socket *socket, int flags)
     return uvgrtp::runner::start();
 }
 
+rtp_error_t uvgrtp::pkt_dispatcher::start(uvgrtp::socket *socket, int flags, uvgrtp::reactor *reactor)
+{
+    socket_  = socket;
+    flags_   = flags;
+    reactor_ = reactor;
+    active_  = true;
+
+    if (!(reactor_key_ = reactor_->add_socket(socket->get_raw_socket(), reactor_handler, this))) {
+        active_ = false;
+        return RTP_GENERIC_ERROR;
+    }
+
+    return RTP_OK;
+}
+
 rtp_error_t uvgrtp::pkt_dispatcher::stop()
 {
+    /* wait until the reactor is not executing our handler before releasing any resources */
+    if (reactor_key_) {
+        (void)reactor_->remove(reactor_key_);
+        reactor_key_ = 0;
+    }
+
+    frames_mtx_.lock();
     active_ = false;
+    frames_mtx_.unlock();
+    frames_cv_.notify_all();
 
     while (!exit_mtx_.try_lock())
         ;
@@ -57,36 +115,39 @@ rtp_error_t uvgrtp::pkt_dispatcher::install_receive_hook(
 
 uvgrtp::frame::rtp_frame *uvgrtp::pkt_dispatcher::pull_frame()
 {
-    while (frames_.empty() && this->active())
-        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::unique_lock<std::mutex> lock(frames_mtx_);
+
+    frames_cv_.wait(lock, [this] { return !frames_.empty() || !this->active(); });
 
     if (!this->active())
         return nullptr;
 
-    frames_mtx_.lock();
-    auto frame = frames_.front();
-    frames_.erase(frames_.begin());
-    frames_mtx_.unlock();
-
-    return frame;
+    return pop_frame();
 }
 
 uvgrtp::frame::rtp_frame *uvgrtp::pkt_dispatcher::pull_frame(size_t timeout)
 {
-    while (frames_.empty() && this->active() && timeout) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        --timeout;
-    }
+    std::unique_lock<std::mutex> lock(frames_mtx_);
+
+    frames_cv_.wait_for(lock, std::chrono::milliseconds(timeout), [this] {
+        return !frames_.empty() || !this->active();
+    });
 
     if (!this->active() || frames_.empty())
         return nullptr;
 
-    frames_mtx_.lock();
-    auto frame = frames_.front();
-    frames_.erase(frames_.begin());
-    frames_mtx_.unlock();
+    return pop_frame();
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::pkt_dispatcher::pop_frame()
+{
+    auto qf = frames_.front();
+    frames_.pop_front();
+
+    if (stats_)
+        stats_->add_pull_latency(uvgrtp::clock::hrc::diff_now_us(qf.queued));
 
-    return frame;
+    return qf.frame;
 }
 
 uint32_t uvgrtp::pkt_dispatcher::install_handler(uvgrtp::packet_handler handler)
@@ -121,14 +182,64 @@ rtp_error_t uvgrtp::pkt_dispatcher::install_aux_handler(
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::pkt_dispatcher::install_jitter_buffer(uvgrtp::jitter_buffer *jb)
+{
+    rtp_error_t ret;
+
+    if (!jb)
+        return RTP_INVALID_VALUE;
+
+    if ((ret = jb->start(this, jitter_release)) != RTP_OK)
+        return ret;
+
+    jitter_ = jb;
+    return RTP_OK;
+}
+
+void uvgrtp::pkt_dispatcher::set_stats(uvgrtp::stats *stats)
+{
+    stats_ = stats;
+}
+
+void uvgrtp::pkt_dispatcher::jitter_release(void *arg, uvgrtp::frame::rtp_frame *frame)
+{
+    ((uvgrtp::pkt_dispatcher *)arg)->deliver_frame(frame);
+}
+
 void uvgrtp::pkt_dispatcher::return_frame(uvgrtp::frame::rtp_frame *frame)
 {
+    /* frames assembled from several datagrams arrived when their last datagram did */
+    if (!frame->arrival)
+        frame->arrival = arrival_;
+
+    if (jitter_)
+        jitter_->insert(frame);
+    else
+        deliver_frame(frame);
+}
+
+void uvgrtp::pkt_dispatcher::deliver_frame(uvgrtp::frame::rtp_frame *frame)
+{
+    if (stats_)
+        stats_->add_completed_frame();
+
     if (recv_hook_) {
         recv_hook_(recv_hook_arg_, frame);
     } else {
         frames_mtx_.lock();
-        frames_.push_back(frame);
+
+        if (frames_.size() >= (size_t)MAX_QUEUED_FRAMES) {
+            LOG_WARN("Frame queue is full, dropping the oldest frame!");
+            (void)uvgrtp::frame::dealloc_frame(frames_.front().frame);
+            frames_.pop_front();
+
+            if (stats_)
+                stats_->add_dropped_frame();
+        }
+
+        frames_.push_back({ frame, uvgrtp::clock::hrc::now() });
         frames_mtx_.unlock();
+        frames_cv_.notify_one();
     }
 }
 
@@ -138,20 +249,21 @@ void uvgrtp::pkt_dispatcher::call_aux_handlers(uint32_t key, int flags, uvgrtp::
 
     for (auto& aux : packet_handlers_[key].auxiliary) {
         switch ((ret = (*aux.handler)(aux.arg, flags, frame))) {
-            /* packet was handled successfully */
+            /* packet was handled successfully and the handler took ownership of it
+             * so it must not be passed to the remaining handlers */
             case RTP_OK:
-                break;
+                return;
 
             case RTP_MULTIPLE_PKTS_READY:
             {
                 while ((*aux.getter)(aux.arg, frame) == RTP_PKT_READY)
                     this->return_frame(*frame);
             }
-            break;
+            return;
 
             case RTP_PKT_READY:
                 this->return_frame(*frame);
-                break;
+                return;
 
             /* packet was not handled or only partially handled by the handler
              * proceed to the next handler */
@@ -159,13 +271,20 @@ void uvgrtp::pkt_dispatcher::call_aux_handlers(uint32_t key, int flags, uvgrtp::
             case RTP_PKT_MODIFIED:
                 continue;
 
+            /* packet was rejected (e.g. it failed SRTP authentication or replay protection)
+             * so it must not reach the remaining handlers. A handler that has already
+             * released the packet sets "frame" to nullptr */
             case RTP_GENERIC_ERROR:
                 LOG_DEBUG("Received a corrupted packet!");
-                break;
+                if (*frame)
+                    (void)uvgrtp::frame::dealloc_frame(*frame);
+                return;
 
             default:
                 LOG_ERROR("Unknown error code from packet handler: %d", ret);
-                break;
+                if (*frame)
+                    (void)uvgrtp::frame::dealloc_frame(*frame);
+                return;
         }
     }
 }
@@ -206,15 +325,125 @@ void uvgrtp::pkt_dispatcher::call_aux_handlers(uint32_t key, int flags, uvgrtp::
  *
  * If a handler receives a non-null "out", it can safely ignore "packet" and operate just on
  * the "out" parameter because at that point it already contains all needed information. */
-void uvgrtp::pkt_dispatcher::runner(uvgrtp::socket *socket, int flags)
+void uvgrtp::pkt_dispatcher::dispatch_packet(int nread, uint8_t *buffer, int flags, uint64_t arrival)
+{
+    rtp_error_t ret;
+    uvgrtp::frame::rtp_frame *frame;
+
+    arrival_ = arrival;
+
+    for (auto& handler : packet_handlers_) {
+        switch ((ret = (*handler.second.primary)(nread, buffer, flags, &frame))) {
+            /* packet was handled successfully */
+            case RTP_OK:
+                break;
+
+            /* packet was not handled by this primary handlers, proceed to the next one */
+            case RTP_PKT_NOT_HANDLED:
+                continue;
+
+            /* packet was handled by the primary handler
+             * and should be dispatched to the auxiliary handler(s) */
+            case RTP_PKT_MODIFIED:
+                frame->arrival = arrival;
+                this->call_aux_handlers(handler.first, flags, &frame);
+                break;
+
+            case RTP_GENERIC_ERROR:
+                LOG_DEBUG("Received a corrupted packet!");
+                break;
+
+            default:
+                LOG_ERROR("Unknown error code from packet handler: %d", ret);
+                break;
+        }
+    }
+}
+
+void uvgrtp::pkt_dispatcher::refill_slot(int slot)
+{
+    if (recv_bufs_[slot]->refs == 1)
+        return;
+
+    uvgrtp::frame::dgram_pool::put_buffer(recv_bufs_[slot]);
+    recv_bufs_[slot] = pool_->get_buffer();
+
+#ifdef __linux__
+    recv_iovs_[slot].iov_base = uvgrtp::frame::dgram_pool::get_dgram(recv_bufs_[slot]);
+#endif
+}
+
+void uvgrtp::pkt_dispatcher::receive(uvgrtp::socket *socket, int flags)
 {
     int nread;
-    fd_set read_fds;
     rtp_error_t ret;
+
+#ifdef __linux__
+    /* Drain the socket one batch at a time. If the batch was full,
+     * there may be more datagrams waiting so read again before going back to waiting */
+    do {
+        if ((ret = socket->recvmmsg(recv_hdrs_, RECV_BATCH_SIZE, MSG_DONTWAIT, &nread)) == RTP_INTERRUPTED)
+            break;
+
+        if (ret != RTP_OK) {
+            LOG_ERROR("recvmmsg(2) failed! Packet dispatcher cannot continue %d!", ret);
+            break;
+        }
+
+        if (stats_ && nread > 0) {
+            size_t nbytes = 0;
+
+            for (int i = 0; i < nread; ++i)
+                nbytes += recv_hdrs_[i].msg_len;
+
+            stats_->add_recv(nread, nbytes);
+        }
+
+        /* Datagrams without a kernel timestamp arrived at the latest when they were read */
+        uint64_t now = uvgrtp::clock::ntp::now();
+
+        for (int i = 0; i < nread; ++i) {
+            uint64_t arrival = uvgrtp::socket::get_rx_timestamp(&recv_hdrs_[i].msg_hdr);
+
+            dispatch_packet(recv_hdrs_[i].msg_len, (uint8_t *)recv_iovs_[i].iov_base, flags, arrival ? arrival : now);
+            refill_slot(i);
+
+            /* recvmmsg(2) overwrites the control buffer length with the length it used */
+            recv_hdrs_[i].msg_hdr.msg_controllen = RECV_CTRL_SIZE;
+        }
+    } while (nread == RECV_BATCH_SIZE);
+#else
+    do {
+        uint8_t *recv_buffer = uvgrtp::frame::dgram_pool::get_dgram(recv_bufs_[0]);
+
+        if ((ret = socket->recvfrom(recv_buffer, RECV_SLOT_SIZE, MSG_DONTWAIT, &nread)) == RTP_INTERRUPTED)
+            break;
+
+        if (ret != RTP_OK) {
+            LOG_ERROR("recvfrom(2) failed! Packet dispatcher cannot continue %d!", ret);
+            break;
+        }
+
+        if (stats_)
+            stats_->add_recv(1, nread);
+
+        dispatch_packet(nread, recv_buffer, flags, uvgrtp::clock::ntp::now());
+        refill_slot(0);
+    } while (ret == RTP_OK);
+#endif
+}
+
+void uvgrtp::pkt_dispatcher::reactor_handler(void *arg)
+{
+    auto dispatcher = (uvgrtp::pkt_dispatcher *)arg;
+
+    dispatcher->receive(dispatcher->socket_, dispatcher->flags_);
+}
+
+void uvgrtp::pkt_dispatcher::runner(uvgrtp::socket *socket, int flags)
+{
+    fd_set read_fds;
     struct timeval t_val;
-    uvgrtp::frame::rtp_frame *frame;
-    const size_t recv_buffer_len = 8192;
-    uint8_t recv_buffer[recv_buffer_len] = { 0 };
 
     FD_ZERO(&read_fds);
 
@@ -236,41 +465,7 @@ void uvgrtp::pkt_dispatcher::runner(uvgrtp::socket *socket, int flags)
             break;
         }
 
-        do {
-            if ((ret = socket->recvfrom(recv_buffer, recv_buffer_len, MSG_DONTWAIT, &nread)) == RTP_INTERRUPTED)
-                break;
-
-            if (ret != RTP_OK) {
-                LOG_ERROR("recvfrom(2) failed! Packet dispatcher cannot continue %d!", ret);
-                break;
-            }
-
-            for (auto& handler : packet_handlers_) {
-                switch ((ret = (*handler.second.primary)(nread, recv_buffer, flags, &frame))) {
-                    /* packet was handled successfully */
-                    case RTP_OK:
-                        break;
-
-                    /* packet was not handled by this primary handlers, proceed to the next one */
-                    case RTP_PKT_NOT_HANDLED:
-                        continue;
-
-                    /* packet was handled by the primary handler
-                     * and should be dispatched to the auxiliary handler(s) */
-                    case RTP_PKT_MODIFIED:
-                        this->call_aux_handlers(handler.first, flags, &frame);
-                        break;
-
-                    case RTP_GENERIC_ERROR:
-                        LOG_DEBUG("Received a corrupted packet!");
-                        break;
-
-                    default:
-                        LOG_ERROR("Unknown error code from packet handler: %d", ret);
-                        break;
-                }
-            }
-        } while (ret == RTP_OK);
+        receive(socket, flags);
     }
 
     exit_mtx_.unlock();
@@ -8,6 +8,10 @@
 #include <cstring>
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 #include "debug.hh"
 #include "queue.hh"
 #include "random.hh"
@@ -17,7 +21,10 @@
 #include "formats/h266.hh"
 
 uvgrtp::frame_queue::frame_queue(uvgrtp::socket *socket, uvgrtp::rtp *rtp, int flags):
-    rtp_(rtp), socket_(socket), flags_(flags)
+    rtp_(rtp), socket_(socket), flags_(flags),
+    auth_tag_len_(uvgrtp::base_srtp::get_tag_length(flags)),
+    pace_tokens_(0),
+    pace_last_(uvgrtp::clock::hrc::now())
 {
     active_     = nullptr;
     dispatcher_ = nullptr;
@@ -25,6 +32,17 @@ uvgrtp::frame_queue::frame_queue(uvgrtp::socket *socket, uvgrtp::rtp *rtp, int f
     max_queued_ = MAX_QUEUED_MSGS;
     max_mcount_ = MAX_MSG_COUNT;
     max_ccount_ = MAX_CHUNK_COUNT * max_mcount_;
+
+    if (flags_ & RCE_RTCP_NACK) {
+        history_.resize(RTX_HISTORY_SIZE);
+
+        for (auto& packet : history_)
+            packet.valid = false;
+    }
+
+    fec_      = (flags_ & RCE_FEC) ? new uvgrtp::fec(rtp_) : nullptr;
+    rtx_ssrc_ = uvgrtp::random::generate_32();
+    rtx_seq_  = uvgrtp::random::generate_32() & 0xffff;
 }
 
 uvgrtp::frame_queue::~frame_queue()
@@ -36,6 +54,8 @@ uvgrtp::frame_queue::~frame_queue()
 
     if (active_)
         (void)destroy_transaction(active_);
+
+    delete fec_;
 }
 
 rtp_error_t uvgrtp::frame_queue::init_transaction()
@@ -58,6 +78,11 @@ rtp_error_t uvgrtp::frame_queue::init_transaction()
 #endif
         active_->rtp_headers = new uvgrtp::frame::rtp_header[max_mcount_];
 
+        if (auth_tag_len_)
+            active_->rtp_auth_tags = new uint8_t[auth_tag_len_ * max_mcount_];
+        else
+            active_->rtp_auth_tags = nullptr;
+
         switch (rtp_->get_payload()) {
             case RTP_FORMAT_H264:
                 active_->media_headers = new uvgrtp::formats::h264_headers;
@@ -84,17 +109,14 @@ rtp_error_t uvgrtp::frame_queue::init_transaction()
     active_->hdr_ptr     = 0;
     active_->rtphdr_ptr  = 0;
     active_->rtpauth_ptr = 0;
+    active_->copy_block  = 0;
+    active_->copy_off    = 0;
     active_->fqueue      = this;
 
     active_->data_raw     = nullptr;
     active_->data_smart   = nullptr;
     active_->dealloc_hook = dealloc_hook_;
 
-    if (flags_ & RCE_SRTP_AUTHENTICATE_RTP)
-        active_->rtp_auth_tags = new uint8_t[10 * max_mcount_];
-    else
-        active_->rtp_auth_tags = nullptr;
-
     active_->out_addr = socket_->get_out_address();
     rtp_->fill_header((uint8_t *)&active_->rtp_common);
     active_->buffers.clear();
@@ -144,6 +166,9 @@ rtp_error_t uvgrtp::frame_queue::destroy_transaction(uvgrtp::transaction_t *t)
     delete[] t->rtp_headers;
     delete[] t->rtp_auth_tags;
 
+    for (auto& block : t->copy_blocks)
+        delete[] block.second;
+
     t->headers     = nullptr;
     t->chunks      = nullptr;
     t->rtp_headers = nullptr;
@@ -192,14 +217,6 @@ rtp_error_t uvgrtp::frame_queue::deinit_transaction(uint32_t key)
     }
 
     if (active_ && active_->key == key) {
-        /* free all temporary buffers */
-        if ((flags_ & (RCE_SRTP | RCE_SRTP_INPLACE_ENCRYPTION | RCE_SRTP_NULL_CIPHER)) == RCE_SRTP) {
-            for (auto& packet : active_->packets) {
-                for (size_t i = 1; i < packet.size(); ++i) {
-                    delete[] packet[i].second;
-                }
-            }
-        }
         active_->packets.clear();
         free_.push_back(active_);
         active_ = nullptr;
@@ -213,28 +230,7 @@ rtp_error_t uvgrtp::frame_queue::deinit_transaction(uint32_t key)
     }
 
     if (free_.size() >= (size_t)max_queued_) {
-        switch (rtp_->get_payload()) {
-            case RTP_FORMAT_H264:
-                delete (uvgrtp::formats::h264_headers *)transaction_it->second->media_headers;
-                break;
-
-            case RTP_FORMAT_H265:
-                delete (uvgrtp::formats::h265_headers *)transaction_it->second->media_headers;
-                break;
-
-            case RTP_FORMAT_H266:
-                delete (uvgrtp::formats::h266_headers *)transaction_it->second->media_headers;
-                break;
-
-            default:
-                break;
-        }
-
-        delete[] transaction_it->second->rtp_auth_tags;
-        delete[] transaction_it->second->headers;
-        delete[] transaction_it->second->chunks;
-        delete[] transaction_it->second->rtp_headers;
-        delete   transaction_it->second;
+        (void)destroy_transaction(transaction_it->second);
     } else {
         free_.push_back(transaction_it->second);
     }
@@ -276,15 +272,17 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(uint8_t *message, size_t messag
 
     /* If SRTP with proper encryption has been enabled but
      * RCE_SRTP_INPLACE_ENCRYPTION has **not** been enabled, make a copy of the memory block*/
-    if ((flags_ & (RCE_SRTP | RCE_SRTP_INPLACE_ENCRYPTION | RCE_SRTP_NULL_CIPHER)) == RCE_SRTP)
-        message = (uint8_t *)memdup(message, message_len);
+    if ((flags_ & (RCE_SRTP | RCE_SRTP_INPLACE_ENCRYPTION | RCE_SRTP_NULL_CIPHER)) == RCE_SRTP) {
+        if (!(message = copy_payload(message, message_len)))
+            return RTP_MEMORY_ERROR;
+    }
 
     tmp.push_back({ message_len, message });
 
-    if (flags_ & RCE_SRTP_AUTHENTICATE_RTP) {
+    if (auth_tag_len_) {
         tmp.push_back({
-            AUTH_TAG_LENGTH,
-            (uint8_t *)&active_->rtp_auth_tags[10 * active_->rtpauth_ptr++]
+            auth_tag_len_,
+            (uint8_t *)&active_->rtp_auth_tags[auth_tag_len_ * active_->rtpauth_ptr++]
         });
     }
 
@@ -319,7 +317,7 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(std::vector<std::pair<size_t, u
     });
 
     /* If SRTP with proper encryption is used and there are more than one buffer,
-     * frame queue must be a copy of the input and  */
+     * the buffers are coalesced to one copy so that the payload can be encrypted in one go */
     if ((flags_ & RCE_SRTP) && !(flags_ & RCE_SRTP_NULL_CIPHER) && buffers.size() > 1) {
         size_t total = 0;
         uint8_t *mem = nullptr;
@@ -328,10 +326,8 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(std::vector<std::pair<size_t, u
         for (auto& buffer : buffers)
             total += buffer.first;
 
-        if (!(mem = ptr = new uint8_t[total])) {
-            LOG_ERROR("Failed to allocate memory for copy block!");
+        if (!(mem = ptr = copy_payload(nullptr, total)))
             return RTP_MEMORY_ERROR;
-        }
 
         for (auto& buffer : buffers) {
             memcpy(ptr, buffer.second, buffer.first);
@@ -345,10 +341,10 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(std::vector<std::pair<size_t, u
             tmp.push_back({ buffer.first, buffer.second });
     }
 
-    if (flags_ & RCE_SRTP_AUTHENTICATE_RTP) {
+    if (auth_tag_len_) {
         tmp.push_back({
-            AUTH_TAG_LENGTH,
-            (uint8_t *)&active_->rtp_auth_tags[10 * active_->rtpauth_ptr++]
+            auth_tag_len_,
+            (uint8_t *)&active_->rtp_auth_tags[auth_tag_len_ * active_->rtpauth_ptr++]
         });
     }
 
@@ -375,16 +371,217 @@ rtp_error_t uvgrtp::frame_queue::flush_queue()
     queued_.insert(std::make_pair(active_->key, active_));
     transaction_mtx_.unlock();
 
-    if (socket_->sendto(active_->packets, 0) != RTP_OK) {
+    size_t pace_rate = rtp_->get_pace_rate();
+    uint64_t launch  = rtp_->get_launch_time();
+    rtp_error_t ret;
+
+    if (pace_rate)
+        ret = send_paced(active_->packets, pace_rate, rtp_->get_pace_burst(), launch);
+    else if (launch)
+        ret = socket_->sendto_at(active_->packets, 0, launch);
+    else
+        ret = socket_->sendto(active_->packets, 0);
+
+    if (ret != RTP_OK) {
         LOG_ERROR("Failed to flush the message queue: %s", strerror(errno));
         (void)deinit_transaction();
         return RTP_SEND_ERROR;
     }
 
+    if (flags_ & RCE_RTCP_NACK)
+        save_history();
+
+    /* parity packets follow the media packets of the frame */
+    if (fec_ && fec_->protect(socket_, active_->packets, launch) != RTP_OK)
+        LOG_WARN("Failed to send FEC parity packets");
+
     LOG_DEBUG("full message took %zu chunks and %zu messages", active_->chunk_ptr, active_->hdr_ptr);
     return deinit_transaction();
 }
 
+void uvgrtp::frame_queue::save_history()
+{
+    std::lock_guard<std::mutex> lock(history_mtx_);
+
+    /* The packets have already been sent so the buffers hold the exact bytes
+     * that were sent, including SRTP encryption and the authentication tag */
+    for (auto& packet : active_->packets) {
+        size_t len = 0;
+
+        for (auto& buf : packet)
+            len += buf.first;
+
+        uint16_t seq = ntohs(*(uint16_t *)&packet[0].second[2]);
+        auto& slot   = history_[seq % RTX_HISTORY_SIZE];
+
+        slot.valid = true;
+        slot.seq   = seq;
+        slot.data.resize(len);
+
+        uint8_t *ptr = slot.data.data();
+
+        for (auto& buf : packet) {
+            memcpy(ptr, buf.second, buf.first);
+            ptr += buf.first;
+        }
+    }
+}
+
+rtp_error_t uvgrtp::frame_queue::retransmit(std::vector<uint16_t>& seqs)
+{
+    std::lock_guard<std::mutex> lock(history_mtx_);
+
+    uint8_t rtx_payload = (flags_ & RCE_SRTP) ? 0 : rtp_->get_rtx_payload();
+    rtp_error_t ret     = RTP_OK;
+
+    if (history_.empty())
+        return RTP_OK;
+
+    for (auto seq : seqs) {
+        auto& slot = history_[seq % RTX_HISTORY_SIZE];
+
+        if (!slot.valid || slot.seq != seq) {
+            LOG_DEBUG("Packet %u is no longer in the retransmission history", seq);
+            continue;
+        }
+
+        if (!rtx_payload) {
+            if (socket_->sendto(slot.data.data(), slot.data.size(), 0) != RTP_OK)
+                ret = RTP_SEND_ERROR;
+            continue;
+        }
+
+        /* RFC 4588: RTP header of the retransmission stream, the original
+         * sequence number (OSN) and then the original payload */
+        size_t len = slot.data.size() + sizeof(uint16_t);
+        rtx_buf_.resize(len);
+
+        uint8_t *ptr = rtx_buf_.data();
+
+        memcpy(ptr, slot.data.data(), RTP_HDR_SIZE);
+        ptr[1] = (ptr[1] & 0x80) | (rtx_payload & 0x7f);
+
+        *(uint16_t *)&ptr[2] = htons(rtx_seq_++);
+        *(uint32_t *)&ptr[8] = htonl(rtx_ssrc_);
+        *(uint16_t *)&ptr[RTP_HDR_SIZE] = htons(seq);
+
+        memcpy(&ptr[RTP_HDR_SIZE + 2], slot.data.data() + RTP_HDR_SIZE, slot.data.size() - RTP_HDR_SIZE);
+
+        if (socket_->sendto(rtx_buf_.data(), len, 0) != RTP_OK)
+            ret = RTP_SEND_ERROR;
+    }
+
+    return ret;
+}
+
+void uvgrtp::frame_queue::nack_hook(void *arg, std::vector<uint16_t>& seqs)
+{
+    if (((uvgrtp::frame_queue *)arg)->retransmit(seqs) != RTP_OK)
+        LOG_ERROR("Failed to retransmit packets!");
+}
+
+uint8_t *uvgrtp::frame_queue::copy_payload(uint8_t *data, size_t len)
+{
+    auto& blocks = active_->copy_blocks;
+    uint8_t *ptr = nullptr;
+
+    while (active_->copy_block < blocks.size()) {
+        auto& block = blocks[active_->copy_block];
+
+        if (block.first - active_->copy_off >= len) {
+            ptr = block.second + active_->copy_off;
+            break;
+        }
+
+        active_->copy_block++;
+        active_->copy_off = 0;
+    }
+
+    if (!ptr) {
+        size_t size = std::max((size_t)COPY_BLOCK_SIZE, len);
+
+        if (!(ptr = new uint8_t[size])) {
+            LOG_ERROR("Failed to allocate memory for copy block!");
+            return nullptr;
+        }
+
+        blocks.push_back({ size, ptr });
+        active_->copy_block = blocks.size() - 1;
+        active_->copy_off   = 0;
+    }
+
+    if (data)
+        memcpy(ptr, data, len);
+
+    active_->copy_off += len;
+    return ptr;
+}
+
+rtp_error_t uvgrtp::frame_queue::send_paced(uvgrtp::pkt_vec& packets, size_t pace_rate, size_t pace_burst, uint64_t& launch_time)
+{
+    size_t start = 0;
+
+    while (start < packets.size()) {
+        size_t end   = start;
+        size_t bytes = 0;
+
+        /* collect consecutive packets to the burst, always at least one */
+        do {
+            size_t len = 0;
+
+            for (auto& buf : packets[end])
+                len += buf.first;
+
+            if (end > start && bytes + len > pace_burst)
+                break;
+
+            bytes += len;
+        } while (++end < packets.size());
+
+        /* the kernel spaces the bursts, the next one leaves when this one would have been sent at the pacing rate */
+        if (launch_time) {
+            burst_.assign(packets.begin() + start, packets.begin() + end);
+
+            if (socket_->sendto_at(burst_, 0, launch_time) != RTP_OK)
+                return RTP_SEND_ERROR;
+
+            if (end < packets.size())
+                launch_time += (uint64_t)(bytes * 8e9 / pace_rate);
+
+            start = end;
+            continue;
+        }
+
+        /* refill the bucket, a burst larger than "pace_burst" is possible only
+         * if a single packet is larger than that so allow the bucket to hold it */
+        double capacity = (double)std::max(pace_burst, bytes);
+        double elapsed  = (double)uvgrtp::clock::hrc::diff_now_us(pace_last_);
+
+        pace_last_   = uvgrtp::clock::hrc::now();
+        pace_tokens_ = std::min(capacity, pace_tokens_ + elapsed * pace_rate / 8e6);
+
+        if (pace_tokens_ < bytes) {
+            double wait = (bytes - pace_tokens_) * 8e6 / pace_rate;
+
+            std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)wait));
+
+            pace_last_   = uvgrtp::clock::hrc::now();
+            pace_tokens_ = bytes;
+        }
+
+        pace_tokens_ -= bytes;
+
+        burst_.assign(packets.begin() + start, packets.begin() + end);
+
+        if (socket_->sendto(burst_, 0) != RTP_OK)
+            return RTP_SEND_ERROR;
+
+        start = end;
+    }
+
+    return RTP_OK;
+}
+
 void uvgrtp::frame_queue::update_rtp_header()
 {
     memcpy(&active_->rtp_headers[active_->rtphdr_ptr], &active_->rtp_common, sizeof(active_->rtp_common));
@@ -0,0 +1,271 @@
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include <cstring>
+
+#include "debug.hh"
+#include "reactor.hh"
+
+/* epoll data of the exit eventfd, source keys start from 1 */
+#define EXIT_KEY 0
+
+uvgrtp::reactor::reactor():
+    epoll_fd_(-1),
+    exit_fd_(-1),
+    next_key_(1)
+{
+}
+
+uvgrtp::reactor::~reactor()
+{
+#ifdef __linux__
+    if (exit_fd_ >= 0) {
+        uint64_t value = 1;
+
+        /* the exit eventfd is level-triggered and never read
+         * so every reactor thread sees it and exits */
+        if (::write(exit_fd_, &value, sizeof(value)) < 0)
+            LOG_ERROR("Failed to signal reactor threads: %s", strerror(errno));
+    }
+
+    for (auto& thread : threads_)
+        thread.join();
+
+    for (auto& src : sources_) {
+        if (src.second->timer)
+            ::close(src.second->fd);
+        delete src.second;
+    }
+
+    if (exit_fd_ >= 0)
+        ::close(exit_fd_);
+
+    if (epoll_fd_ >= 0)
+        ::close(epoll_fd_);
+#endif
+}
+
+rtp_error_t uvgrtp::reactor::start()
+{
+#ifdef __linux__
+    if (epoll_fd_ >= 0)
+        return RTP_OK;
+
+    if ((epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        LOG_ERROR("epoll_create1(2) failed: %s", strerror(errno));
+        return RTP_GENERIC_ERROR;
+    }
+
+    if ((exit_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+        LOG_ERROR("eventfd(2) failed: %s", strerror(errno));
+        ::close(epoll_fd_);
+        epoll_fd_ = -1;
+        return RTP_GENERIC_ERROR;
+    }
+
+    struct epoll_event ev;
+    ev.events   = EPOLLIN;
+    ev.data.u64 = EXIT_KEY;
+
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, exit_fd_, &ev) < 0) {
+        LOG_ERROR("Failed to add exit eventfd to epoll: %s", strerror(errno));
+        ::close(exit_fd_);
+        ::close(epoll_fd_);
+        exit_fd_ = epoll_fd_ = -1;
+        return RTP_GENERIC_ERROR;
+    }
+
+    for (int i = 0; i < REACTOR_THREADS; ++i)
+        threads_.emplace_back(&uvgrtp::reactor::worker, this);
+
+    return RTP_OK;
+#else
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t uvgrtp::reactor::add_source(source *src)
+{
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(sources_mtx_);
+
+    if (start() != RTP_OK)
+        return 0;
+
+    uint32_t key = next_key_++;
+
+    struct epoll_event ev;
+    ev.events   = EPOLLIN | EPOLLONESHOT;
+    ev.data.u64 = key;
+
+    sources_[key] = src;
+
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, src->fd, &ev) < 0) {
+        LOG_ERROR("Failed to add file descriptor %d to epoll: %s", src->fd, strerror(errno));
+        sources_.erase(key);
+        return 0;
+    }
+
+    return key;
+#else
+    (void)src;
+    return 0;
+#endif
+}
+
+uint32_t uvgrtp::reactor::add_socket(int fd, reactor_handler handler, void *arg)
+{
+    if (fd < 0 || !handler)
+        return 0;
+
+    source *src = new source{ fd, false, false, false, handler, arg };
+    uint32_t key;
+
+    if (!(key = add_source(src)))
+        delete src;
+
+    return key;
+}
+
+uint32_t uvgrtp::reactor::add_timer(uint32_t interval, reactor_handler handler, void *arg)
+{
+#ifdef __linux__
+    if (!interval || !handler)
+        return 0;
+
+    int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+    if (fd < 0) {
+        LOG_ERROR("timerfd_create(2) failed: %s", strerror(errno));
+        return 0;
+    }
+
+    struct itimerspec its;
+    its.it_interval.tv_sec  = interval / 1000;
+    its.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+    its.it_value            = its.it_interval;
+
+    if (::timerfd_settime(fd, 0, &its, nullptr) < 0) {
+        LOG_ERROR("timerfd_settime(2) failed: %s", strerror(errno));
+        ::close(fd);
+        return 0;
+    }
+
+    source *src = new source{ fd, true, false, false, handler, arg };
+    uint32_t key;
+
+    if (!(key = add_source(src))) {
+        ::close(fd);
+        delete src;
+    }
+
+    return key;
+#else
+    (void)interval, (void)handler, (void)arg;
+    return 0;
+#endif
+}
+
+rtp_error_t uvgrtp::reactor::remove(uint32_t key)
+{
+#ifdef __linux__
+    std::unique_lock<std::mutex> lock(sources_mtx_);
+
+    auto it = sources_.find(key);
+
+    if (it == sources_.end())
+        return RTP_NOT_FOUND;
+
+    source *src  = it->second;
+    src->removed = true;
+
+    (void)::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, src->fd, nullptr);
+
+    /* a reactor thread may be executing the handler right now, wait for it to return */
+    idle_cv_.wait(lock, [src] { return !src->busy; });
+
+    sources_.erase(key);
+
+    if (src->timer)
+        ::close(src->fd);
+    delete src;
+
+    return RTP_OK;
+#else
+    (void)key;
+    return RTP_NOT_FOUND;
+#endif
+}
+
+void uvgrtp::reactor::worker()
+{
+#ifdef __linux__
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    for (;;) {
+        int nready = ::epoll_wait(epoll_fd_, events, REACTOR_MAX_EVENTS, -1);
+
+        if (nready < 0) {
+            if (errno == EINTR)
+                continue;
+
+            LOG_ERROR("epoll_wait(2) failed: %s", strerror(errno));
+            return;
+        }
+
+        for (int i = 0; i < nready; ++i) {
+            uint32_t key = (uint32_t)events[i].data.u64;
+
+            if (key == EXIT_KEY)
+                return;
+
+            source *src = nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(sources_mtx_);
+
+                auto it = sources_.find(key);
+
+                if (it == sources_.end() || it->second->removed)
+                    continue;
+
+                src       = it->second;
+                src->busy = true;
+            }
+
+            if (src->timer) {
+                uint64_t expirations;
+
+                /* reset the timer so it is not reported again before the next expiration */
+                if (::read(src->fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                    LOG_ERROR("Failed to read timerfd: %s", strerror(errno));
+            }
+
+            src->handler(src->arg);
+
+            {
+                std::lock_guard<std::mutex> lock(sources_mtx_);
+
+                src->busy = false;
+
+                if (src->removed) {
+                    idle_cv_.notify_all();
+                    continue;
+                }
+
+                struct epoll_event ev;
+                ev.events   = EPOLLIN | EPOLLONESHOT;
+                ev.data.u64 = key;
+
+                if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, src->fd, &ev) < 0)
+                    LOG_ERROR("Failed to rearm file descriptor %d: %s", src->fd, strerror(errno));
+            }
+        }
+    }
+#endif
+}
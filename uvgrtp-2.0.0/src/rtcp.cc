@@ -19,11 +19,17 @@ uvgrtp::rtcp::rtcp(uvgrtp::rtp *rtp, int flags):
     tp_(0), tc_(0), tn_(0), pmembers_(0),
     members_(0), senders_(0), rtcp_bandwidth_(0),
     we_sent_(0), avg_rtcp_pkt_pize_(0), rtcp_pkt_count_(0),
-    rtcp_pkt_sent_count_(0), initial_(true), num_receivers_(0),
+    rtcp_pkt_sent_count_(0), ip_hdr_size_(IPV4_HDR_SIZE), initial_(true), num_receivers_(0),
     sender_hook_(nullptr),
     receiver_hook_(nullptr),
     sdes_hook_(nullptr),
-    app_hook_(nullptr)
+    app_hook_(nullptr),
+    nack_arg_(nullptr),
+    nack_hook_(nullptr),
+    nack_init_(false),
+    nack_ssrc_(0),
+    nack_payload_(0),
+    nack_max_seq_(0)
 {
     ssrc_         = rtp->get_ssrc();
     clock_rate_   = rtp->get_clock_rate();
@@ -32,6 +38,10 @@ uvgrtp::rtcp::rtcp(uvgrtp::rtp *rtp, int flags):
     rtp_ts_start_ = 0;
     runner_       = nullptr;
     srtcp_        = nullptr;
+    reactor_      = nullptr;
+
+    mcast_member_   = false;
+    mcast_loopback_ = true;
 
     zero_stats(&our_stats);
 }
@@ -64,11 +74,52 @@ rtp_error_t uvgrtp::rtcp::start()
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::rtcp::start(uvgrtp::reactor *reactor)
+{
+    if (sockets_.empty()) {
+        LOG_ERROR("Cannot start RTCP because no connections have been initialized");
+        return RTP_INVALID_VALUE;
+    }
+
+    uint32_t key;
+    reactor_ = reactor;
+    active_  = true;
+
+    for (auto& socket : sockets_) {
+        if (!(key = reactor_->add_socket(socket.get_raw_socket(), reactor_recv_handler, this)))
+            goto error;
+        reactor_keys_.push_back(key);
+    }
+
+    if (!(key = reactor_->add_timer(MIN_TIMEOUT, reactor_timer_handler, this)))
+        goto error;
+    reactor_keys_.push_back(key);
+
+    return RTP_OK;
+
+error:
+    LOG_ERROR("Failed to add RTCP to the reactor!");
+
+    for (auto& k : reactor_keys_)
+        (void)reactor_->remove(k);
+
+    reactor_keys_.clear();
+    active_ = false;
+
+    return RTP_GENERIC_ERROR;
+}
+
 rtp_error_t uvgrtp::rtcp::stop()
 {
-    if (!runner_)
+    /* make sure the reactor is not executing our handlers anymore */
+    for (auto& key : reactor_keys_)
+        (void)reactor_->remove(key);
+
+    if (!runner_ && reactor_keys_.empty())
         goto free_mem;
 
+    reactor_keys_.clear();
+
     /* when the member count is less than 50,
      * we can just send the BYE message and destroy the session */
     if (members_ < 50) {
@@ -108,6 +159,7 @@ rtp_error_t uvgrtp::rtcp::add_participant(std::string dst_addr, uint16_t dst_por
 
     rtp_error_t ret;
     rtcp_participant *p;
+    short family = uvgrtp::socket::get_family(dst_addr);
 
     if (!(p = new rtcp_participant))
         return RTP_MEMORY_ERROR;
@@ -117,7 +169,7 @@ rtp_error_t uvgrtp::rtcp::add_participant(std::string dst_addr, uint16_t dst_por
     if (!(p->socket = new uvgrtp::socket(0)))
         return RTP_MEMORY_ERROR;
 
-    if ((ret = p->socket->init(AF_INET, SOCK_DGRAM, 0)) != RTP_OK)
+    if ((ret = p->socket->init(family, SOCK_DGRAM, 0)) != RTP_OK)
         return ret;
 
     int enable = 1;
@@ -146,13 +198,27 @@ rtp_error_t uvgrtp::rtcp::add_participant(std::string dst_addr, uint16_t dst_por
 
     LOG_WARN("Binding to port %d (source port)", src_port);
 
-    if ((ret = p->socket->bind(AF_INET, INADDR_ANY, src_port)) != RTP_OK)
+    if ((ret = p->socket->bind(family, INADDR_ANY, src_port)) != RTP_OK)
         return ret;
 
     p->role             = RECEIVER;
-    p->address          = p->socket->create_sockaddr(AF_INET, dst_addr, dst_port);
+    p->address          = p->socket->create_sockaddr(family, dst_addr, dst_port);
     p->stats.clock_rate = clock_rate;
 
+    if (p->address.ss_family == AF_UNSPEC)
+        return RTP_INVALID_VALUE;
+
+    if (family == AF_INET6)
+        ip_hdr_size_ = IPV6_HDR_SIZE;
+
+    /* The reports of all members of a multicast group are received from the group */
+    if (uvgrtp::multicast::is_multicast(p->address)) {
+        if ((ret = uvgrtp::multicast(p->socket, family).join(dst_addr, "")) != RTP_OK)
+            return ret;
+
+        mcast_member_ = true;
+    }
+
     initial_participants_.push_back(p);
     sockets_.push_back(*p->socket);
 
@@ -161,12 +227,20 @@ rtp_error_t uvgrtp::rtcp::add_participant(std::string dst_addr, uint16_t dst_por
 
 rtp_error_t uvgrtp::rtcp::add_participant(uint32_t ssrc)
 {
-    /* RTCP is not in use for this media stream,
+    std::lock_guard<std::mutex> lock(send_mtx_);
+
+    /* RTCP is not in use for this media stream or the participant is another member
+     * of a multicast group whose reports are already sent to the group address,
      * create a "fake" participant that is only used for storing statistics information */
     if (initial_participants_.empty()) {
         if (!(participants_[ssrc] = new rtcp_participant))
             return RTP_MEMORY_ERROR;
         zero_stats(&participants_[ssrc]->stats);
+
+        participants_[ssrc]->socket = nullptr;
+
+        /* the remote is assumed to use the clock rate of our payload format */
+        participants_[ssrc]->stats.clock_rate = clock_rate_;
     } else {
         participants_[ssrc] = initial_participants_.back();
         initial_participants_.pop_back();
@@ -184,7 +258,7 @@ rtp_error_t uvgrtp::rtcp::add_participant(uint32_t ssrc)
 void uvgrtp::rtcp::update_rtcp_bandwidth(size_t pkt_size)
 {
     rtcp_pkt_count_    += 1;
-    rtcp_byte_count_   += pkt_size + UDP_HDR_SIZE + IPV4_HDR_SIZE;
+    rtcp_byte_count_   += pkt_size + UDP_HDR_SIZE + ip_hdr_size_;
     avg_rtcp_pkt_pize_  = rtcp_byte_count_ / rtcp_pkt_count_;
 }
 
@@ -252,7 +326,7 @@ rtp_error_t uvgrtp::rtcp::init_new_participant(uvgrtp::frame::rtp_frame *frame)
     /* This is the first RTP frame from remote to frame->header.timestamp represents t = 0
      * Save the timestamp and current NTP timestamp so we can do jitter calculations later on */
     participants_[frame->header.ssrc]->stats.initial_rtp = frame->header.timestamp;
-    participants_[frame->header.ssrc]->stats.initial_ntp = uvgrtp::clock::ntp::now();
+    participants_[frame->header.ssrc]->stats.initial_ntp = frame->arrival;
 
     senders_++;
 
@@ -352,18 +426,68 @@ rtp_error_t uvgrtp::rtcp::reset_rtcp_state(uint32_t ssrc)
     return RTP_OK;
 }
 
-bool uvgrtp::rtcp::collision_detected(uint32_t ssrc, sockaddr_in& src_addr)
+bool uvgrtp::rtcp::collision_detected(uint32_t ssrc, sockaddr_storage& src_addr)
 {
     if (participants_.find(ssrc) == participants_.end())
         return false;
 
     auto sender = participants_[ssrc];
 
-    if (src_addr.sin_port        != sender->address.sin_port &&
-        src_addr.sin_addr.s_addr != sender->address.sin_addr.s_addr)
-        return true;
+    return !uvgrtp::socket::sockaddr_equal(src_addr, sender->address);
+}
+
+uint64_t uvgrtp::rtcp::get_jitter_us(uint32_t ssrc)
+{
+    auto it = participants_.find(ssrc);
+
+    if (it == participants_.end() || !it->second->stats.clock_rate)
+        return 0;
+
+    return (uint64_t)it->second->stats.jitter * 1000000 / it->second->stats.clock_rate;
+}
+
+rtp_error_t uvgrtp::rtcp::set_multicast_ttl(int ttl)
+{
+    rtp_error_t ret = RTP_OK;
 
-    return false;
+    for (auto p : multicast_participants()) {
+        if ((ret = uvgrtp::multicast(p->socket, p->address.ss_family).set_ttl(ttl)) != RTP_OK)
+            break;
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::rtcp::set_multicast_loopback(bool enable)
+{
+    rtp_error_t ret = RTP_OK;
+
+    for (auto p : multicast_participants()) {
+        if ((ret = uvgrtp::multicast(p->socket, p->address.ss_family).set_loopback(enable)) != RTP_OK)
+            break;
+    }
+
+    if (ret == RTP_OK)
+        mcast_loopback_ = enable;
+
+    return ret;
+}
+
+std::vector<uvgrtp::rtcp_participant *> uvgrtp::rtcp::multicast_participants()
+{
+    std::vector<uvgrtp::rtcp_participant *> group;
+
+    for (auto& p : initial_participants_) {
+        if (uvgrtp::multicast::is_multicast(p->address))
+            group.push_back(p);
+    }
+
+    for (auto& p : participants_) {
+        if (p.second->socket && uvgrtp::multicast::is_multicast(p.second->address))
+            group.push_back(p.second);
+    }
+
+    return group;
 }
 
 void uvgrtp::rtcp::update_session_statistics(uvgrtp::frame::rtp_frame *frame)
@@ -380,11 +504,10 @@ void uvgrtp::rtcp::update_session_statistics(uvgrtp::frame::rtp_frame *frame)
     int dropped = expected - p->stats.received_pkts;
     p->stats.dropped_pkts = dropped >= 0 ? dropped : 0;
 
-    int arrival =
-        p->stats.initial_rtp +
-        + uvgrtp::clock::ntp::diff_now(p->stats.initial_ntp)
-        * (p->stats.clock_rate
-        / 1000);
+    /* Arrival time of the packet in RTP timestamp units, calculated from the kernel receive
+     * timestamp so that the scheduling delay of the receiver does not show up as jitter */
+    uint32_t arrival = p->stats.initial_rtp
+        + uvgrtp::clock::ntp::diff_rtp(frame->arrival, p->stats.initial_ntp, p->stats.clock_rate);
 
 	/* calculate interarrival jitter */
     int transit = arrival - frame->header.timestamp;
@@ -410,17 +533,32 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler(void *arg, int flags, frame::rtp_f
     uvgrtp::frame::rtp_frame *frame = *out;
     uvgrtp::rtcp *rtcp              = (uvgrtp::rtcp *)arg;
 
+    /* Retransmitted packets are restored before anything else looks at them
+     * and the sequence number gaps are tracked before the probation below drops packets */
+    if (rtcp->flags_ & RCE_RTCP_NACK) {
+        uint8_t rtx_payload = rtcp->rtp_->get_rtx_payload();
+
+        if (rtx_payload && frame->header.payload == rtx_payload && !(rtcp->flags_ & RCE_SRTP)) {
+            if (rtcp->restore_rtx_packet(frame) != RTP_OK)
+                return RTP_GENERIC_ERROR;
+        }
+
+        rtcp->update_nack_state(frame);
+    }
+
     /* If this is the first packet from remote, move the participant from initial_participants_
      * to participants_, initialize its state and put it on probation until enough valid
      * packets from them have been received
      *
      * Otherwise update and monitor the received sequence numbers to determine whether something
      * has gone awry with the sender's sequence number calculations/delivery of packets */
+    /* A packet from a source on probation or after a large sequence number jump is
+     * left out of the statistics but it is still passed on to the media handlers */
     if (!rtcp->is_participant(frame->header.ssrc)) {
         if ((ret = rtcp->init_new_participant(frame)) != RTP_OK)
-            return RTP_GENERIC_ERROR;
+            return RTP_PKT_NOT_HANDLED;
     } else if (rtcp->update_participant_seq(frame->header.ssrc, frame->header.seq) != RTP_OK) {
-        return RTP_GENERIC_ERROR;
+        return RTP_PKT_NOT_HANDLED;
     }
 
     /* Finally update the jitter/transit/received/dropped bytes/pkts statistics */
@@ -462,13 +600,21 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size)
         return RTP_INVALID_VALUE;
     }
 
-    if (pkt_type > uvgrtp::frame::RTCP_FT_BYE ||
+    if (pkt_type > uvgrtp::frame::RTCP_FT_RTPFB ||
         pkt_type < uvgrtp::frame::RTCP_FT_SR) {
         LOG_ERROR("Invalid packet type (%u)!", pkt_type);
         return RTP_INVALID_VALUE;
     }
 
-    update_rtcp_bandwidth(size);
+    /* our own reports are looped back to us from a multicast group (RFC 3550 section 8.2),
+     * elsewhere a report with our SSRC comes from another source and is an SSRC collision */
+    if (mcast_member_ && mcast_loopback_ && size >= 8 && ntohl(*(uint32_t *)&buffer[4]) == ssrc_)
+        return RTP_OK;
+
+    {
+        std::lock_guard<std::mutex> lock(send_mtx_);
+        update_rtcp_bandwidth(size);
+    }
 
     rtp_error_t ret = RTP_INVALID_VALUE;
 
@@ -493,6 +639,10 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(uint8_t *buffer, size_t size)
             ret = handle_app_packet(buffer, size);
             break;
 
+        case uvgrtp::frame::RTCP_FT_RTPFB:
+            ret = handle_nack_packet(buffer, size);
+            break;
+
         default:
             LOG_WARN("Unknown packet received, type %d", pkt_type);
             break;
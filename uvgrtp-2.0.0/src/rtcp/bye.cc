@@ -9,6 +9,9 @@ rtp_error_t uvgrtp::rtcp::handle_bye_packet(uint8_t *packet, size_t size)
     if (!packet || !size)
         return RTP_INVALID_VALUE;
 
+    /* a NACK may be using the participant's socket in the dispatcher thread */
+    std::lock_guard<std::mutex> lock(send_mtx_);
+
     for (size_t i = 4; i < size; i += sizeof(uint32_t)) {
         uint32_t ssrc = ntohl(*(uint32_t *)&packet[i]);
 
@@ -31,6 +34,8 @@ rtp_error_t uvgrtp::rtcp::send_bye_packet(std::vector<uint32_t> ssrcs)
         LOG_WARN("Source Count in RTCP BYE packet is 0");
     }
 
+    std::lock_guard<std::mutex> lock(send_mtx_);
+
     size_t frame_size;
     rtp_error_t ret;
     uint8_t *frame;
@@ -52,6 +57,9 @@ rtp_error_t uvgrtp::rtcp::send_bye_packet(std::vector<uint32_t> ssrcs)
         SET_NEXT_FIELD_32(frame, ptr, htonl(ssrc));
 
     for (auto& p : participants_) {
+        if (!p.second->socket)
+            continue;
+
         if ((ret = p.second->socket->sendto(p.second->address, frame, frame_size, 0)) != RTP_OK) {
             LOG_ERROR("sendto() failed!");
             goto end;
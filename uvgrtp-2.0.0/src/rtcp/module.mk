@@ -4,4 +4,5 @@ SOURCES += \
 	src/rtcp/bye.cc \
 	src/rtcp/receiver.cc \
 	src/rtcp/sender.cc \
-	src/rtcp/rtcp_runner.cc
+	src/rtcp/rtcp_runner.cc \
+	src/rtcp/nack.cc
@@ -0,0 +1,255 @@
+#ifdef _WIN32
+#else
+#endif
+
+#include <algorithm>
+
+#include "rtcp.hh"
+
+rtp_error_t uvgrtp::rtcp::install_nack_hook(void *arg, void (*hook)(void *, std::vector<uint16_t>&))
+{
+    if (!hook)
+        return RTP_INVALID_VALUE;
+
+    nack_arg_  = arg;
+    nack_hook_ = hook;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::restore_rtx_packet(uvgrtp::frame::rtp_frame *frame)
+{
+    if (!nack_init_ || frame->payload_len < sizeof(uint16_t)) {
+        LOG_DEBUG("Dropping retransmission packet");
+        return RTP_INVALID_VALUE;
+    }
+
+    /* The payload of the retransmission starts with the original sequence number (RFC 4588) */
+    frame->header.seq     = ntohs(*(uint16_t *)frame->payload);
+    frame->header.ssrc    = nack_ssrc_;
+    frame->header.payload = nack_payload_;
+    frame->payload_len   -= sizeof(uint16_t);
+
+    memmove(frame->payload, frame->payload + sizeof(uint16_t), frame->payload_len);
+
+    return RTP_OK;
+}
+
+void uvgrtp::rtcp::update_nack_state(uvgrtp::frame::rtp_frame *frame)
+{
+    uint16_t seq = frame->header.seq;
+    auto now     = uvgrtp::clock::hrc::now();
+
+    if (!nack_init_ || frame->header.ssrc != nack_ssrc_) {
+        nack_init_    = true;
+        nack_ssrc_    = frame->header.ssrc;
+        nack_payload_ = frame->header.payload;
+        nack_max_seq_ = seq;
+        nack_missing_.clear();
+        return;
+    }
+
+    int16_t delta = (int16_t)(seq - nack_max_seq_);
+
+    if (delta > 0) {
+        if (delta > NACK_MAX_GAP) {
+            nack_missing_.clear();
+        } else {
+            for (uint16_t i = nack_max_seq_ + 1; i != seq; ++i) {
+                if (nack_missing_.size() >= (size_t)NACK_MAX_PENDING) {
+                    LOG_WARN("Too many lost packets, not requesting packet %u", i);
+                    break;
+                }
+                nack_missing_[i] = { now, now, 0 };
+            }
+        }
+        nack_max_seq_ = seq;
+    } else if (delta < 0) {
+        /* a late or retransmitted packet */
+        nack_missing_.erase(seq);
+    }
+
+    if (nack_missing_.empty())
+        return;
+
+    size_t max_delay = rtp_->get_pkt_max_delay();
+    std::vector<uint16_t> seqs;
+
+    for (auto it = nack_missing_.begin(); it != nack_missing_.end(); ) {
+        auto& info = it->second;
+
+        if (uvgrtp::clock::hrc::diff_now(info.detected) >= max_delay ||
+            (info.retries >= NACK_MAX_RETRIES &&
+             uvgrtp::clock::hrc::diff_now(info.requested) >= (uint64_t)NACK_RETRY_INTERVAL)) {
+            it = nack_missing_.erase(it);
+            continue;
+        }
+
+        if (!info.retries ||
+            (info.retries < NACK_MAX_RETRIES &&
+             uvgrtp::clock::hrc::diff_now(info.requested) >= (uint64_t)NACK_RETRY_INTERVAL)) {
+            info.requested = now;
+            info.retries++;
+            seqs.push_back(it->first);
+        }
+        ++it;
+    }
+
+    if (!seqs.empty() && send_nack_packet(nack_ssrc_, seqs) != RTP_OK)
+        LOG_ERROR("Failed to send RTCP NACK");
+}
+
+rtp_error_t uvgrtp::rtcp::handle_nack_packet(uint8_t *packet, size_t size)
+{
+    if (!packet || !size)
+        return RTP_INVALID_VALUE;
+
+    size_t trailer = (flags_ & RCE_SRTP) ? SRTCP_INDEX_LENGTH + AUTH_TAG_LENGTH : 0;
+
+    if (size < 12 + trailer) {
+        LOG_ERROR("Received truncated RTCP transport layer feedback message");
+        return RTP_INVALID_VALUE;
+    }
+
+    if ((packet[0] & 0x1f) != NACK_FMT) {
+        LOG_DEBUG("Unsupported transport layer feedback message, FMT %u", packet[0] & 0x1f);
+        return RTP_OK;
+    }
+
+    uint32_t sender_ssrc = ntohl(*(uint32_t *)&packet[4]);
+
+    if (flags_ & RCE_SRTP) {
+        auto srtpi = (*(uint32_t *)&packet[size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH]);
+
+        if (srtcp_->verify_auth_tag(packet, size) != RTP_OK) {
+            LOG_ERROR("Failed to verify RTCP authentication tag!");
+            return RTP_AUTH_TAG_MISMATCH;
+        }
+
+        if (((srtpi >> 31) & 0x1) && !(flags_ & RCE_SRTP_NULL_CIPHER)) {
+            if (srtcp_->decrypt(sender_ssrc, srtpi & 0x7fffffff, packet, size) != RTP_OK) {
+                LOG_ERROR("Failed to decrypt RTCP NACK");
+                return RTP_GENERIC_ERROR;
+            }
+        }
+    }
+
+    if (ntohl(*(uint32_t *)&packet[8]) != ssrc_)
+        return RTP_OK;
+
+    /* The length field counts 32-bit words minus one, the FCI entries follow the media SSRC */
+    size_t nfci = ((size_t)ntohs(*(uint16_t *)&packet[2]) + 1) * 4;
+
+    if (nfci < 12 || nfci > size - trailer) {
+        LOG_ERROR("Invalid RTCP NACK length");
+        return RTP_INVALID_VALUE;
+    }
+    nfci = (nfci - 12) / 4;
+
+    std::vector<uint16_t> seqs;
+
+    for (size_t i = 0; i < nfci; ++i) {
+        uint16_t pid = ntohs(*(uint16_t *)&packet[12 + i * 4]);
+        uint16_t blp = ntohs(*(uint16_t *)&packet[12 + i * 4 + 2]);
+
+        seqs.push_back(pid);
+
+        for (int k = 0; k < 16; ++k) {
+            if (blp & (1 << k))
+                seqs.push_back(pid + k + 1);
+        }
+    }
+
+    if (nack_hook_ && !seqs.empty())
+        nack_hook_(nack_arg_, seqs);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::send_nack_packet(uint32_t media_ssrc, std::vector<uint16_t>& seqs)
+{
+    if (seqs.empty())
+        return RTP_INVALID_VALUE;
+
+    std::lock_guard<std::mutex> lock(send_mtx_);
+
+    auto participant = participants_.find(media_ssrc);
+
+    if (participant == participants_.end() || !participant->second->socket)
+        return RTP_NOT_FOUND;
+
+    /* Sort by distance from the first sequence number so that wrapped numbers stay in order */
+    uint16_t base = *std::min_element(seqs.begin(), seqs.end(), [](uint16_t a, uint16_t b) {
+        return (int16_t)(a - b) < 0;
+    });
+
+    std::sort(seqs.begin(), seqs.end(), [base](uint16_t a, uint16_t b) {
+        return (uint16_t)(a - base) < (uint16_t)(b - base);
+    });
+
+    /* Each FCI entry holds a packet ID and a bitmask of the 16 packets following it */
+    std::vector<std::pair<uint16_t, uint16_t>> fci;
+
+    for (size_t i = 0; i < seqs.size(); ) {
+        uint16_t pid = seqs[i++];
+        uint16_t blp = 0;
+
+        while (i < seqs.size() && (uint16_t)(seqs[i] - pid) <= 16) {
+            if (seqs[i] != pid)
+                blp |= 1 << ((uint16_t)(seqs[i] - pid) - 1);
+            ++i;
+        }
+        fci.push_back({ pid, blp });
+    }
+
+    size_t frame_size;
+    rtp_error_t ret;
+    uint8_t *frame;
+
+    frame_size  = 4;              /* rtcp header */
+    frame_size += 4;              /* our ssrc */
+    frame_size += 4;              /* media ssrc */
+    frame_size += fci.size() * 4; /* fci entries */
+
+    if (flags_ & RCE_SRTP)
+        frame_size += SRTCP_INDEX_LENGTH + AUTH_TAG_LENGTH;
+
+    if (!(frame = new uint8_t[frame_size])) {
+        LOG_ERROR("Failed to allocate space for RTCP NACK");
+        return RTP_MEMORY_ERROR;
+    }
+    memset(frame, 0, frame_size);
+
+    frame[0] = (2 << 6) | (0 << 5) | NACK_FMT;
+    frame[1] = uvgrtp::frame::RTCP_FT_RTPFB;
+
+    *(uint16_t *)&frame[2] = htons((uint16_t)(2 + fci.size()));
+    *(uint32_t *)&frame[4] = htonl(ssrc_);
+    *(uint32_t *)&frame[8] = htonl(media_ssrc);
+
+    for (size_t i = 0; i < fci.size(); ++i) {
+        *(uint16_t *)&frame[12 + i * 4]     = htons(fci[i].first);
+        *(uint16_t *)&frame[12 + i * 4 + 2] = htons(fci[i].second);
+    }
+
+    if (flags_ & RCE_SRTP) {
+        uint32_t srtcp_index = (uint32_t)++rtcp_pkt_sent_count_ & 0x7fffffff;
+
+        if (!(flags_ & RCE_SRTP_NULL_CIPHER)) {
+            srtcp_->encrypt(ssrc_, srtcp_index, &frame[8], frame_size - 8 - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH);
+            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (1 << 31) | srtcp_index);
+        } else {
+            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (0 << 31) | srtcp_index);
+        }
+        srtcp_->add_auth_tag(frame, frame_size);
+    }
+
+    auto p = participant->second;
+
+    if ((ret = p->socket->sendto(p->address, frame, frame_size, 0)) != RTP_OK)
+        LOG_ERROR("sendto() failed!");
+    else
+        update_rtcp_bandwidth(frame_size);
+
+    delete[] frame;
+    return ret;
+}
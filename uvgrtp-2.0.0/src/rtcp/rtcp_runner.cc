@@ -1,4 +1,5 @@
 #ifdef _WIN32
+#define MSG_DONTWAIT 0
 #else
 #endif
 
@@ -23,8 +24,6 @@ std::vector<uint32_t> uvgrtp::rtcp::get_participants()
 
 rtp_error_t uvgrtp::rtcp::generate_report()
 {
-    rtcp_pkt_sent_count_++;
-
     if (our_role_ == RECEIVER)
         return generate_receiver_report();
     return generate_sender_report();
@@ -62,3 +61,29 @@ void uvgrtp::rtcp::rtcp_runner(uvgrtp::rtcp *rtcp)
         }
     }
 }
+
+void uvgrtp::rtcp::reactor_recv_handler(void *arg)
+{
+    auto rtcp = (uvgrtp::rtcp *)arg;
+    uint8_t buffer[MAX_PACKET];
+    int nread;
+
+    std::lock_guard<std::mutex> lock(rtcp->reactor_mtx_);
+
+    /* the reactor does not tell which socket is readable, read all of them until they would block */
+    for (auto& socket : rtcp->get_sockets()) {
+        while (socket.recv(buffer, MAX_PACKET, MSG_DONTWAIT, &nread) == RTP_OK && nread > 0)
+            (void)rtcp->handle_incoming_packet(buffer, (size_t)nread);
+    }
+}
+
+void uvgrtp::rtcp::reactor_timer_handler(void *arg)
+{
+    auto rtcp = (uvgrtp::rtcp *)arg;
+    rtp_error_t ret;
+
+    std::lock_guard<std::mutex> lock(rtcp->reactor_mtx_);
+
+    if ((ret = rtcp->generate_report()) != RTP_OK && ret != RTP_NOT_READY)
+        LOG_ERROR("Failed to send RTCP status report!");
+}
@@ -86,6 +86,8 @@ rtp_error_t uvgrtp::rtcp::send_sdes_packet(std::vector<uvgrtp::frame::rtcp_sdes_
         return RTP_INVALID_VALUE;
     }
 
+    std::lock_guard<std::mutex> lock(send_mtx_);
+
     int ptr = 8;
     uint8_t *frame;
     rtp_error_t ret;
@@ -119,16 +121,21 @@ rtp_error_t uvgrtp::rtcp::send_sdes_packet(std::vector<uvgrtp::frame::rtcp_sdes_
     /* Encrypt the packet if NULL cipher has not been enabled,
      * calculate authentication tag for the packet and add SRTCP index at the end */
     if (flags_ & RCE_SRTP) {
+        uint32_t srtcp_index = (uint32_t)++rtcp_pkt_sent_count_ & 0x7fffffff;
+
         if (!(RCE_SRTP & RCE_SRTP_NULL_CIPHER)) {
-            srtcp_->encrypt(ssrc_, rtcp_pkt_sent_count_, &frame[8], frame_size - 8 - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH);
-            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (1 << 31) | rtcp_pkt_sent_count_);
+            srtcp_->encrypt(ssrc_, srtcp_index, &frame[8], frame_size - 8 - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH);
+            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (1 << 31) | srtcp_index);
         } else  {
-            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (0 << 31) | rtcp_pkt_sent_count_);
+            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (0 << 31) | srtcp_index);
         }
         srtcp_->add_auth_tag(frame, frame_size);
     }
 
     for (auto& p : participants_) {
+        if (!p.second->socket)
+            continue;
+
         if ((ret = p.second->socket->sendto(p.second->address, frame, frame_size, 0)) != RTP_OK) {
             LOG_ERROR("sendto() failed!");
             goto end;
@@ -103,6 +103,8 @@ rtp_error_t uvgrtp::rtcp::generate_sender_report()
         return RTP_NOT_READY;
     }
 
+    std::lock_guard<std::mutex> lock(send_mtx_);
+
     uint64_t ntp_ts, rtp_ts;
     size_t frame_size;
     rtp_error_t ret;
@@ -131,7 +133,7 @@ rtp_error_t uvgrtp::rtcp::generate_sender_report()
 
     /* Sender information */
     ntp_ts = uvgrtp::clock::ntp::now();
-    rtp_ts = rtp_ts_start_ + (uvgrtp::clock::ntp::diff(ntp_ts, clock_start_)) * clock_rate_ / 1000;
+    rtp_ts = rtp_ts_start_ + uvgrtp::clock::ntp::diff_rtp(ntp_ts, clock_start_, clock_rate_);
 
     SET_NEXT_FIELD_32(frame, ptr, htonl(ntp_ts >> 32));
     SET_NEXT_FIELD_32(frame, ptr, htonl(ntp_ts & 0xffffffff));
@@ -162,16 +164,21 @@ rtp_error_t uvgrtp::rtcp::generate_sender_report()
     /* Encrypt the packet if NULL cipher has not been enabled,
      * calculate authentication tag for the packet and add SRTCP index at the end */
     if (flags_ & RCE_SRTP) {
+        uint32_t srtcp_index = (uint32_t)++rtcp_pkt_sent_count_ & 0x7fffffff;
+
         if (!(RCE_SRTP & RCE_SRTP_NULL_CIPHER)) {
-            srtcp_->encrypt(ssrc_, rtcp_pkt_sent_count_, &frame[8], frame_size - 8 - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH);
-            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (1 << 31) | rtcp_pkt_sent_count_);
+            srtcp_->encrypt(ssrc_, srtcp_index, &frame[8], frame_size - 8 - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH);
+            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (1 << 31) | srtcp_index);
         } else  {
-            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (0 << 31) | rtcp_pkt_sent_count_);
+            SET_FIELD_32(frame, frame_size - SRTCP_INDEX_LENGTH - AUTH_TAG_LENGTH, (0 << 31) | srtcp_index);
         }
         srtcp_->add_auth_tag(frame, frame_size);
     }
 
     for (auto& p : participants_) {
+        if (!p.second->socket)
+            continue;
+
         if ((ret = p.second->socket->sendto(p.second->address, frame, frame_size, 0)) != RTP_OK) {
             log_platform_error("sendto(2) failed");
             goto end;
@@ -16,7 +16,16 @@ uvgrtp::rtp::rtp(rtp_format_t fmt):
     wc_start_(0),
     sent_pkts_(0),
     timestamp_(INVALID_TS),
-    delay_(PKT_MAX_DELAY)
+    launch_time_(0),
+    delay_(PKT_MAX_DELAY),
+    pace_rate_(0),
+    pace_burst_(PACE_BURST_SIZE),
+    rtx_payload_(0),
+    fec_payload_(FEC_PAYLOAD_TYPE),
+    fec_group_size_(FEC_GROUP_SIZE),
+    playout_min_(PLAYOUT_DELAY_MIN),
+    playout_max_(PLAYOUT_DELAY_MAX),
+    own_ssrc_filter_(false)
 {
     seq_  = uvgrtp::random::generate_32() & 0xffff;
     ts_   = uvgrtp::random::generate_32();
@@ -105,10 +114,7 @@ void uvgrtp::rtp::fill_header(uint8_t *buffer)
 
     if (timestamp_ == INVALID_TS) {
         *(uint32_t *)&buffer[4] = htonl(
-            ts_
-            + uvgrtp::clock::ntp::diff_now(wc_start_)
-            * clock_rate_
-            / 1000
+            ts_ + uvgrtp::clock::ntp::diff_rtp(uvgrtp::clock::ntp::now(), wc_start_, clock_rate_)
         );
 
     } else {
@@ -121,6 +127,11 @@ void uvgrtp::rtp::set_timestamp(uint64_t timestamp)
     timestamp_= timestamp;
 }
 
+void uvgrtp::rtp::set_launch_time(uint64_t launch_time)
+{
+    launch_time_ = launch_time;
+}
+
 uint32_t uvgrtp::rtp::get_clock_rate(void)
 {
     return clock_rate_;
@@ -160,6 +171,91 @@ size_t uvgrtp::rtp::get_pkt_max_delay()
     return delay_;
 }
 
+void uvgrtp::rtp::set_pace_rate(size_t rate)
+{
+    pace_rate_ = rate;
+}
+
+size_t uvgrtp::rtp::get_pace_rate()
+{
+    return pace_rate_;
+}
+
+void uvgrtp::rtp::set_pace_burst(size_t burst)
+{
+    pace_burst_ = burst;
+}
+
+size_t uvgrtp::rtp::get_pace_burst()
+{
+    return pace_burst_;
+}
+
+void uvgrtp::rtp::set_rtx_payload(uint8_t payload)
+{
+    rtx_payload_ = payload;
+}
+
+uint8_t uvgrtp::rtp::get_rtx_payload()
+{
+    return rtx_payload_;
+}
+
+void uvgrtp::rtp::set_fec_payload(uint8_t payload)
+{
+    fec_payload_ = payload;
+}
+
+uint8_t uvgrtp::rtp::get_fec_payload()
+{
+    return fec_payload_;
+}
+
+void uvgrtp::rtp::set_fec_group_size(size_t size)
+{
+    fec_group_size_ = size;
+}
+
+size_t uvgrtp::rtp::get_fec_group_size()
+{
+    return fec_group_size_;
+}
+
+void uvgrtp::rtp::set_playout_delay_min(size_t delay)
+{
+    playout_min_ = delay;
+}
+
+size_t uvgrtp::rtp::get_playout_delay_min()
+{
+    return playout_min_;
+}
+
+void uvgrtp::rtp::set_playout_delay_max(size_t delay)
+{
+    playout_max_ = delay;
+}
+
+size_t uvgrtp::rtp::get_playout_delay_max()
+{
+    return playout_max_;
+}
+
+void uvgrtp::rtp::set_own_ssrc_filter(bool enable)
+{
+    own_ssrc_filter_ = enable;
+}
+
+uint64_t uvgrtp::rtp::get_launch_time()
+{
+    return launch_time_;
+}
+
+uvgrtp::stats *uvgrtp::rtp::get_stats()
+{
+    return &stats_;
+}
+
 rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, uvgrtp::frame::rtp_frame **out)
 {
     (void)flags;
@@ -174,7 +270,11 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
     if (((ptr[0] >> 6) & 0x03) != 0x2)
         return RTP_PKT_NOT_HANDLED;
 
-    if (!(*out = uvgrtp::frame::alloc_rtp_frame()))
+    /* The datagram was received to a pooled receive buffer by the packet dispatcher.
+     * The frame is created inside that buffer and all its fields point to the datagram */
+    auto buffer = uvgrtp::frame::dgram_pool::get_dgram_buffer(packet);
+
+    if (!(*out = uvgrtp::frame::alloc_rtp_frame(buffer)))
         return RTP_GENERIC_ERROR;
 
     (*out)->header.version   = (ptr[0] >> 6) & 0x03;
@@ -201,9 +301,8 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
             (void)uvgrtp::frame::dealloc_frame(*out);
             return RTP_GENERIC_ERROR;
         }
-        LOG_DEBUG("Allocating %u CSRC entries", (*out)->header.cc);
 
-        (*out)->csrc         = new uint32_t[(*out)->header.cc];
+        (*out)->csrc         = buffer->csrc;
         (*out)->payload_len -= (*out)->header.cc * sizeof(uint32_t);
 
         for (size_t i = 0; i < (*out)->header.cc; ++i) {
@@ -214,14 +313,26 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
 
     if ((*out)->header.ext) {
         LOG_DEBUG("Frame contains extension information");
-        (*out)->ext = new uvgrtp::frame::ext_header;
+        (*out)->ext = &buffer->ext;
 
         (*out)->ext->type  = ntohs(*(uint16_t *)&ptr[0]);
         (*out)->ext->len   = ntohs(*(uint32_t *)&ptr[1]);
-        (*out)->ext->data  = (uint8_t *)memdup(ptr + 2 * sizeof(uint16_t), (*out)->ext->len);
-        ptr               += 2 * sizeof(uint16_t) + (*out)->ext->len;
+        (*out)->ext->data  = ptr + 2 * sizeof(uint16_t);
+
+        if ((*out)->payload_len < 2 * sizeof(uint16_t) + (*out)->ext->len) {
+            LOG_DEBUG("Invalid frame length, extension length %u, total length %zu", (*out)->ext->len, (*out)->payload_len);
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            return RTP_GENERIC_ERROR;
+        }
+
+        (*out)->payload_len -= 2 * sizeof(uint16_t) + (*out)->ext->len;
+        ptr                 += 2 * sizeof(uint16_t) + (*out)->ext->len;
     }
 
+    (*out)->payload    = ptr;
+    (*out)->dgram      = (uint8_t *)packet;
+    (*out)->dgram_size = size;
+
     /* If padding is set to 1, the last byte of the payload indicates
      * how many padding bytes was used. Make sure the padding length is
      * valid and subtract the amount of padding bytes from payload length */
@@ -238,9 +349,22 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
         (*out)->padding_len  = padding_len;
     }
 
-    (*out)->payload    = (uint8_t *)memdup(ptr, (*out)->payload_len);
-    (*out)->dgram      = (uint8_t *)packet;
-    (*out)->dgram_size = size;
-
     return RTP_PKT_MODIFIED;
 }
+
+rtp_error_t uvgrtp::rtp::recv_packet_handler(void *arg, int flags, uvgrtp::frame::rtp_frame **out)
+{
+    (void)flags;
+
+    auto rtp = (uvgrtp::rtp *)arg;
+
+    /* A member of a multicast group receives its own packets from the group too if loopback
+     * is enabled. They must not be mistaken for packets of a remote source (RFC 3550 section 8.2) */
+    if (rtp->own_ssrc_filter_ && (*out)->header.ssrc == rtp->ssrc_) {
+        (void)uvgrtp::frame::dealloc_frame(*out);
+        *out = nullptr;
+        return RTP_OK;
+    }
+
+    return RTP_PKT_NOT_HANDLED;
+}
@@ -1,17 +1,18 @@
 #include "debug.hh"
 #include "session.hh"
 
-uvgrtp::session::session(std::string addr):
+uvgrtp::session::session(std::string addr, uvgrtp::reactor *reactor):
 #ifdef __RTP_CRYPTO__
     zrtp_(nullptr),
 #endif
     addr_(addr),
-    laddr_("")
+    laddr_(""),
+    reactor_(reactor)
 {
 }
 
-uvgrtp::session::session(std::string remote_addr, std::string local_addr):
-    session(remote_addr)
+uvgrtp::session::session(std::string remote_addr, std::string local_addr, uvgrtp::reactor *reactor):
+    session(remote_addr, reactor)
 {
     laddr_ = local_addr;
 }
@@ -52,6 +53,8 @@ uvgrtp::media_stream *uvgrtp::session::create_stream(int r_port, int s_port, rtp
         return nullptr;
     }
 
+    stream->set_reactor(reactor_);
+
     if (flags & RCE_SRTP) {
         if (!uvgrtp::crypto::enabled()) {
             LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
@@ -6,6 +6,12 @@
 #include <unistd.h>
 #include <poll.h>
 #include <fcntl.h>
+#include <net/if.h>
+#endif
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #endif
 
 #if defined(__MINGW32__) || defined(__MINGW64__)
@@ -14,17 +20,27 @@ using namespace uvgrtp;
 using namespace mingw;
 #endif
 
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <cassert>
 
+#include "clock.hh"
 #include "debug.hh"
 #include "socket.hh"
 #include "util.hh"
 
 uvgrtp::socket::socket(int flags):
     socket_(-1),
-    flags_(flags)
+    flags_(flags),
+    stats_(nullptr)
 {
+    memset(&addr_, 0, sizeof(addr_));
+
+#ifdef __linux__
+    gso_    = false;
+    txtime_ = false;
+#endif
 }
 
 uvgrtp::socket::~socket()
@@ -38,7 +54,7 @@ uvgrtp::socket::~socket()
 
 rtp_error_t uvgrtp::socket::init(short family, int type, int protocol)
 {
-    assert(family == AF_INET);
+    assert(family == AF_INET || family == AF_INET6);
 
 #ifdef _WIN32
     if ((socket_ = ::socket(family, type, protocol)) == INVALID_SOCKET) {
@@ -50,6 +66,14 @@ rtp_error_t uvgrtp::socket::init(short family, int type, int protocol)
         return RTP_SOCKET_ERROR;
     }
 
+    /* Accept IPv4 traffic (as IPv4-mapped addresses) on IPv6 sockets too */
+    if (family == AF_INET6) {
+        int v6only = 0;
+
+        if (::setsockopt(socket_, IPPROTO_IPV6, IPV6_V6ONLY, (const char *)&v6only, sizeof(v6only)) < 0)
+            LOG_WARN("Failed to make the socket dual-stack, only IPv6 can be used");
+    }
+
 #ifdef _WIN32
     BOOL bNewBehavior     = FALSE;
     DWORD dwBytesReturned = 0;
@@ -57,6 +81,15 @@ rtp_error_t uvgrtp::socket::init(short family, int type, int protocol)
     WSAIoctl(socket_, _WSAIOW(IOC_VENDOR, 12), &bNewBehavior, sizeof(bNewBehavior), NULL, 0, &dwBytesReturned, NULL, NULL);
 #endif
 
+#if defined(__linux__) && defined(UDP_SEGMENT)
+    /* UDP_SEGMENT can be queried only if the kernel supports UDP GSO */
+    int gso_size      = 0;
+    socklen_t gso_len = sizeof(gso_size);
+
+    if (type == SOCK_DGRAM && !(flags_ & RCE_NO_SYSTEM_CALL_CLUSTERING))
+        gso_ = (::getsockopt(socket_, SOL_UDP, UDP_SEGMENT, &gso_size, &gso_len) == 0);
+#endif
+
     return RTP_OK;
 }
 
@@ -72,11 +105,11 @@ rtp_error_t uvgrtp::socket::setsockopt(int level, int optname, const void *optva
 
 rtp_error_t uvgrtp::socket::bind(short family, unsigned host, short port)
 {
-    assert(family == AF_INET);
+    assert(family == AF_INET || family == AF_INET6);
 
-    sockaddr_in addr = create_sockaddr(family, host, port);
+    sockaddr_storage addr = create_sockaddr(family, host, port);
 
-    if (::bind(socket_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    if (::bind(socket_, (struct sockaddr *)&addr, get_sockaddr_len(addr)) < 0) {
 #ifdef _WIN32
         win_get_last_error();
 #else
@@ -89,37 +122,151 @@ rtp_error_t uvgrtp::socket::bind(short family, unsigned host, short port)
     return RTP_OK;
 }
 
-sockaddr_in uvgrtp::socket::create_sockaddr(short family, unsigned host, short port)
+sockaddr_storage uvgrtp::socket::create_sockaddr(short family, unsigned host, short port)
 {
-    assert(family == AF_INET);
+    assert(family == AF_INET || family == AF_INET6);
 
-    sockaddr_in addr;
+    sockaddr_storage addr;
 
     memset(&addr, 0, sizeof(addr));
 
-    addr.sin_family      = family;
-    addr.sin_port        = htons(port);
-    addr.sin_addr.s_addr = htonl(host);
+    if (family == AF_INET6) {
+        sockaddr_in6 *addr6 = (sockaddr_in6 *)&addr;
+
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port   = htons(port);
+        addr6->sin6_addr   = (host == INADDR_LOOPBACK) ? in6addr_loopback : in6addr_any;
+    } else {
+        sockaddr_in *addr4 = (sockaddr_in *)&addr;
+
+        addr4->sin_family      = AF_INET;
+        addr4->sin_port        = htons(port);
+        addr4->sin_addr.s_addr = htonl(host);
+    }
 
     return addr;
 }
 
-sockaddr_in uvgrtp::socket::create_sockaddr(short family, std::string host, short port)
+sockaddr_storage uvgrtp::socket::create_sockaddr(short family, std::string host, short port)
 {
-    assert(family == AF_INET);
+    assert(family == AF_INET || family == AF_INET6);
 
-    sockaddr_in addr;
+    sockaddr_storage addr;
 
     memset(&addr, 0, sizeof(addr));
-    addr.sin_family = family;
 
-    inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
-    addr.sin_port = htons((uint16_t)port);
+    if (family == AF_INET) {
+        sockaddr_in *addr4 = (sockaddr_in *)&addr;
+
+        addr4->sin_family = AF_INET;
+        addr4->sin_port   = htons((uint16_t)port);
+
+        if (inet_pton(AF_INET, host.c_str(), &addr4->sin_addr) != 1)
+            LOG_ERROR("Invalid IPv4 address: %s", host.c_str());
+
+        return addr;
+    }
+
+    sockaddr_in6 *addr6 = (sockaddr_in6 *)&addr;
+    size_t scope        = host.find('%');
+
+    addr6->sin6_family = AF_INET6;
+    addr6->sin6_port   = htons((uint16_t)port);
+
+    /* Link-local addresses need the interface they are reached through,
+     * given either as a name or as an index */
+    if (scope != std::string::npos) {
+        uint32_t index;
+
+        if (get_scope_id(host.substr(scope + 1), &index) != RTP_OK) {
+            memset(&addr, 0, sizeof(addr));
+            return addr;
+        }
+
+        addr6->sin6_scope_id = index;
+        host                 = host.substr(0, scope);
+    }
+
+    if (get_family(host) == AF_INET) {
+        in_addr addr4;
+
+        if (inet_pton(AF_INET, host.c_str(), &addr4) != 1)
+            LOG_ERROR("Invalid IPv4 address: %s", host.c_str());
+
+        /* ::ffff:a.b.c.d */
+        addr6->sin6_addr.s6_addr[10] = 0xff;
+        addr6->sin6_addr.s6_addr[11] = 0xff;
+        memcpy(&addr6->sin6_addr.s6_addr[12], &addr4, sizeof(addr4));
+    } else if (inet_pton(AF_INET6, host.c_str(), &addr6->sin6_addr) != 1) {
+        LOG_ERROR("Invalid IPv6 address: %s", host.c_str());
+    }
 
     return addr;
 }
 
-void uvgrtp::socket::set_sockaddr(sockaddr_in addr)
+rtp_error_t uvgrtp::socket::get_scope_id(std::string scope, uint32_t *index)
+{
+    if (scope.empty()) {
+        LOG_ERROR("The scope of the IPv6 address is empty");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (scope.find_first_not_of("0123456789") == std::string::npos) {
+        char *end;
+
+        errno = 0;
+        unsigned long value = strtoul(scope.c_str(), &end, 10);
+
+        if (errno || *end != '\0' || value > UINT32_MAX) {
+            LOG_ERROR("Invalid interface index: %s", scope.c_str());
+            return RTP_INVALID_VALUE;
+        }
+
+        *index = (uint32_t)value;
+        return RTP_OK;
+    }
+
+#ifndef _WIN32
+    if ((*index = if_nametoindex(scope.c_str())))
+        return RTP_OK;
+
+    LOG_ERROR("Unknown network interface: %s", scope.c_str());
+#else
+    LOG_ERROR("Interface names are not supported, use the index of %s", scope.c_str());
+#endif
+    return RTP_INVALID_VALUE;
+}
+
+short uvgrtp::socket::get_family(std::string host)
+{
+    return (host.find(':') != std::string::npos) ? AF_INET6 : AF_INET;
+}
+
+socklen_t uvgrtp::socket::get_sockaddr_len(const sockaddr_storage& addr)
+{
+    return (addr.ss_family == AF_INET6) ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+}
+
+bool uvgrtp::socket::sockaddr_equal(const sockaddr_storage& a, const sockaddr_storage& b)
+{
+    if (a.ss_family != b.ss_family)
+        return false;
+
+    if (a.ss_family == AF_INET6) {
+        auto a6 = (const sockaddr_in6 *)&a;
+        auto b6 = (const sockaddr_in6 *)&b;
+
+        return a6->sin6_port == b6->sin6_port &&
+               !memcmp(&a6->sin6_addr, &b6->sin6_addr, sizeof(a6->sin6_addr));
+    }
+
+    auto a4 = (const sockaddr_in *)&a;
+    auto b4 = (const sockaddr_in *)&b;
+
+    return a4->sin_port == b4->sin_port && a4->sin_addr.s_addr == b4->sin_addr.s_addr;
+}
+
+void uvgrtp::socket::set_sockaddr(sockaddr_storage addr)
 {
     addr_ = addr;
 }
@@ -145,26 +292,57 @@ rtp_error_t uvgrtp::socket::install_handler(void *arg, packet_handler_vec handle
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::__sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent)
+void uvgrtp::socket::set_stats(uvgrtp::stats *stats)
+{
+    stats_ = stats;
+}
+
+rtp_error_t uvgrtp::socket::__sendto(sockaddr_storage& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent, uint64_t launch_time)
 {
     int nsend = 0;
 
 #ifdef __linux__
-    if ((nsend = ::sendto(socket_, buf, buf_len, flags, (const struct sockaddr *)&addr, sizeof(addr_))) == -1) {
+    if (launch_time && txtime_) {
+        char ctrl[CMSG_SPACE(sizeof(uint64_t))];
+        struct iovec iov;
+        struct msghdr hdr;
+
+        iov.iov_base = buf;
+        iov.iov_len  = buf_len;
+
+        hdr.msg_name       = (void *)&addr;
+        hdr.msg_namelen    = get_sockaddr_len(addr);
+        hdr.msg_iov        = &iov;
+        hdr.msg_iovlen     = 1;
+        hdr.msg_control    = ctrl;
+        hdr.msg_controllen = set_txtime_cmsg(ctrl, launch_time);
+        hdr.msg_flags      = 0;
+
+        nsend = ::sendmsg(socket_, &hdr, flags);
+    } else {
+        nsend = ::sendto(socket_, buf, buf_len, flags, (const struct sockaddr *)&addr, get_sockaddr_len(addr));
+    }
+
+    if (nsend == -1) {
         LOG_ERROR("Failed to send data: %s", strerror(errno));
 
         if (bytes_sent)
             *bytes_sent = -1;
         return RTP_SEND_ERROR;
     }
+
+    if (launch_time && txtime_)
+        drain_txtime_errors();
 #else
+    (void)launch_time;
+
     DWORD sent_bytes;
     WSABUF data_buf;
 
     data_buf.buf = (char *)buf;
     data_buf.len = buf_len;
 
-    if (WSASendTo(socket_, &data_buf, 1, &sent_bytes, flags, (const struct sockaddr *)&addr, sizeof(addr_), nullptr, nullptr) == -1) {
+    if (WSASendTo(socket_, &data_buf, 1, &sent_bytes, flags, (const struct sockaddr *)&addr, get_sockaddr_len(addr), nullptr, nullptr) == -1) {
         win_get_last_error();
 
         if (bytes_sent)
@@ -174,6 +352,9 @@ rtp_error_t uvgrtp::socket::__sendto(sockaddr_in& addr, uint8_t *buf, size_t buf
     nsend = sent_bytes;
 #endif
 
+    if (stats_)
+        stats_->add_send(1, nsend);
+
     if (bytes_sent)
         *bytes_sent = nsend;
 
@@ -182,26 +363,26 @@ rtp_error_t uvgrtp::socket::__sendto(sockaddr_in& addr, uint8_t *buf, size_t buf
 
 rtp_error_t uvgrtp::socket::sendto(uint8_t *buf, size_t buf_len, int flags)
 {
-    return __sendto(addr_, buf, buf_len, flags, nullptr);
+    return __sendto(addr_, buf, buf_len, flags, nullptr, 0);
 }
 
 rtp_error_t uvgrtp::socket::sendto(uint8_t *buf, size_t buf_len, int flags, int *bytes_sent)
 {
-    return __sendto(addr_, buf, buf_len, flags, bytes_sent);
+    return __sendto(addr_, buf, buf_len, flags, bytes_sent, 0);
 }
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent)
+rtp_error_t uvgrtp::socket::sendto(sockaddr_storage& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent)
 {
-    return __sendto(addr, buf, buf_len, flags, bytes_sent);
+    return __sendto(addr, buf, buf_len, flags, bytes_sent, 0);
 }
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags)
+rtp_error_t uvgrtp::socket::sendto(sockaddr_storage& addr, uint8_t *buf, size_t buf_len, int flags)
 {
-    return __sendto(addr, buf, buf_len, flags, nullptr);
+    return __sendto(addr, buf, buf_len, flags, nullptr, 0);
 }
 
 rtp_error_t uvgrtp::socket::__sendtov(
-    sockaddr_in& addr,
+    sockaddr_storage& addr,
     uvgrtp::buf_vec& buffers,
     int flags, int *bytes_sent
 )
@@ -217,7 +398,7 @@ rtp_error_t uvgrtp::socket::__sendtov(
     }
 
     header_.msg_hdr.msg_name       = (void *)&addr;
-    header_.msg_hdr.msg_namelen    = sizeof(addr);
+    header_.msg_hdr.msg_namelen    = get_sockaddr_len(addr);
     header_.msg_hdr.msg_iov        = chunks_;
     header_.msg_hdr.msg_iovlen     = buffers.size();
     header_.msg_hdr.msg_control    = 0;
@@ -229,6 +410,9 @@ rtp_error_t uvgrtp::socket::__sendtov(
         return RTP_SEND_ERROR;
     }
 
+    if (stats_)
+        stats_->add_send(1, sent_bytes);
+
     set_bytes(bytes_sent, sent_bytes);
     return RTP_OK;
 
@@ -241,13 +425,16 @@ rtp_error_t uvgrtp::socket::__sendtov(
         buffers_[i].buf = (char *)buffers.at(i).second;
     }
 
-    if (WSASendTo(socket_, buffers_, buffers.size(), &sent_bytes, flags, (SOCKADDR *)&addr, sizeof(addr_), nullptr, nullptr) == -1) {
+    if (WSASendTo(socket_, buffers_, buffers.size(), &sent_bytes, flags, (SOCKADDR *)&addr, get_sockaddr_len(addr), nullptr, nullptr) == -1) {
         win_get_last_error();
 
         set_bytes(bytes_sent, -1);
         return RTP_SEND_ERROR;
     }
 
+    if (stats_)
+        stats_->add_send(1, sent_bytes);
+
     set_bytes(bytes_sent, sent_bytes);
     return RTP_OK;
 #endif
@@ -281,7 +468,7 @@ rtp_error_t uvgrtp::socket::sendto(buf_vec& buffers, int flags, int *bytes_sent)
     return __sendtov(addr_, buffers, flags, bytes_sent);
 }
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, buf_vec& buffers, int flags)
+rtp_error_t uvgrtp::socket::sendto(sockaddr_storage& addr, buf_vec& buffers, int flags)
 {
     rtp_error_t ret;
 
@@ -296,7 +483,7 @@ rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, buf_vec& buffers, int flag
 }
 
 rtp_error_t uvgrtp::socket::sendto(
-    sockaddr_in& addr,
+    sockaddr_storage& addr,
     buf_vec& buffers,
     int flags, int *bytes_sent
 )
@@ -315,61 +502,164 @@ rtp_error_t uvgrtp::socket::sendto(
 }
 
 rtp_error_t uvgrtp::socket::__sendtov(
-    sockaddr_in& addr,
+    sockaddr_storage& addr,
     uvgrtp::pkt_vec& buffers,
-    int flags, int *bytes_sent
+    int flags, int *bytes_sent, uint64_t launch_time
 )
 {
 #ifdef __linux__
     int sent_bytes = 0;
-    struct mmsghdr *hptr, *headers;
-
-    if (!(hptr = headers = new struct mmsghdr[buffers.size()])) {
-        LOG_ERROR("Failed to allocate space for struct mmsghdr!");
-        return RTP_MEMORY_ERROR;
+    size_t nhdrs   = 0;
+    size_t niovs   = 0;
+    size_t nsent   = 0;
+    size_t sent    = 0;
+    const size_t ctrl_len = CMSG_SPACE(sizeof(uint16_t)) + CMSG_SPACE(sizeof(uint64_t));
+
+    for (auto& buffer : buffers)
+        niovs += buffer.size();
+
+    /* There is never more than one header per packet so these are large enough
+     * for any grouping of the packets. The vectors are grown before they are filled
+     * so the pointers taken below stay valid */
+    if (send_hdrs_.size() < buffers.size()) {
+        send_hdrs_.resize(buffers.size());
+        send_segs_.resize(buffers.size());
+        send_ctrl_.resize(buffers.size() * ctrl_len);
     }
 
-    for (size_t i = 0; i < buffers.size(); ++i) {
-        headers[i].msg_hdr.msg_iov        = new struct iovec[buffers[i].size()];
-        headers[i].msg_hdr.msg_iovlen     = buffers[i].size();
-        headers[i].msg_hdr.msg_name       = (void *)&addr;
-        headers[i].msg_hdr.msg_namelen    = sizeof(addr);
-        headers[i].msg_hdr.msg_control    = 0;
-        headers[i].msg_hdr.msg_controllen = 0;
-
-        for (size_t k = 0; k < buffers[i].size(); ++k) {
-            headers[i].msg_hdr.msg_iov[k].iov_len   = buffers[i][k].first;
-            headers[i].msg_hdr.msg_iov[k].iov_base  = buffers[i][k].second;
-            sent_bytes                             += buffers[i][k].first;
+    if (send_iovs_.size() < niovs)
+        send_iovs_.resize(niovs);
+
+    niovs = 0;
+
+    for (size_t i = 0; i < buffers.size(); ) {
+        size_t nsegs    = 1;
+        size_t seg_size = 0;
+        size_t total    = 0;
+
+        for (auto& chunk : buffers[i])
+            seg_size += chunk.first;
+
+        total = seg_size;
+
+        /* Group the following packets with packet "i" as long as they are as large as it.
+         * The last segment of a GSO packet may be shorter than the segment size */
+        while (gso_ && i + nsegs < buffers.size() && nsegs < (size_t)GSO_MAX_SEGMENTS) {
+            size_t len = 0;
+
+            for (auto& chunk : buffers[i + nsegs])
+                len += chunk.first;
+
+            if (len > seg_size || total + len > (size_t)GSO_MAX_SIZE)
+                break;
+
+            total += len;
+            nsegs++;
+
+            if (len < seg_size)
+                break;
+        }
+
+        struct msghdr& hdr = send_hdrs_[nhdrs].msg_hdr;
+
+        hdr.msg_name       = (void *)&addr;
+        hdr.msg_namelen    = get_sockaddr_len(addr);
+        hdr.msg_iov        = &send_iovs_[niovs];
+        hdr.msg_iovlen     = 0;
+        hdr.msg_control    = &send_ctrl_[nhdrs * ctrl_len];
+        hdr.msg_controllen = 0;
+        hdr.msg_flags      = 0;
+
+        for (size_t k = i; k < i + nsegs; ++k) {
+            for (auto& chunk : buffers[k]) {
+                send_iovs_[niovs].iov_len  = chunk.first;
+                send_iovs_[niovs].iov_base = chunk.second;
+                niovs++;
+                hdr.msg_iovlen++;
+            }
+        }
+
+#ifdef UDP_SEGMENT
+        if (nsegs > 1) {
+            struct cmsghdr *cmsg = (struct cmsghdr *)((char *)hdr.msg_control + hdr.msg_controllen);
+
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type  = UDP_SEGMENT;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+            *(uint16_t *)CMSG_DATA(cmsg) = (uint16_t)seg_size;
+
+            hdr.msg_controllen += CMSG_SPACE(sizeof(uint16_t));
         }
+#endif
+
+        if (launch_time && txtime_)
+            hdr.msg_controllen += set_txtime_cmsg((char *)hdr.msg_control + hdr.msg_controllen, launch_time);
+
+        if (!hdr.msg_controllen)
+            hdr.msg_control = nullptr;
+
+        send_segs_[nhdrs++] = nsegs;
+        sent_bytes         += total;
+        i                  += nsegs;
     }
 
     ssize_t npkts = (flags_ & RCE_NO_SYSTEM_CALL_CLUSTERING) ? 1 : 1024;
-    ssize_t bptr  = buffers.size();
 
-    while (bptr > npkts) {
-        if (sendmmsg(socket_, hptr, npkts, flags) < 0) {
+    /* sendmmsg(2) may send fewer messages than it was given so keep calling it
+     * until all headers have been sent */
+    while (sent < nhdrs) {
+        int ret = sendmmsg(socket_, &send_hdrs_[sent], std::min((ssize_t)(nhdrs - sent), npkts), flags);
+
+        if (ret < 0) {
+            /* The outgoing interface cannot segment the packet (f.ex. no checksum offload
+             * or segment larger than MTU), disable GSO and send the remaining packets one by one */
+            if (gso_ && send_segs_[sent] > 1 && (errno == EIO || errno == EINVAL)) {
+                LOG_WARN("UDP GSO is not supported by the outgoing interface, disabling it");
+                gso_ = false;
+
+                uvgrtp::pkt_vec rest(buffers.begin() + nsent, buffers.end());
+                int rest_bytes = 0;
+
+                if (__sendtov(addr, rest, flags, &rest_bytes, launch_time) != RTP_OK) {
+                    set_bytes(bytes_sent, -1);
+                    return RTP_SEND_ERROR;
+                }
+
+                set_bytes(bytes_sent, sent_bytes);
+                return RTP_OK;
+            }
+
             log_platform_error("sendmmsg(2) failed");
+            set_bytes(bytes_sent, -1);
             return RTP_SEND_ERROR;
         }
 
-        bptr -= npkts;
-        hptr += npkts;
-    }
+        size_t batch_pkts  = 0;
+        size_t batch_bytes = 0;
 
-    if (sendmmsg(socket_, hptr, bptr, flags) < 0) {
-        log_platform_error("sendmmsg(2) failed");
-        return RTP_SEND_ERROR;
+        for (int k = 0; k < ret; ++k) {
+            batch_pkts += send_segs_[sent + k];
+
+            for (size_t j = 0; j < send_hdrs_[sent + k].msg_hdr.msg_iovlen; ++j)
+                batch_bytes += send_hdrs_[sent + k].msg_hdr.msg_iov[j].iov_len;
+        }
+
+        if (stats_)
+            stats_->add_send(batch_pkts, batch_bytes);
+
+        nsent += batch_pkts;
+        sent  += ret;
     }
 
-    for (size_t i = 0; i < buffers.size(); ++i)
-        delete[] headers[i].msg_hdr.msg_iov;
-    delete[] headers;
+    if (launch_time && txtime_)
+        drain_txtime_errors();
 
     set_bytes(bytes_sent, sent_bytes);
     return RTP_OK;
 
 #else
+    (void)launch_time;
+
     INT ret;
     DWORD sent_bytes;
     WSABUF wsa_bufs[16];
@@ -389,7 +679,7 @@ send_:
             &sent_bytes,
             flags,
             (SOCKADDR *)&addr,
-            sizeof(addr_),
+            get_sockaddr_len(addr),
             nullptr,
             nullptr
         );
@@ -402,6 +692,8 @@ send_:
             return RTP_SEND_ERROR;
         }
 
+        if (stats_)
+            stats_->add_send(1, sent_bytes);
     }
     set_bytes(bytes_sent, sent_bytes);
     return RTP_OK;
@@ -421,7 +713,7 @@ rtp_error_t uvgrtp::socket::sendto(pkt_vec& buffers, int flags)
         }
     }
 
-    return __sendtov(addr_, buffers, flags, nullptr);
+    return __sendtov(addr_, buffers, flags, nullptr, 0);
 }
 
 rtp_error_t uvgrtp::socket::sendto(pkt_vec& buffers, int flags, int *bytes_sent)
@@ -437,10 +729,10 @@ rtp_error_t uvgrtp::socket::sendto(pkt_vec& buffers, int flags, int *bytes_sent)
         }
     }
 
-    return __sendtov(addr_, buffers, flags, bytes_sent);
+    return __sendtov(addr_, buffers, flags, bytes_sent, 0);
 }
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, pkt_vec& buffers, int flags)
+rtp_error_t uvgrtp::socket::sendto(sockaddr_storage& addr, pkt_vec& buffers, int flags)
 {
     rtp_error_t ret;
 
@@ -453,10 +745,10 @@ rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, pkt_vec& buffers, int flag
         }
     }
 
-    return __sendtov(addr, buffers, flags, nullptr);
+    return __sendtov(addr, buffers, flags, nullptr, 0);
 }
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, pkt_vec& buffers, int flags, int *bytes_sent)
+rtp_error_t uvgrtp::socket::sendto(sockaddr_storage& addr, pkt_vec& buffers, int flags, int *bytes_sent)
 {
     rtp_error_t ret;
 
@@ -469,7 +761,28 @@ rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, pkt_vec& buffers, int flag
         }
     }
 
-    return __sendtov(addr, buffers, flags, bytes_sent);
+    return __sendtov(addr, buffers, flags, bytes_sent, 0);
+}
+
+rtp_error_t uvgrtp::socket::sendto_at(uint8_t *buf, size_t buf_len, int flags, uint64_t launch_time)
+{
+    return __sendto(addr_, buf, buf_len, flags, nullptr, launch_time);
+}
+
+rtp_error_t uvgrtp::socket::sendto_at(pkt_vec& buffers, int flags, uint64_t launch_time)
+{
+    rtp_error_t ret;
+
+    for (auto& buffer : buffers) {
+        for (auto& handler : vec_handlers_) {
+            if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
+                LOG_ERROR("Malformed packet");
+                return ret;
+            }
+        }
+    }
+
+    return __sendtov(addr_, buffers, flags, nullptr, launch_time);
 }
 
 rtp_error_t uvgrtp::socket::__recv(uint8_t *buf, size_t buf_len, int flags, int *bytes_read)
@@ -531,10 +844,10 @@ rtp_error_t uvgrtp::socket::recv(uint8_t *buf, size_t buf_len, int flags, int *b
     return uvgrtp::socket::__recv(buf, buf_len, flags, bytes_read);
 }
 
-rtp_error_t uvgrtp::socket::__recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_in *sender, int *bytes_read)
+rtp_error_t uvgrtp::socket::__recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_storage *sender, int *bytes_read)
 {
     socklen_t *len_ptr = nullptr;
-    socklen_t len      = sizeof(sockaddr_in);
+    socklen_t len      = sizeof(sockaddr_storage);
 
     if (sender)
         len_ptr = &len;
@@ -578,7 +891,7 @@ rtp_error_t uvgrtp::socket::__recvfrom(uint8_t *buf, size_t buf_len, int flags,
 #endif
 }
 
-rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_in *sender, int *bytes_read)
+rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_storage *sender, int *bytes_read)
 {
     return __recvfrom(buf, buf_len, flags, sender, bytes_read);
 }
@@ -588,7 +901,7 @@ rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int flags, in
     return __recvfrom(buf, buf_len, flags, nullptr, bytes_read);
 }
 
-rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_in *sender)
+rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_storage *sender)
 {
     return __recvfrom(buf, buf_len, flags, sender, nullptr);
 }
@@ -598,7 +911,153 @@ rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int flags)
     return __recvfrom(buf, buf_len, flags, nullptr, nullptr);
 }
 
-sockaddr_in& uvgrtp::socket::get_out_address()
+#ifdef __linux__
+rtp_error_t uvgrtp::socket::recvmmsg(struct mmsghdr *hdrs, unsigned vlen, int flags, int *msgs_read)
+{
+    if (!hdrs || !vlen) {
+        set_bytes(msgs_read, -1);
+        return RTP_INVALID_VALUE;
+    }
+
+    int ret = ::recvmmsg(socket_, hdrs, vlen, flags, nullptr);
+
+    if (ret == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            set_bytes(msgs_read, 0);
+            return RTP_INTERRUPTED;
+        }
+        LOG_ERROR("recvmmsg(2) failed: %s", strerror(errno));
+
+        set_bytes(msgs_read, -1);
+        return RTP_GENERIC_ERROR;
+    }
+
+    set_bytes(msgs_read, ret);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::socket::enable_rx_timestamps()
+{
+    int ts_flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+
+    if (::setsockopt(socket_, SOL_SOCKET, SO_TIMESTAMPING, &ts_flags, sizeof(ts_flags)) == 0)
+        return RTP_OK;
+
+    int enable = 1;
+
+    if (::setsockopt(socket_, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0)
+        return RTP_OK;
+
+    LOG_WARN("Failed to enable receive timestamps: %s", strerror(errno));
+    return RTP_GENERIC_ERROR;
+}
+
+uint64_t uvgrtp::socket::get_rx_timestamp(struct msghdr *hdr)
+{
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+
+        /* SCM_TIMESTAMPING carries the software timestamp (CLOCK_REALTIME) in the first entry.
+         * The third entry is the raw time of the NIC's clock which is not synchronized
+         * with the wall clock so it cannot be compared with our NTP timestamps */
+        if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            struct timespec ts[3];
+
+            memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+
+            if (ts[0].tv_sec || ts[0].tv_nsec)
+                return uvgrtp::clock::ntp::from_timespec(ts[0]);
+        }
+
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return uvgrtp::clock::ntp::from_timespec(ts);
+        }
+    }
+
+    return 0;
+}
+
+rtp_error_t uvgrtp::socket::enable_txtime(int clock)
+{
+#ifdef SO_TXTIME
+    struct sock_txtime txtime;
+
+    txtime.clockid = clock;
+    txtime.flags   = SOF_TXTIME_REPORT_ERRORS;
+
+    if (::setsockopt(socket_, SOL_SOCKET, SO_TXTIME, &txtime, sizeof(txtime)) == 0) {
+        txtime_ = true;
+        return RTP_OK;
+    }
+
+    LOG_ERROR("Failed to enable SO_TXTIME: %s", strerror(errno));
+#else
+    (void)clock;
+    LOG_ERROR("SO_TXTIME is not supported by the system headers");
+#endif
+    return RTP_GENERIC_ERROR;
+}
+
+size_t uvgrtp::socket::set_txtime_cmsg(char *ctrl, uint64_t launch_time)
+{
+#ifdef SO_TXTIME
+    struct cmsghdr *cmsg = (struct cmsghdr *)ctrl;
+
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_TXTIME;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(uint64_t));
+    memcpy(CMSG_DATA(cmsg), &launch_time, sizeof(uint64_t));
+
+    return CMSG_SPACE(sizeof(uint64_t));
+#else
+    (void)ctrl, (void)launch_time;
+    return 0;
+#endif
+}
+
+void uvgrtp::socket::drain_txtime_errors()
+{
+#ifdef SO_EE_ORIGIN_TXTIME
+    char ctrl[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(sockaddr_storage))];
+    struct msghdr hdr;
+
+    for (;;) {
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_control    = ctrl;
+        hdr.msg_controllen = sizeof(ctrl);
+
+        /* the dropped packet itself is not needed, only the error that comes with it */
+        if (::recvmsg(socket_, &hdr, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            return;
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if (!(cmsg->cmsg_level == SOL_IP   && cmsg->cmsg_type == IP_RECVERR) &&
+                !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+                continue;
+
+            struct sock_extended_err err;
+
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+
+            if (err.ee_origin != SO_EE_ORIGIN_TXTIME)
+                continue;
+
+            LOG_DEBUG("Packet dropped by the qdisc, %s launch time",
+                err.ee_code == SO_EE_CODE_TXTIME_MISSED ? "missed" : "invalid");
+
+            if (stats_)
+                stats_->add_txtime_error();
+        }
+    }
+#endif
+}
+#endif
+
+sockaddr_storage& uvgrtp::socket::get_out_address()
 {
     return addr_;
 }
@@ -7,12 +7,25 @@
 uvgrtp::base_srtp::base_srtp():
     srtp_ctx_(new uvgrtp::srtp_ctx_t),
     use_null_cipher_(false),
-    authenticate_rtp_(false)
+    authenticate_rtp_(false),
+    use_aead_(false),
+    local_ctr_(nullptr),
+    remote_ctr_(nullptr),
+    local_hmac_(nullptr),
+    remote_hmac_(nullptr),
+    local_gcm_(nullptr),
+    remote_gcm_(nullptr)
 {
 }
 
 uvgrtp::base_srtp::~base_srtp()
 {
+    delete local_ctr_;
+    delete remote_ctr_;
+    delete local_hmac_;
+    delete remote_hmac_;
+    delete local_gcm_;
+    delete remote_gcm_;
 }
 
 bool uvgrtp::base_srtp::use_null_cipher()
@@ -25,6 +38,22 @@ bool uvgrtp::base_srtp::authenticate_rtp()
     return authenticate_rtp_;
 }
 
+bool uvgrtp::base_srtp::use_aead()
+{
+    return use_aead_;
+}
+
+size_t uvgrtp::base_srtp::get_tag_length(int flags)
+{
+    if ((flags & (RCE_SRTP | RCE_SRTP_AEAD_AES_128_GCM)) == (RCE_SRTP | RCE_SRTP_AEAD_AES_128_GCM))
+        return GCM_TAG_LENGTH;
+
+    if (flags & RCE_SRTP_AUTHENTICATE_RTP)
+        return AUTH_TAG_LENGTH;
+
+    return 0;
+}
+
 uvgrtp::srtp_ctx_t *uvgrtp::base_srtp::get_ctx()
 {
     return srtp_ctx_;
@@ -65,20 +94,83 @@ rtp_error_t uvgrtp::base_srtp::create_iv(uint8_t *out, uint32_t ssrc, uint64_t i
     return RTP_OK;
 }
 
-bool uvgrtp::base_srtp::is_replayed_packet(uint8_t *digest)
+rtp_error_t uvgrtp::base_srtp::create_gcm_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt)
+{
+    if (!out || !salt)
+        return RTP_INVALID_VALUE;
+
+    /* 00 00 || SSRC || ROC || SEQ, XORed with the salt (RFC 7714, section 8.1)
+     *
+     * F.ex. the test vector of RFC 7714, section 16.1.1: SSRC 0x5501a0b2, ROC 0,
+     * SEQ 0xf17b and salt 51 75 69 64 20 70 72 6f 20 71 75 6f give the IV
+     * 51 75 3c 65 80 c2 72 6f 20 71 84 14 */
+    uint32_t roc = htonl((uint32_t)(index >> 16));
+    uint16_t seq = htons((uint16_t)index);
+
+    ssrc = htonl(ssrc);
+
+    memset(out, 0, GCM_IV_LENGTH);
+    memcpy(&out[2],  &ssrc, sizeof(uint32_t));
+    memcpy(&out[6],  &roc,  sizeof(uint32_t));
+    memcpy(&out[10], &seq,  sizeof(uint16_t));
+
+    for (int i = 0; i < GCM_IV_LENGTH; i++)
+        out[i] ^= salt[i];
+
+    return RTP_OK;
+}
+
+static void __set_replay_bit(uint64_t *window, uint64_t index, bool set)
+{
+    uint64_t bit = index % REPLAY_WINDOW_SIZE;
+
+    if (set)
+        window[bit / 64] |= (1ULL << (bit % 64));
+    else
+        window[bit / 64] &= ~(1ULL << (bit % 64));
+}
+
+bool uvgrtp::base_srtp::is_replayed_packet(uint64_t index)
 {
     if (!(srtp_ctx_->flags & RCE_SRTP_REPLAY_PROTECTION))
         return false;
 
-    uint64_t truncated;
-    memcpy(&truncated, digest, sizeof(uint64_t));
+    /* first packet of the session */
+    if (!srtp_ctx_->replay_init) {
+        srtp_ctx_->s_l         = index;
+        srtp_ctx_->replay_init = true;
+        __set_replay_bit(srtp_ctx_->replay, index, true);
+        return false;
+    }
+
+    /* newer than any packet so far, slide the window forward
+     * and forget the packets that fall out of it */
+    if (index > srtp_ctx_->s_l) {
+        uint64_t delta = index - srtp_ctx_->s_l;
 
-    if (replay_list_.find(truncated) != replay_list_.end()) {
-        LOG_ERROR("Replayed packet received, discarding!");
+        if (delta >= REPLAY_WINDOW_SIZE) {
+            memset(srtp_ctx_->replay, 0, sizeof(srtp_ctx_->replay));
+        } else {
+            for (uint64_t i = srtp_ctx_->s_l + 1; i < index; ++i)
+                __set_replay_bit(srtp_ctx_->replay, i, false);
+        }
+
+        __set_replay_bit(srtp_ctx_->replay, index, true);
+        srtp_ctx_->s_l = index;
+        return false;
+    }
+
+    if (srtp_ctx_->s_l - index >= REPLAY_WINDOW_SIZE) {
+        LOG_DEBUG("Packet %llu is older than the replay window", (unsigned long long)index);
         return true;
     }
 
-    replay_list_.insert(truncated);
+    uint64_t bit = index % REPLAY_WINDOW_SIZE;
+
+    if (srtp_ctx_->replay[bit / 64] & (1ULL << (bit % 64)))
+        return true;
+
+    __set_replay_bit(srtp_ctx_->replay, index, true);
     return false;
 }
 
@@ -101,11 +193,24 @@ rtp_error_t uvgrtp::base_srtp::init(int type, int flags)
     srtp_ctx_->n_e = AES_KEY_LENGTH;
     srtp_ctx_->n_a = HMAC_KEY_LENGTH;
 
-    srtp_ctx_->s_l    = 0;
-    srtp_ctx_->replay = nullptr;
+    srtp_ctx_->s_l         = 0;
+    srtp_ctx_->replay_init = false;
+    memset(srtp_ctx_->replay, 0, sizeof(srtp_ctx_->replay));
 
     use_null_cipher_  = !!(flags & RCE_SRTP_NULL_CIPHER);
     authenticate_rtp_ = !!(flags & RCE_SRTP_AUTHENTICATE_RTP);
+    use_aead_         = type == SRTP && !!(flags & RCE_SRTP_AEAD_AES_128_GCM);
+
+    if (use_aead_) {
+        if (use_null_cipher_) {
+            LOG_ERROR("RCE_SRTP_AEAD_AES_128_GCM cannot be used with RCE_SRTP_NULL_CIPHER");
+            return RTP_INVALID_VALUE;
+        }
+
+        /* the GCM tag replaces the HMAC-SHA1 tag */
+        authenticate_rtp_ = false;
+        srtp_ctx_->enc    = AES_128_GCM;
+    }
 
     srtp_ctx_->flags  = flags;
 
@@ -169,6 +274,24 @@ rtp_error_t uvgrtp::base_srtp::init(int type, int flags)
         SALT_LENGTH
     );
 
+    /* SRTCP packets are few and they may be sent from both the application
+     * and the RTCP thread so srtcp keys its cipher and MAC per packet */
+    if (type != SRTP)
+        return RTP_OK;
+
+    if (use_aead_) {
+        local_gcm_  = new uvgrtp::crypto::aes::gcm(srtp_ctx_->key_ctx.local.enc_key,  AES_KEY_LENGTH);
+        remote_gcm_ = new uvgrtp::crypto::aes::gcm(srtp_ctx_->key_ctx.remote.enc_key, AES_KEY_LENGTH);
+        return RTP_OK;
+    }
+
+    uint8_t iv[AES_KEY_LENGTH] = { 0 };
+
+    local_ctr_   = new uvgrtp::crypto::aes::ctr(srtp_ctx_->key_ctx.local.enc_key,  AES_KEY_LENGTH, iv);
+    remote_ctr_  = new uvgrtp::crypto::aes::ctr(srtp_ctx_->key_ctx.remote.enc_key, AES_KEY_LENGTH, iv);
+    local_hmac_  = new uvgrtp::crypto::hmac::sha1(srtp_ctx_->key_ctx.local.auth_key,  AES_KEY_LENGTH);
+    remote_hmac_ = new uvgrtp::crypto::hmac::sha1(srtp_ctx_->key_ctx.remote.auth_key, AES_KEY_LENGTH);
+
     return RTP_OK;
 }
 
@@ -12,14 +12,14 @@ uvgrtp::srtcp::~srtcp()
 {
 }
 
-rtp_error_t uvgrtp::srtcp::encrypt(uint32_t ssrc, uint16_t seq, uint8_t *buffer, size_t len)
+rtp_error_t uvgrtp::srtcp::encrypt(uint32_t ssrc, uint32_t index, uint8_t *buffer, size_t len)
 {
     if (use_null_cipher_)
         return RTP_OK;
 
     uint8_t iv[16] = { 0 };
 
-    if (create_iv(iv, ssrc, seq, srtp_ctx_->key_ctx.local.salt_key) != RTP_OK) {
+    if (create_iv(iv, ssrc, index, srtp_ctx_->key_ctx.local.salt_key) != RTP_OK) {
         LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
         return RTP_INVALID_VALUE;
     }
@@ -55,7 +55,10 @@ rtp_error_t uvgrtp::srtcp::verify_auth_tag(uint8_t *buffer, size_t len)
         return RTP_AUTH_TAG_MISMATCH;
     }
 
-    if (is_replayed_packet(digest)) {
+    /* the E flag is not part of the SRTCP index */
+    uint32_t index = *(uint32_t *)&buffer[len - AUTH_TAG_LENGTH - SRTCP_INDEX_LENGTH] & 0x7fffffff;
+
+    if (is_replayed_packet(index)) {
         LOG_ERROR("Replayed packet received, discarding!");
         return RTP_INVALID_VALUE;
     }
@@ -63,11 +66,11 @@ rtp_error_t uvgrtp::srtcp::verify_auth_tag(uint8_t *buffer, size_t len)
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::srtcp::decrypt(uint32_t ssrc, uint32_t seq, uint8_t *buffer, size_t size)
+rtp_error_t uvgrtp::srtcp::decrypt(uint32_t ssrc, uint32_t index, uint8_t *buffer, size_t size)
 {
     uint8_t iv[16]  = { 0 };
 
-    if (create_iv(iv, ssrc, seq, srtp_ctx_->key_ctx.remote.salt_key) != RTP_OK) {
+    if (create_iv(iv, ssrc, index, srtp_ctx_->key_ctx.remote.salt_key) != RTP_OK) {
         LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
         return RTP_INVALID_VALUE;
     }
@@ -15,29 +15,87 @@ uvgrtp::srtp::~srtp()
 {
 }
 
-rtp_error_t uvgrtp::srtp::encrypt(uint32_t ssrc, uint16_t seq, uint8_t *buffer, size_t len)
+uint64_t uvgrtp::srtp::get_send_index(uint16_t seq)
 {
-    if (use_null_cipher_)
-        return RTP_OK;
-
-    uint8_t iv[16] = { 0 };
     uint64_t index = (((uint64_t)srtp_ctx_->roc) << 16) + seq;
 
     /* Sequence number has wrapped around, update Roll-over Counter */
     if (seq == 0xffff)
         srtp_ctx_->roc++;
 
+    return index;
+}
+
+uint64_t uvgrtp::srtp::estimate_recv_index(uint16_t seq, uint32_t ts)
+{
+    uint64_t index = 0;
+
+    /* as the sequence number approaches 0xffff and is close to wrapping around,
+     * special care must be taken to use correct roll-over counter as it's entirely
+     * possible that packets come out of order around this overflow boundary
+     * and if e.g. we first receive packet with sequence number 0xffff and thus update
+     * ROC to ROC + 1 and after that we receive packet with sequence number 0xfffe,
+     * we use an incorrect value for ROC as the the packet 0xfffe was encrypted with ROC - 1.
+     *
+     * It is a reasonable assumption that correct ROC differs from "ctx->roc" at most by 1 (-, +)
+     * because if the difference is more than 1, the input frame would be larger than 90 MB.
+     *
+     * Here the assumption is that the offset for an incorrectly ordered packet is at most 10k */
+    if (ts == srtp_ctx_->rts && seq + MAX_OFF < MAX_OFF)
+        index = (((uint64_t)srtp_ctx_->roc - 1) << 16) + seq;
+    else
+        index = (((uint64_t)srtp_ctx_->roc) << 16) + seq;
+
+    return index;
+}
+
+uint64_t uvgrtp::srtp::get_recv_index(uint16_t seq, uint32_t ts)
+{
+    uint64_t index = estimate_recv_index(seq, ts);
+
+    /* Sequence number has wrapped around, update Roll-over Counter */
+    if (seq == 0xffff) {
+        srtp_ctx_->roc++;
+        srtp_ctx_->rts = ts;
+    }
+
+    return index;
+}
+
+rtp_error_t uvgrtp::srtp::encrypt(uint32_t ssrc, uint16_t seq, uint8_t *buffer, size_t len)
+{
+    if (use_null_cipher_)
+        return RTP_OK;
+
+    uint8_t iv[16] = { 0 };
+    uint64_t index = get_send_index(seq);
+
     if (create_iv(iv, ssrc, index, srtp_ctx_->key_ctx.local.salt_key) != RTP_OK) {
         LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(srtp_ctx_->key_ctx.local.enc_key, sizeof(srtp_ctx_->key_ctx.local.enc_key), iv);
-    ctr.encrypt(buffer, buffer, len);
+    local_ctr_->set_iv(iv);
+    local_ctr_->encrypt(buffer, buffer, len);
 
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::srtp::encrypt_aead(uint32_t ssrc, uint16_t seq, uint8_t *aad, size_t aad_len,
+                                       uint8_t *buffer, size_t len, uint8_t *tag)
+{
+    uint8_t iv[GCM_IV_LENGTH] = { 0 };
+    uint64_t index = get_send_index(seq);
+
+    if (create_gcm_iv(iv, ssrc, index, srtp_ctx_->key_ctx.local.salt_key) != RTP_OK) {
+        LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
+        return RTP_INVALID_VALUE;
+    }
+
+    local_gcm_->encrypt(buffer, buffer, len, iv, GCM_IV_LENGTH, aad, aad_len, tag, GCM_TAG_LENGTH);
+    return RTP_OK;
+}
+
 rtp_error_t uvgrtp::srtp::recv_packet_handler(void *arg, int flags, frame::rtp_frame **out)
 {
     (void)flags;
@@ -46,21 +104,56 @@ rtp_error_t uvgrtp::srtp::recv_packet_handler(void *arg, int flags, frame::rtp_f
     auto ctx   = srtp->get_ctx();
     auto frame = *out;
 
+    if (srtp->use_aead()) {
+        uint8_t iv[GCM_IV_LENGTH] = { 0 };
+
+        if (frame->payload_len < GCM_TAG_LENGTH) {
+            LOG_ERROR("Packet is too short to contain an authentication tag!");
+            return RTP_GENERIC_ERROR;
+        }
+
+        frame->payload_len -= GCM_TAG_LENGTH;
+
+        /* The roll-over counter is updated only after the tag has been verified,
+         * otherwise a forged packet with sequence number 0xffff would advance it
+         * and every authentic packet after that would be decrypted with a wrong IV */
+        uint8_t *tag   = frame->payload + frame->payload_len;
+        uint64_t index = srtp->estimate_recv_index(frame->header.seq, frame->header.timestamp);
+
+        if (srtp->create_gcm_iv(iv, frame->header.ssrc, index, ctx->key_ctx.remote.salt_key) != RTP_OK) {
+            LOG_ERROR("Failed to create IV, unable to decrypt the RTP packet!");
+            return RTP_GENERIC_ERROR;
+        }
+
+        if (!srtp->remote_gcm_->decrypt(frame->payload, frame->payload, frame->payload_len,
+                iv, GCM_IV_LENGTH, frame->dgram, frame->payload - frame->dgram, tag, GCM_TAG_LENGTH)) {
+            LOG_ERROR("Authentication tag mismatch!");
+            return RTP_GENERIC_ERROR;
+        }
+
+        if (srtp->is_replayed_packet(index)) {
+            LOG_ERROR("Replayed packet received, discarding!");
+            return RTP_GENERIC_ERROR;
+        }
+
+        (void)srtp->get_recv_index(frame->header.seq, frame->header.timestamp);
+        return RTP_PKT_MODIFIED;
+    }
+
     /* Calculate authentication tag for the packet and compare it against the one we received */
     if (srtp->authenticate_rtp()) {
         uint8_t digest[10] = { 0 };
-        auto hmac_sha1     = uvgrtp::crypto::hmac::sha1(ctx->key_ctx.remote.auth_key, AES_KEY_LENGTH);
 
-        hmac_sha1.update(frame->dgram, frame->dgram_size - AUTH_TAG_LENGTH);
-        hmac_sha1.update((uint8_t *)&ctx->roc, sizeof(ctx->roc));
-        hmac_sha1.final((uint8_t *)digest, AUTH_TAG_LENGTH);
+        srtp->remote_hmac_->update(frame->dgram, frame->dgram_size - AUTH_TAG_LENGTH);
+        srtp->remote_hmac_->update((uint8_t *)&ctx->roc, sizeof(ctx->roc));
+        srtp->remote_hmac_->final((uint8_t *)digest, AUTH_TAG_LENGTH);
 
         if (memcmp(digest, &frame->dgram[frame->dgram_size - AUTH_TAG_LENGTH], AUTH_TAG_LENGTH)) {
             LOG_ERROR("Authentication tag mismatch!");
             return RTP_GENERIC_ERROR;
         }
 
-        if (srtp->is_replayed_packet(digest)) {
+        if (srtp->is_replayed_packet(srtp->estimate_recv_index(frame->header.seq, frame->header.timestamp))) {
             LOG_ERROR("Replayed packet received, discarding!");
             return RTP_GENERIC_ERROR;
         }
@@ -71,40 +164,16 @@ rtp_error_t uvgrtp::srtp::recv_packet_handler(void *arg, int flags, frame::rtp_f
         return RTP_PKT_NOT_HANDLED;
 
     uint8_t iv[16]  = { 0 };
-    uint16_t seq    = frame->header.seq;
     uint32_t ssrc   = frame->header.ssrc;
-    uint32_t ts     = frame->header.timestamp;
-    uint64_t index  = 0;
-
-    /* as the sequence number approaches 0xffff and is close to wrapping around,
-     * special care must be taken to use correct roll-over counter as it's entirely
-     * possible that packets come out of order around this overflow boundary
-     * and if e.g. we first receive packet with sequence number 0xffff and thus update
-     * ROC to ROC + 1 and after that we receive packet with sequence number 0xfffe,
-     * we use an incorrect value for ROC as the the packet 0xfffe was encrypted with ROC - 1.
-     *
-     * It is a reasonable assumption that correct ROC differs from "ctx->roc" at most by 1 (-, +)
-     * because if the difference is more than 1, the input frame would be larger than 90 MB.
-     *
-     * Here the assumption is that the offset for an incorrectly ordered packet is at most 10k */
-    if (ts == ctx->rts && seq + MAX_OFF < MAX_OFF)
-        index = (((uint64_t)ctx->roc - 1) << 16) + seq;
-    else
-        index = (((uint64_t)ctx->roc) << 16) + seq;
-
-    /* Sequence number has wrapped around, update Roll-over Counter */
-    if (seq == 0xffff) {
-        ctx->roc++;
-        ctx->rts = ts;
-    }
+    uint64_t index  = srtp->get_recv_index(frame->header.seq, frame->header.timestamp);
 
     if (srtp->create_iv(iv, ssrc, index, ctx->key_ctx.remote.salt_key) != RTP_OK) {
         LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
         return RTP_GENERIC_ERROR;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(ctx->key_ctx.remote.enc_key, sizeof(ctx->key_ctx.remote.enc_key), iv);
-    ctr.decrypt(frame->payload, frame->payload, frame->payload_len);
+    srtp->remote_ctr_->set_iv(iv);
+    srtp->remote_ctr_->decrypt(frame->payload, frame->payload, frame->payload_len);
 
     return RTP_PKT_MODIFIED;
 }
@@ -114,11 +183,29 @@ rtp_error_t uvgrtp::srtp::send_packet_handler(void *arg, uvgrtp::buf_vec& buffer
     auto srtp       = (uvgrtp::srtp *)arg;
     auto frame      = (uvgrtp::frame::rtp_frame *)buffers.at(0).second;
     auto ctx        = srtp->get_ctx();
-    auto off        = srtp->authenticate_rtp() ? 2 : 1;
+    auto off        = (srtp->authenticate_rtp() || srtp->use_aead()) ? 2 : 1;
     auto data       = buffers.at(buffers.size() - off);
-    auto hmac_sha1  = uvgrtp::crypto::hmac::sha1(ctx->key_ctx.local.auth_key, AES_KEY_LENGTH);
     rtp_error_t ret = RTP_OK;
 
+    /* The frame queue places the RTP header to the first buffer, the payload
+     * to the second buffer and the space for the authentication tag to the last buffer */
+    if (srtp->use_aead()) {
+        ret = srtp->encrypt_aead(
+            ntohl(frame->header.ssrc),
+            ntohs(frame->header.seq),
+            buffers.at(0).second,
+            buffers.at(0).first,
+            data.second,
+            data.first,
+            buffers.at(buffers.size() - 1).second
+        );
+
+        if (ret != RTP_OK)
+            LOG_ERROR("Failed to encrypt RTP packet!");
+
+        return ret;
+    }
+
     if (srtp->use_null_cipher())
         goto authenticate;
 
@@ -139,10 +226,10 @@ authenticate:
         return RTP_OK;
 
     for (size_t i = 0; i < buffers.size() - 1; ++i)
-        hmac_sha1.update((uint8_t *)buffers[i].second, buffers[i].first);
+        srtp->local_hmac_->update((uint8_t *)buffers[i].second, buffers[i].first);
 
-    hmac_sha1.update((uint8_t *)&ctx->roc, sizeof(ctx->roc));
-    hmac_sha1.final((uint8_t *)buffers[buffers.size() - 1].second, AUTH_TAG_LENGTH);
+    srtp->local_hmac_->update((uint8_t *)&ctx->roc, sizeof(ctx->roc));
+    srtp->local_hmac_->final((uint8_t *)buffers[buffers.size() - 1].second, AUTH_TAG_LENGTH);
 
     return ret;
 }
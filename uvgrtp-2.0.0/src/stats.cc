@@ -0,0 +1,112 @@
+#include "stats.hh"
+
+uvgrtp::stats::stats()
+{
+    send_.packets       = 0;
+    send_.bytes         = 0;
+    send_.syscalls      = 0;
+    send_.txtime_errors = 0;
+
+    recv_.packets   = 0;
+    recv_.bytes     = 0;
+    recv_.syscalls  = 0;
+    recv_.completed = 0;
+    recv_.dropped   = 0;
+
+    for (int i = 0; i < STATS_BATCH_BUCKETS; ++i) {
+        send_.batch[i] = 0;
+        recv_.batch[i] = 0;
+    }
+
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; ++i) {
+        recv_.reassembly[i]   = 0;
+        recv_.pull_latency[i] = 0;
+    }
+}
+
+uvgrtp::stats::~stats()
+{
+}
+
+void uvgrtp::stats::add(counter& c, uint64_t value)
+{
+    c.fetch_add(value, std::memory_order_relaxed);
+}
+
+void uvgrtp::stats::copy(uint64_t *dst, const counter *src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = src[i].load(std::memory_order_relaxed);
+}
+
+size_t uvgrtp::stats::bucket(uint64_t value, size_t nbuckets)
+{
+    size_t i = 0;
+
+    while (value && i < nbuckets - 1) {
+        value >>= 1;
+        ++i;
+    }
+
+    return i;
+}
+
+void uvgrtp::stats::add_send(size_t packets, size_t bytes)
+{
+    add(send_.packets, packets);
+    add(send_.bytes, bytes);
+    add(send_.syscalls, 1);
+    add(send_.batch[bucket(packets, STATS_BATCH_BUCKETS)], 1);
+}
+
+void uvgrtp::stats::add_txtime_error()
+{
+    add(send_.txtime_errors, 1);
+}
+
+void uvgrtp::stats::add_recv(size_t packets, size_t bytes)
+{
+    add(recv_.packets, packets);
+    add(recv_.bytes, bytes);
+    add(recv_.syscalls, 1);
+    add(recv_.batch[bucket(packets, STATS_BATCH_BUCKETS)], 1);
+}
+
+void uvgrtp::stats::add_completed_frame()
+{
+    add(recv_.completed, 1);
+}
+
+void uvgrtp::stats::add_dropped_frame()
+{
+    add(recv_.dropped, 1);
+}
+
+void uvgrtp::stats::add_reassembly_time(uint64_t us)
+{
+    add(recv_.reassembly[bucket(us, STATS_LATENCY_BUCKETS)], 1);
+}
+
+void uvgrtp::stats::add_pull_latency(uint64_t us)
+{
+    add(recv_.pull_latency[bucket(us, STATS_LATENCY_BUCKETS)], 1);
+}
+
+void uvgrtp::stats::snapshot(uvgrtp::stream_stats& out) const
+{
+    out.sent_packets  = send_.packets.load(std::memory_order_relaxed);
+    out.sent_bytes    = send_.bytes.load(std::memory_order_relaxed);
+    out.send_syscalls = send_.syscalls.load(std::memory_order_relaxed);
+    out.txtime_errors = send_.txtime_errors.load(std::memory_order_relaxed);
+
+    out.recv_packets     = recv_.packets.load(std::memory_order_relaxed);
+    out.recv_bytes       = recv_.bytes.load(std::memory_order_relaxed);
+    out.recv_syscalls    = recv_.syscalls.load(std::memory_order_relaxed);
+    out.frames_completed = recv_.completed.load(std::memory_order_relaxed);
+    out.frames_dropped   = recv_.dropped.load(std::memory_order_relaxed);
+
+    copy(out.send_batch, send_.batch, STATS_BATCH_BUCKETS);
+    copy(out.recv_batch, recv_.batch, STATS_BATCH_BUCKETS);
+    copy(out.reassembly_us, recv_.reassembly, STATS_LATENCY_BUCKETS);
+    copy(out.pull_latency_us, recv_.pull_latency, STATS_LATENCY_BUCKETS);
+}
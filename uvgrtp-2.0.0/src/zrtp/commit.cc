@@ -77,7 +77,7 @@ uvgrtp::zrtp_msg::commit::~commit()
     (void)uvgrtp::frame::dealloc_frame(rframe_);
 }
 
-rtp_error_t uvgrtp::zrtp_msg::commit::send_msg(uvgrtp::socket *socket, sockaddr_in& addr)
+rtp_error_t uvgrtp::zrtp_msg::commit::send_msg(uvgrtp::socket *socket, sockaddr_storage& addr)
 {
     rtp_error_t ret;
 
@@ -48,7 +48,7 @@ uvgrtp::zrtp_msg::confack::~confack()
     (void)uvgrtp::frame::dealloc_frame(rframe_);
 }
 
-rtp_error_t uvgrtp::zrtp_msg::confack::send_msg(uvgrtp::socket *socket, sockaddr_in& addr)
+rtp_error_t uvgrtp::zrtp_msg::confack::send_msg(uvgrtp::socket *socket, sockaddr_storage& addr)
 {
     rtp_error_t ret;
 
@@ -86,7 +86,7 @@ uvgrtp::zrtp_msg::confirm::~confirm()
     (void)uvgrtp::frame::dealloc_frame(rframe_);
 }
 
-rtp_error_t uvgrtp::zrtp_msg::confirm::send_msg(uvgrtp::socket *socket, sockaddr_in& addr)
+rtp_error_t uvgrtp::zrtp_msg::confirm::send_msg(uvgrtp::socket *socket, sockaddr_storage& addr)
 {
     rtp_error_t ret;
 
@@ -110,7 +110,7 @@ uvgrtp::zrtp_msg::dh_key_exchange::~dh_key_exchange()
     (void)uvgrtp::frame::dealloc_frame(rframe_);
 }
 
-rtp_error_t uvgrtp::zrtp_msg::dh_key_exchange::send_msg(uvgrtp::socket *socket, sockaddr_in& addr)
+rtp_error_t uvgrtp::zrtp_msg::dh_key_exchange::send_msg(uvgrtp::socket *socket, sockaddr_storage& addr)
 {
     rtp_error_t ret;
 
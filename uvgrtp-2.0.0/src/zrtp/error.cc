@@ -35,7 +35,7 @@ uvgrtp::zrtp_msg::error::~error()
     (void)uvgrtp::frame::dealloc_frame(frame_);
 }
 
-rtp_error_t uvgrtp::zrtp_msg::error::send_msg(uvgrtp::socket *socket, sockaddr_in& addr)
+rtp_error_t uvgrtp::zrtp_msg::error::send_msg(uvgrtp::socket *socket, sockaddr_storage& addr)
 {
     rtp_error_t ret;
 
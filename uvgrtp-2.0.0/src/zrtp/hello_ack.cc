@@ -33,7 +33,7 @@ uvgrtp::zrtp_msg::hello_ack::~hello_ack()
     (void)uvgrtp::frame::dealloc_frame(frame_);
 }
 
-rtp_error_t uvgrtp::zrtp_msg::hello_ack::send_msg(uvgrtp::socket *socket, sockaddr_in& addr)
+rtp_error_t uvgrtp::zrtp_msg::hello_ack::send_msg(uvgrtp::socket *socket, sockaddr_storage& addr)
 {
     rtp_error_t ret;
 
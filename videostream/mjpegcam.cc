@@ -108,19 +108,25 @@ save_jpeg(const void *p, int size)
 }
 #endif
 
+//
+// Dequeue a filled buffer. The buffer is not handed back to the driver
+// here, the caller owns it until camera_release() so the frame can't be
+// overwritten while it is still being sent. Returns the buffer index or
+// -1 if no frame was ready.
+//
 static int
 read_frame(uint8_t **jpg, int *nbytes)
 {
-    unsigned int i;
     struct v4l2_buffer buf;
 
+    CLEAR(buf);
     buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     buf.memory = V4L2_MEMORY_MMAP;
 
     if (-1 == xioctl(fd, VIDIOC_DQBUF, &buf)) {
         switch (errno) {
         case EAGAIN:
-            return 0;
+            return -1;
 
         case EIO:
         default:
@@ -133,54 +139,74 @@ read_frame(uint8_t **jpg, int *nbytes)
     *jpg = (uint8_t *)(buffers[buf.index].start);
     *nbytes = buf.bytesused;
 
-    //
-    // This is what sets up for the next frame. Maybe this should be at the top of the loop, then
-    // select on it, and read frame out. 
-    //usleep(100000);
-    usleep(50000);
-    if (-1 == xioctl(fd, VIDIOC_QBUF, &buf))
-        errno_exit("VIDIOC_QBUF");
-
-    return 0;
+    return buf.index;
 }
 
+//
+// Block until the camera delivers a frame. Returns the index of the
+// buffer holding it, which must be passed to camera_release() once the
+// frame data is no longer needed.
+//
 int
 camera_capture(uint8_t **data, int *len)
 {
-    unsigned int count;
-    count = frame_count;
-
     fd_set fds;
     struct timeval tv;
     int r;
+    int index;
 
-    FD_ZERO(&fds);
-    FD_SET(fd, &fds);
+    do {
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
 
-    /* Timeout. */
-    tv.tv_sec = 10;
-    tv.tv_usec = 0;
+        /* Timeout. */
+        tv.tv_sec = 10;
+        tv.tv_usec = 0;
 
-    r = select(fd + 1, &fds, NULL, NULL, &tv);
+        r = select(fd + 1, &fds, NULL, NULL, &tv);
 
-    if (-1 == r) {
-//            if (EINTR == errno)
-//                    continue;
-        errno_exit("select");
-    }
+        if (-1 == r) {
+            if (EINTR == errno)
+                continue;
+            errno_exit("select");
+        }
 
-    if (0 == r) {
-        fprintf(stderr, "select timeout\n");
-        exit(EXIT_FAILURE);
-    }
+        if (0 == r) {
+            fprintf(stderr, "select timeout\n");
+            exit(EXIT_FAILURE);
+        }
 
-    if (read_frame(data, len)) {
-        fprintf(stderr, "error reading frame\n");
-    }
+        index = read_frame(data, len);
+    } while (index < 0);
+
+    return index;
+}
+
+//
+// Hand a buffer returned by camera_capture() back to the driver
+//
+int
+camera_release(int index)
+{
+    struct v4l2_buffer buf;
+
+    CLEAR(buf);
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+
+    if (-1 == xioctl(fd, VIDIOC_QBUF, &buf))
+        errno_exit("VIDIOC_QBUF");
 
     return 0;
 }
 
+int
+camera_buffers(void)
+{
+    return n_buffers;
+}
+
 static void
 stop_capturing(void)
 {
@@ -9,6 +9,10 @@
 #include <lib.hh>
 #include <jpeglib.h>
 #include <setjmp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 #define IMG_W 640
@@ -25,14 +29,24 @@ int WINDOW_W = IMG_W;
 int WINDOW_H = IMG_H;
  
 int thread_exit = 0;
-//
-    // The width and height of the image
-uint8_t tbuff[IMG_W * IMG_H * 3];
+
+// Frames are decoded straight into one of two long lived buffers which
+// the main thread uploads to the texture. A buffer is busy from the time
+// it is handed to the main thread until SDL_UpdateTexture is done with it.
+uint8_t tbuff[2][IMG_W * IMG_H * 3];
+SDL_atomic_t tbuff_busy[2];
+
+// Decode and display time, reported by calculate_fps
+uint64_t decode_ticks = 0;
+uint32_t decode_count = 0;
+uint64_t display_ticks = 0;
+uint32_t dropped_frames = 0;
 
 int rx_run(int argc, char* argv[]);
 
 int camera_open(const char *dev);
 int camera_capture(uint8_t **data, int *len);
+int camera_release(int index);
 
 struct my_error_mgr {
     struct jpeg_error_mgr pub;    /* "public" fields */
@@ -55,6 +69,25 @@ my_error_exit (j_common_ptr cinfo)
 }
 
 
+//
+// Walk a recorded MJPEG stream, a file of back to back JPEG images. Returns
+// the length of the image starting at data or 0 when there is none left.
+//
+static size_t
+next_jpeg(const uint8_t *data, size_t len)
+{
+    size_t i;
+
+    if (len < 4 || data[0] != 0xff || data[1] != 0xd8)
+        return 0;
+
+    for (i = 2; i + 1 < len; i++) {
+        if (data[i] == 0xff && data[i + 1] == 0xd9)
+            return i + 2;
+    }
+    return 0;
+}
+
 int
 refresh_video(void *opaque)
 {
@@ -69,24 +102,75 @@ refresh_video(void *opaque)
     // local camera capture
     int      cam_len;
     uint8_t *cam_data;
-
-    if (remote[0] == '/') {
+    int      cam_idx = -1;
+
+    // recorded MJPEG file, played back as fast as it decodes
+    int      recorded = 0;
+    uint8_t *rec_data = NULL;
+    size_t   rec_len = 0;
+    size_t   rec_off = 0;
+    struct stat st;
+
+    if (remote[0] == '/' && stat(remote, &st) == 0 && S_ISREG(st.st_mode)) {
+        int fd = open(remote, O_RDONLY);
+        if (fd < 0) {
+            printf("unable to open %s\n", remote);
+            return 1;
+        }
+        rec_len = st.st_size;
+        rec_data = (uint8_t *)mmap(NULL, rec_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (rec_data == MAP_FAILED) {
+            printf("unable to map %s\n", remote);
+            return 1;
+        }
+        recorded = 1;
+        lcam = 1;
+    } else if (remote[0] == '/') {
         // local camera device, not a RTP stream
         lcam = 1;
         camera_open(remote);
     } else {
         // rtp stream;
         sess = ctx.create_session(remote);
-        strm = sess->create_stream(port, port, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        strm = sess->create_stream(port, port, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC | RCE_JITTER_BUFFER);
         strm->configure_ctx(RCC_PKT_MAX_DELAY, 200);
     }
 
+    // The decompressor is set up once and reused for every frame
+    struct jpeg_decompress_struct cinfo;
+    struct my_error_mgr jerr;
+    JSAMPROW rows[IMG_H];
+    int back = 0;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = my_error_exit;
+    jpeg_create_decompress(&cinfo);
+
     int nframe = 0;
     for (;;) {
-        uvgrtp::frame::rtp_frame *frame;
+        uvgrtp::frame::rtp_frame *frame = NULL;
+        Uint64 start;
+
+        if (recorded) {
+            cam_data = rec_data + rec_off;
+            cam_len = (int)next_jpeg(cam_data, rec_len - rec_off);
+            if (cam_len == 0) {
+                if (rec_off == 0) {
+                    printf("no JPEG images in %s\n", remote);
+                    break;
+                }
+                rec_off = 0;
+                continue;
+            }
+            rec_off += cam_len;
 
-        if (lcam) {
-            camera_capture(&cam_data, &cam_len);
+            // Offline playback measures decode speed, wait for the display
+            // instead of dropping frames
+            while (SDL_AtomicGet(&tbuff_busy[back]))
+                SDL_Delay(1);
+        } else if (lcam) {
+            cam_idx = camera_capture(&cam_data, &cam_len);
 
         } else {
             frame = strm->pull_frame();
@@ -94,27 +178,22 @@ refresh_video(void *opaque)
             //printf("got frame: %d, length=%d\n", nframe++, frame->payload_len);
         }
 
-        int rc;
-        // Variables for the decompressor itself
-        struct jpeg_decompress_struct cinfo;
-        //struct jpeg_error_mgr jerr;
-
-        struct my_error_mgr jerr;
-
-        // Variables for the output buffer, and how long each row is
-        unsigned long bmp_size;
-        unsigned char *bmp_buffer = NULL;
-        int row_stride, width, height, pixel_size;
-
-        cinfo.err = jpeg_std_error(&jerr.pub);
-        jerr.pub.error_exit = my_error_exit;
+        // The display still holds both buffers, skip this frame
+        if (SDL_AtomicGet(&tbuff_busy[back])) {
+            back ^= 1;
+            if (SDL_AtomicGet(&tbuff_busy[back])) {
+                dropped_frames++;
+                goto cleanup;
+            }
+        }
 
         // This is so confusing....
         if (setjmp(jerr.setjmp_buffer)) {
+            jpeg_abort_decompress(&cinfo);
             goto cleanup;
         }
 
-        jpeg_create_decompress(&cinfo);
+        start = SDL_GetPerformanceCounter();
         if (lcam) {
             jpeg_mem_src(&cinfo, cam_data, cam_len);
             byte_counter += (uint32_t)cam_len;
@@ -123,33 +202,33 @@ refresh_video(void *opaque)
             byte_counter += (uint32_t)frame->payload_len;
         }
 
-        rc = jpeg_read_header(&cinfo, TRUE);
-        if (rc != 1) {
+        if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
             printf("not a normal JPEG blob\n");
+            jpeg_abort_decompress(&cinfo);
             goto cleanup;
         }
 
+        cinfo.out_color_space = JCS_RGB;
         jpeg_start_decompress(&cinfo);
 
-        width = cinfo.output_width;
-        height = cinfo.output_height;
-        pixel_size = cinfo.output_components;
-
-        bmp_size = width * height * pixel_size;
-        bmp_buffer = (unsigned char*) malloc(bmp_size);
+        if (cinfo.output_width != IMG_W || cinfo.output_height != IMG_H ||
+            cinfo.output_components != 3) {
+            printf("unexpected image size %ux%ux%d\n", cinfo.output_width,
+                   cinfo.output_height, cinfo.output_components);
+            jpeg_abort_decompress(&cinfo);
+            goto cleanup;
+        }
 
-        // The row_stride is the total number of bytes it takes to store an
-        // entire scanline (row). 
-        row_stride = width * pixel_size;
+        // Hand libjpeg every remaining row, it fills as many per call as
+        // its output buffering allows
+        for (int i = 0; i < IMG_H; i++)
+            rows[i] = tbuff[back] + i * IMG_W * 3;
 
         while (cinfo.output_scanline < cinfo.output_height) {
-            unsigned char *buffer_array[1];
-            buffer_array[0] = bmp_buffer + \
-                           (cinfo.output_scanline) * row_stride;
-
-
-            if (jpeg_read_scanlines(&cinfo, buffer_array, 1) != 1) {
+            if (jpeg_read_scanlines(&cinfo, rows + cinfo.output_scanline,
+                        cinfo.output_height - cinfo.output_scanline) == 0) {
                 printf("did not read the scanline...\n");
+                break;
             }
         }
 
@@ -157,25 +236,30 @@ refresh_video(void *opaque)
             printf("finish decompress didn't finish\n");
         }
 
-        if (jerr.pub.num_warnings == 0) {
-            // NOTE: This needs to be re-worked....
-            memcpy(tbuff, bmp_buffer, sizeof(tbuff));
+        decode_ticks += SDL_GetPerformanceCounter() - start;
+        decode_count++;
 
+        if (jerr.pub.num_warnings == 0) {
             SDL_Event event;
+            SDL_zero(event);
             event.type = SDL_USEREVENT + 1;
+            event.user.code = back;
+            SDL_AtomicSet(&tbuff_busy[back], 1);
             SDL_PushEvent(&event);
+            back ^= 1;
         }
         
 cleanup:
-        jpeg_destroy_decompress(&cinfo);
-        if (bmp_buffer)
-            free(bmp_buffer);
-
-        if (!lcam) {
+        if (recorded) {
+            // nothing to release
+        } else if (lcam) {
+            camera_release(cam_idx);
+        } else {
             uvg_rtp::frame::dealloc_frame(frame);
         }
     }
 
+    jpeg_destroy_decompress(&cinfo);
     return 0;
 }
 
@@ -186,10 +270,20 @@ calculate_fps(Uint32 interval, void *param)
     static Uint32 last = 0;
     Uint32 now = SDL_GetTicks();
 
-    printf("elapsed = %u mS, fps: %2d, Mb/s: %1.1f\n", now - last, *framecounter, (float)((byte_counter) * 8) / 1000000.0);
+    double freq = (double)SDL_GetPerformanceFrequency() / 1000.0;
+    double decode_ms = decode_count ? decode_ticks / freq / decode_count : 0.0;
+    double display_ms = *framecounter ? display_ticks / freq / *framecounter : 0.0;
+
+    printf("elapsed = %u mS, fps: %2d, Mb/s: %1.1f, decode: %.2f mS, display: %.2f mS, dropped: %u\n",
+           now - last, *framecounter, (float)((byte_counter) * 8) / 1000000.0,
+           decode_ms, display_ms, dropped_frames);
     last = now;
     *framecounter = 0;
     byte_counter = 0;
+    decode_ticks = 0;
+    decode_count = 0;
+    display_ticks = 0;
+    dropped_frames = 0;
     
     return interval;
 }
@@ -201,7 +295,7 @@ main(int argc, char *argv[])
 
     if (argc < 2) {
         printf("usage: \n");
-        printf(" sdlplay [remote-ip|/dev/videoX]\n");
+        printf(" sdlplay [remote-ip|/dev/videoX|/path/to/recorded.mjpeg]\n");
         return 1;
     }
 
@@ -241,7 +335,12 @@ main(int argc, char *argv[])
     while (1) {
         SDL_WaitEvent(&event);
         if (event.type == SDL_USEREVENT + 1) {
-            SDL_UpdateTexture(texture, NULL, tbuff, IMG_W * 3);
+            Uint64 start = SDL_GetPerformanceCounter();
+
+            // The texture copies the pixels, the decoder may reuse the
+            // buffer as soon as the upload is done
+            SDL_UpdateTexture(texture, NULL, tbuff[event.user.code], IMG_W * 3);
+            SDL_AtomicSet(&tbuff_busy[event.user.code], 0);
  
             rect.x = 0;
             rect.y = 0;
@@ -261,6 +360,7 @@ main(int argc, char *argv[])
 #endif
             SDL_RenderPresent(renderer);
 
+            display_ticks += SDL_GetPerformanceCounter() - start;
             framecounter++;
 
         } else if(event.type == SDL_WINDOWEVENT) {
@@ -42,6 +42,11 @@ For the default 16:9 aspect ratio, encode at these resolutions:
 
 #include <linux/videodev2.h>
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 /* The libuvgrtp source is not prefixed with 'uvgrtp' */
 #include <lib.hh>
 //#include <uvgrtp/lib.hh>
@@ -74,6 +79,47 @@ long_options[] = {
 
 int camera_open(const char *dev);
 int camera_capture(uint8_t **data, int *len);
+int camera_release(int index);
+int camera_buffers(void);
+
+//
+// Capture and transmit run in separate threads. The capture thread
+// dequeues mmap buffers from the driver and queues them here, the sender
+// pushes them over RTP and only then hands them back to the driver.
+//
+struct captured_frame {
+    int      index;
+    uint8_t *data;
+    int      len;
+};
+
+static std::mutex                 frames_mtx;
+static std::condition_variable    frames_cv;
+static std::deque<captured_frame> frames;
+static unsigned long              frames_dropped;
+
+static void
+capture_loop(size_t max_pending)
+{
+    for (;;) {
+        captured_frame f;
+        f.index = camera_capture(&f.data, &f.len);
+
+        std::unique_lock<std::mutex> lk(frames_mtx);
+        frames.push_back(f);
+
+        // The sender fell behind. Give the oldest unsent frame back to the
+        // driver so capture never runs out of buffers.
+        if (frames.size() > max_pending) {
+            camera_release(frames.front().index);
+            frames.pop_front();
+            if ((++frames_dropped % 100) == 1)
+                fprintf(stderr, "sender too slow, %lu frames dropped\n", frames_dropped);
+        }
+        lk.unlock();
+        frames_cv.notify_one();
+    }
+}
 
 int main(int argc, char **argv)
 {
@@ -133,12 +179,25 @@ int main(int argc, char **argv)
     strm->configure_ctx(RCC_PKT_MAX_DELAY, 200);
 
     camera_open(dev_name);
+
+    // One buffer is being sent and at least one stays queued in the
+    // driver, the rest may wait for the sender.
+    int max_pending = camera_buffers() - 2;
+    std::thread capture(capture_loop, max_pending > 0 ? max_pending : 1);
+
     while (1) {
-        // capture frame...
-        uint8_t *data = NULL;
-        int data_len = 0;
-        camera_capture(&data, &data_len);
-        strm->push_frame(data, data_len, RTP_NO_FLAGS);
+        captured_frame f;
+        {
+            std::unique_lock<std::mutex> lk(frames_mtx);
+            frames_cv.wait(lk, [] { return !frames.empty(); });
+            f = frames.front();
+            frames.pop_front();
+        }
+
+        // push_frame() sends synchronously, all packets of the frame are
+        // out once it returns and the buffer can be reused by the driver
+        strm->push_frame(f.data, f.len, RTP_NO_FLAGS);
+        camera_release(f.index);
     }
     
         return 0;